@@ -0,0 +1,271 @@
+#include "XPlaneDecode.hpp"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) // SSE2 为 x86-64 基线
+#define XPLANEUDP_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(XPLANEUDP_X86) && defined(__GNUC__)
+#define XPLANEUDP_AVX2 1
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/**
+ * @brief 逐对解码 与原 receiveDataProcess 行为一致
+ */
+size_t RrefDecoder::scalar (const char *payload, const size_t pairs, const uint32_t limit, int32_t *indices,
+                            float *values) {
+    size_t count = 0;
+    for (size_t i = 0; i < pairs; ++i) {
+        int32_t index;
+        float value;
+        std::memcpy(&index, payload + i * 8, 4);
+        std::memcpy(&value, payload + i * 8 + 4, 4);
+        if (index < 0 || static_cast<uint32_t>(index) >= limit)
+            continue;
+        indices[count] = index;
+        values[count] = value;
+        ++count;
+    }
+    return count;
+}
+
+#ifdef XPLANEUDP_X86
+/**
+ * @brief 每次 4 对 全部合法时整组写出 否则该组逐对处理
+ */
+size_t RrefDecoder::sse2 (const char *payload, const size_t pairs, const uint32_t limit, int32_t *indices,
+                          float *values) {
+    size_t count = 0;
+    size_t i = 0;
+    // 无符号比较: 两侧同时翻转符号位后做有符号比较 负数会变为很大的值
+    const __m128i bias = _mm_set1_epi32(INT32_MIN);
+    const __m128i bound = _mm_set1_epi32(static_cast<int32_t>(limit ^ 0x80000000u));
+    for (; i + 4 <= pairs; i += 4) {
+        const __m128 a = _mm_loadu_ps(reinterpret_cast<const float*>(payload + i * 8)); // i0 v0 i1 v1
+        const __m128 b = _mm_loadu_ps(reinterpret_cast<const float*>(payload + i * 8 + 16)); // i2 v2 i3 v3
+        const __m128i index = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128 value = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128i valid = _mm_cmplt_epi32(_mm_xor_si128(index, bias), bound);
+        if (_mm_movemask_ps(_mm_castsi128_ps(valid)) == 0xF) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + count), index);
+            _mm_storeu_ps(values + count, value);
+            count += 4;
+        } else {
+            count += scalar(payload + i * 8, 4, limit, indices + count, values + count);
+        }
+    }
+    return count + scalar(payload + i * 8, pairs - i, limit, indices + count, values + count);
+}
+#else
+size_t RrefDecoder::sse2 (const char *payload, const size_t pairs, const uint32_t limit, int32_t *indices,
+                          float *values) {
+    return scalar(payload, pairs, limit, indices, values);
+}
+#endif
+
+#ifdef XPLANEUDP_AVX2
+/**
+ * @brief 压缩用的排列表 第 m 项把掩码 m 中置位的通道依次移到前面
+ */
+static constexpr auto makeCompressTable () {
+    std::array<std::array<int32_t, 8>, 256> table{};
+    for (int mask = 0; mask < 256; ++mask) {
+        int n = 0;
+        for (int lane = 0; lane < 8; ++lane) {
+            if (mask & (1 << lane))
+                table[mask][n++] = lane;
+        }
+    }
+    return table;
+}
+alignas(32) static constexpr auto COMPRESS = makeCompressTable();
+
+/**
+ * @brief 每次 8 对 拆分后合法的 index 按掩码压缩写出 保持顺序
+ */
+TARGET_AVX2 size_t RrefDecoder::avx2 (const char *payload, const size_t pairs, const uint32_t limit,
+                                      int32_t *indices, float *values) {
+    size_t count = 0;
+    size_t i = 0;
+    const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+    const __m256i bound = _mm256_set1_epi32(static_cast<int32_t>(limit ^ 0x80000000u));
+    for (; i + 8 <= pairs; i += 8) {
+        const __m256 a = _mm256_loadu_ps(reinterpret_cast<const float*>(payload + i * 8)); // 对 0..3
+        const __m256 b = _mm256_loadu_ps(reinterpret_cast<const float*>(payload + i * 8 + 32)); // 对 4..7
+        // 128 位内拆分得到 [0 1 4 5 | 2 3 6 7] 再跨通道重排为 0..7
+        const __m256i index = _mm256_permute4x64_epi64(
+            _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256 value = _mm256_castsi256_ps(_mm256_permute4x64_epi64(
+            _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+        const __m256i valid = _mm256_cmpgt_epi32(bound, _mm256_xor_si256(index, bias));
+        const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(valid));
+        if (mask == 0xFF) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(indices + count), index);
+            _mm256_storeu_ps(values + count, value);
+            count += 8;
+            continue;
+        }
+        // 输出数组至少有 pairs 个位置 压缩后写满 8 个也不会越过当前组的末尾
+        const __m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(COMPRESS[mask].data()));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(indices + count), _mm256_permutevar8x32_epi32(index, lanes));
+        _mm256_storeu_ps(values + count, _mm256_permutevar8x32_ps(value, lanes));
+        count += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(mask)));
+    }
+    // 调用方为非 VEX 编码的 SSE 代码 需清除高 128 位避免状态切换开销
+    _mm256_zeroupper();
+    return count + sse2(payload + i * 8, pairs - i, limit, indices + count, values + count);
+}
+#else
+size_t RrefDecoder::avx2 (const char *payload, const size_t pairs, const uint32_t limit, int32_t *indices,
+                          float *values) {
+    return sse2(payload, pairs, limit, indices, values);
+}
+#endif
+
+bool RrefDecoder::hasSse2 () {
+#ifdef XPLANEUDP_X86
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool RrefDecoder::hasAvx2 () {
+#ifdef XPLANEUDP_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+RrefDecoder::Kernel RrefDecoder::best () {
+    static const Kernel kernel = hasAvx2() ? &avx2 : hasSse2() ? &sse2 : &scalar;
+    return kernel;
+}
+
+const char* RrefDecoder::name (const Kernel kernel) {
+    if (kernel == &avx2)
+        return "avx2";
+    if (kernel == &sse2)
+        return "sse2";
+    return "scalar";
+}
+
+size_t StaleScan::scalar (const uint32_t *stamps, const size_t count, const uint32_t newest, const uint32_t span,
+                         uint32_t *out) {
+    size_t found = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t stamp = stamps[i];
+        if (stamp <= ANCIENT || (stamp != FREE && newest - stamp < span))
+            out[found++] = static_cast<uint32_t>(i);
+    }
+    return found;
+}
+
+#ifdef XPLANEUDP_X86
+/**
+ * @brief 4 个时间戳的输出掩码 newest - stamp 翻转符号位后与同样翻转的 span 有符号比较 即无符号比较
+ *        stamp 翻转后小于翻转的 ANCIENT + 1 即为 NEVER 或 ANCIENT
+ */
+static inline unsigned staleMask4 (const uint32_t *stamps, const __m128i newest, const __m128i bias,
+                                   const __m128i bound) {
+    const __m128i stamp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stamps));
+    const __m128i inWindow = _mm_cmplt_epi32(_mm_xor_si128(_mm_sub_epi32(newest, stamp), bias), bound);
+    const __m128i lapsed = _mm_set1_epi32(static_cast<int32_t>((StaleScan::ANCIENT + 1) ^ 0x80000000u));
+    const __m128i never = _mm_cmplt_epi32(_mm_xor_si128(stamp, bias), lapsed);
+    const __m128i free = _mm_cmpeq_epi32(stamp, _mm_set1_epi32(-1));
+    return static_cast<unsigned>(
+        _mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(_mm_andnot_si128(free, inWindow), never))));
+}
+
+/**
+ * @brief 每次 16 个 通常全部新鲜 整组跳过 有命中时逐位输出
+ */
+size_t StaleScan::sse2 (const uint32_t *stamps, const size_t count, const uint32_t newest, const uint32_t span,
+                        uint32_t *out) {
+    size_t found = 0;
+    size_t i = 0;
+    const __m128i latest = _mm_set1_epi32(static_cast<int32_t>(newest));
+    const __m128i bias = _mm_set1_epi32(INT32_MIN);
+    const __m128i bound = _mm_set1_epi32(static_cast<int32_t>(span ^ 0x80000000u));
+    for (; i + 16 <= count; i += 16) {
+        const unsigned mask = staleMask4(stamps + i, latest, bias, bound) |
+                              staleMask4(stamps + i + 4, latest, bias, bound) << 4 |
+                              staleMask4(stamps + i + 8, latest, bias, bound) << 8 |
+                              staleMask4(stamps + i + 12, latest, bias, bound) << 12;
+        for (unsigned rest = mask; rest != 0; rest &= rest - 1)
+            out[found++] = static_cast<uint32_t>(i + __builtin_ctz(rest));
+    }
+    const size_t tail = scalar(stamps + i, count - i, newest, span, out + found);
+    for (size_t k = found; k < found + tail; ++k)
+        out[k] += static_cast<uint32_t>(i);
+    return found + tail;
+}
+#else
+size_t StaleScan::sse2 (const uint32_t *stamps, const size_t count, const uint32_t newest, const uint32_t span,
+                        uint32_t *out) {
+    return scalar(stamps, count, newest, span, out);
+}
+#endif
+
+#ifdef XPLANEUDP_AVX2
+/**
+ * @brief 8 个时间戳的输出掩码
+ */
+TARGET_AVX2 static inline uint32_t staleMask8 (const uint32_t *stamps, const __m256i newest, const __m256i bias,
+                                               const __m256i bound) {
+    const __m256i stamp = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stamps));
+    const __m256i inWindow = _mm256_cmpgt_epi32(bound, _mm256_xor_si256(_mm256_sub_epi32(newest, stamp), bias));
+    const __m256i lapsed = _mm256_set1_epi32(static_cast<int32_t>((StaleScan::ANCIENT + 1) ^ 0x80000000u));
+    const __m256i never = _mm256_cmpgt_epi32(lapsed, _mm256_xor_si256(stamp, bias));
+    const __m256i free = _mm256_cmpeq_epi32(stamp, _mm256_set1_epi32(-1));
+    return static_cast<uint32_t>(_mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_or_si256(_mm256_andnot_si256(free, inWindow), never))));
+}
+
+/**
+ * @brief 每次 32 个
+ */
+TARGET_AVX2 size_t StaleScan::avx2 (const uint32_t *stamps, const size_t count, const uint32_t newest,
+                                    const uint32_t span, uint32_t *out) {
+    size_t found = 0;
+    size_t i = 0;
+    const __m256i latest = _mm256_set1_epi32(static_cast<int32_t>(newest));
+    const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+    const __m256i bound = _mm256_set1_epi32(static_cast<int32_t>(span ^ 0x80000000u));
+    for (; i + 32 <= count; i += 32) {
+        const uint32_t mask = staleMask8(stamps + i, latest, bias, bound) |
+                              staleMask8(stamps + i + 8, latest, bias, bound) << 8 |
+                              staleMask8(stamps + i + 16, latest, bias, bound) << 16 |
+                              staleMask8(stamps + i + 24, latest, bias, bound) << 24;
+        for (uint32_t rest = mask; rest != 0; rest &= rest - 1)
+            out[found++] = static_cast<uint32_t>(i + __builtin_ctz(rest));
+    }
+    _mm256_zeroupper();
+    const size_t tail = sse2(stamps + i, count - i, newest, span, out + found);
+    for (size_t k = found; k < found + tail; ++k)
+        out[k] += static_cast<uint32_t>(i);
+    return found + tail;
+}
+#else
+size_t StaleScan::avx2 (const uint32_t *stamps, const size_t count, const uint32_t newest, const uint32_t span,
+                        uint32_t *out) {
+    return sse2(stamps, count, newest, span, out);
+}
+#endif
+
+StaleScan::Kernel StaleScan::best () {
+    static const Kernel kernel = RrefDecoder::hasAvx2() ? &avx2 : RrefDecoder::hasSse2() ? &sse2 : &scalar;
+    return kernel;
+}
+
+const char* StaleScan::name (const Kernel kernel) {
+    if (kernel == &avx2)
+        return "avx2";
+    if (kernel == &sse2)
+        return "sse2";
+    return "scalar";
+}
@@ -0,0 +1,63 @@
+#ifndef XPLANEDECODE_HPP
+#define XPLANEDECODE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief RREF 负载解码 将 (int32 index, float value) 对拆分为两个数组
+ *        丢弃为负或不小于 limit 的 index 保持原有顺序 各实现结果完全一致
+ */
+class RrefDecoder {
+    public:
+        static constexpr size_t MAX_PAIRS{183}; // (1472 - 5) / 8
+        /**
+         * @param payload 头部之后的数据 长度 pairs * 8 无对齐要求
+         * @param pairs 数据对数量
+         * @param limit index 上界 不包含
+         * @param indices 输出 至少 pairs 个
+         * @param values 输出 至少 pairs 个
+         * @return 合法数据对数量
+         */
+        using Kernel = size_t (*) (const char *payload, size_t pairs, uint32_t limit, int32_t *indices, float *values);
+
+        static size_t scalar (const char *payload, size_t pairs, uint32_t limit, int32_t *indices, float *values);
+        static size_t sse2 (const char *payload, size_t pairs, uint32_t limit, int32_t *indices, float *values);
+        static size_t avx2 (const char *payload, size_t pairs, uint32_t limit, int32_t *indices, float *values);
+
+        static bool hasSse2 ();
+        static bool hasAvx2 ();
+        static Kernel best (); // 运行期按 CPU 选择 结果缓存
+        static const char* name (Kernel kernel);
+};
+
+/**
+ * @brief 时间戳扫描 时间戳模 2^32 回绕 找出落在 (newest - span, newest] 内或为 NEVER/ANCIENT 的位置 FREE 不输出
+ *        按位置从小到大输出
+ */
+class StaleScan {
+    public:
+        static constexpr size_t CHUNK{1024}; // 调用方每次扫描的建议长度 输出缓冲可放在栈上
+        static constexpr uint32_t NEVER{0}; // 尚未写入 总是输出
+        static constexpr uint32_t ANCIENT{1}; // 写入已超过半圈 总是输出
+        static constexpr uint32_t FREE{UINT32_MAX}; // 未使用 不输出
+        /**
+         * @param stamps 时间戳 无对齐要求
+         * @param count 数量
+         * @param newest 窗口内最新的时间戳 包含
+         * @param span 窗口长度 (newest - stamp) mod 2^32 小于该值时输出
+         * @param out 输出位置 相对 stamps 至少 count 个
+         * @return 输出数量
+         */
+        using Kernel = size_t (*) (const uint32_t *stamps, size_t count, uint32_t newest, uint32_t span,
+                                   uint32_t *out);
+
+        static size_t scalar (const uint32_t *stamps, size_t count, uint32_t newest, uint32_t span, uint32_t *out);
+        static size_t sse2 (const uint32_t *stamps, size_t count, uint32_t newest, uint32_t span, uint32_t *out);
+        static size_t avx2 (const uint32_t *stamps, size_t count, uint32_t newest, uint32_t span, uint32_t *out);
+
+        static Kernel best (); // 运行期按 CPU 选择 结果缓存
+        static const char* name (Kernel kernel);
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "XPlaneManager.hpp"
+#include <future>
+
+XPlaneManager::XPlaneManager (const size_t threads, const bool autoReConnect) : autoReconnect(autoReConnect) {
+    const size_t count = threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < count; ++i)
+        workers.emplace_back(std::make_unique<Worker>());
+    // 先打开信标 socket 绑定或加入多播组失败时尚未启动线程 异常可直接传出
+    multicastSocket = std::make_unique<ip::udp::socket>(workers.front()->context);
+    XPlaneUdp::openBeaconSocket(*multicastSocket);
+    for (const auto &worker : workers)
+        worker->thread = std::thread([context = &worker->context] () { context->run(); });
+    asio::co_spawn(workers.front()->context, listen(), asio::detached);
+}
+
+XPlaneManager::~XPlaneManager () {
+    close();
+}
+
+/**
+ * @brief 设置发现新实例时的回调 在监听线程调用 可在其中订阅 之后才转交该实例的信标 不能在其中调用 close
+ * @param callbackFunc 回调函数 接受实例与其地址
+ */
+void XPlaneManager::setDiscoverCallback (const DiscoverCallback &callbackFunc) {
+    std::lock_guard lock(simsMutex);
+    discover = callbackFunc;
+}
+
+/**
+ * @brief 添加已知地址的实例 不等待信标 收到其信标后同样用于断线检测
+ * @param endpoint XPlane 接收地址
+ * @return 实例 已存在时返回已有的实例
+ */
+XPlaneUdp& XPlaneManager::add (const ip::udp::endpoint &endpoint) {
+    return *attach(endpoint).first;
+}
+
+/**
+ * @param endpoint XPlane 接收地址
+ * @return 实例 不存在时为空
+ */
+XPlaneUdp* XPlaneManager::find (const ip::udp::endpoint &endpoint) const {
+    std::lock_guard lock(simsMutex);
+    const auto it = sims.find(endpoint);
+    return it == sims.end() ? nullptr : it->second.get();
+}
+
+/**
+ * @return 全部实例 按地址排序 实例在管理器关闭前有效
+ */
+std::vector<XPlaneUdp*> XPlaneManager::getSims () const {
+    std::lock_guard lock(simsMutex);
+    std::vector<XPlaneUdp*> result;
+    result.reserve(sims.size());
+    for (const auto &sim : sims | std::views::values)
+        result.push_back(sim.get());
+    return result;
+}
+
+size_t XPlaneManager::size () const {
+    std::lock_guard lock(simsMutex);
+    return sims.size();
+}
+
+/**
+ * @brief 停止监听 关闭全部实例 再停止线程池
+ *        不能在发现回调或线程池中的其它处理中调用 关闭实例与等待线程需要这些线程继续运行
+ */
+void XPlaneManager::close () {
+    if (closed.exchange(true))
+        return;
+    const auto cancel = [this] {
+        multicastSocket->cancel();
+        multicastSocket->close();
+    };
+    if (workers.front()->context.get_executor().running_in_this_thread()) { // 已在监听线程 投递后等待会死锁
+        cancel();
+    } else {
+        std::promise<void> done;
+        asio::post(workers.front()->context, [&cancel, &done] {
+            cancel();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+    {
+        std::lock_guard lock(simsMutex);
+        for (const auto &sim : sims | std::views::values)
+            sim->close();
+    }
+    for (const auto &worker : workers) {
+        worker->guard.reset();
+        worker->context.stop();
+    }
+    for (const auto &worker : workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+asio::awaitable<void> XPlaneManager::listen () {
+    ip::udp::endpoint sender;
+    while (!closed) {
+        const size_t receiveBytes = co_await multicastSocket->async_receive_from(
+            asio::buffer(beaconBuffer), sender, asio::use_awaitable);
+        const std::span<const char> beacon(beaconBuffer.data(), receiveBytes);
+        uint16_t port;
+        if (closed || parseBeacon(beacon, port) != BeaconRole::MASTER) // 组内其他数据包与非主机信标不创建实例
+            continue;
+        const ip::udp::endpoint endpoint(sender.address(), port);
+        const auto [sim, created] = attach(endpoint);
+        if (created) {
+            DiscoverCallback callback;
+            {
+                std::lock_guard lock(simsMutex);
+                callback = discover;
+            }
+            if (callback)
+                callback(*sim, endpoint);
+        }
+        sim->receiveBeacon(beacon, sender);
+    }
+}
+
+/**
+ * @brief 找到或创建实例 新实例按轮询分配线程
+ * @return 实例 与是否新创建
+ */
+std::pair<XPlaneUdp*, bool> XPlaneManager::attach (const ip::udp::endpoint &endpoint) {
+    std::lock_guard lock(simsMutex);
+    if (const auto it = sims.find(endpoint); it != sims.end())
+        return {it->second.get(), false};
+    auto &context = workers[nextWorker++ % workers.size()]->context;
+    auto &sim = sims[endpoint] = std::make_unique<XPlaneUdp>(context.get_executor(), endpoint, autoReconnect);
+    return {sim.get(), true};
+}
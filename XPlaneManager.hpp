@@ -0,0 +1,54 @@
+#ifndef XPLANEMANAGER_HPP
+#define XPLANEMANAGER_HPP
+
+#include "XPlaneUDP.hpp"
+#include <functional>
+#include <map>
+
+/**
+ * @brief 同一网络内多个 XPlane 的网关 一个 socket 监听全部信标 按发送方地址与信标中的端口区分实例
+ *        每个实例为一个独立的 XPlaneUdp (订阅表与值存储各自独立) 按轮询分配到 io_context 线程池
+ */
+class XPlaneManager {
+    public:
+        using DiscoverCallback = std::function<void  (XPlaneUdp &, const ip::udp::endpoint &)>;
+
+        /**
+         * @param threads io_context 线程数 0 为 CPU 核数
+         * @param autoReConnect 实例断线后重新收到信标时重新订阅
+         */
+        explicit XPlaneManager (size_t threads = 0, bool autoReConnect = true);
+        ~XPlaneManager ();
+        XPlaneManager (const XPlaneManager &) = delete;
+        XPlaneManager& operator= (const XPlaneManager &) = delete;
+
+        void setDiscoverCallback (const DiscoverCallback &callbackFunc);
+        XPlaneUdp& add (const ip::udp::endpoint &endpoint);
+        [[nodiscard]] XPlaneUdp* find (const ip::udp::endpoint &endpoint) const;
+        [[nodiscard]] std::vector<XPlaneUdp*> getSims () const;
+        [[nodiscard]] size_t size () const;
+        [[nodiscard]] size_t threadCount () const { return workers.size(); }
+        void close ();
+
+    private:
+        struct Worker {
+            asio::io_context context{1}; // 每个上下文只由一个线程运行
+            asio::executor_work_guard<asio::io_context::executor_type> guard{asio::make_work_guard(context)};
+            std::thread thread;
+        };
+
+        bool autoReconnect;
+        std::vector<std::unique_ptr<Worker>> workers; // 先于 sims 构造 后于 sims 析构
+        std::unique_ptr<ip::udp::socket> multicastSocket; // 在第一个线程上监听
+        std::array<char, 1472> beaconBuffer{}; // 仅监听线程访问
+        mutable std::mutex simsMutex;
+        std::map<ip::udp::endpoint, std::unique_ptr<XPlaneUdp>> sims; // 受 simsMutex 保护
+        size_t nextWorker{0}; // 受 simsMutex 保护
+        DiscoverCallback discover{nullptr}; // 受 simsMutex 保护
+        std::atomic<bool> closed{false};
+
+        asio::awaitable<void> listen ();
+        std::pair<XPlaneUdp*, bool> attach (const ip::udp::endpoint &endpoint);
+};
+
+#endif
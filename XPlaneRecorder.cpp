@@ -0,0 +1,269 @@
+#include "XPlaneRecorder.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace bip = boost::interprocess;
+namespace ip = boost::asio::ip;
+
+static int64_t monotonicNanoseconds () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PacketRecorder::PacketRecorder (const std::string &logPath, const size_t ringBytes)
+    : path(logPath),
+      capacity(std::bit_ceil(std::max(ringBytes, PacketRecord::MAX_SIZE))),
+      ring(new char[capacity + PacketRecord::MAX_SIZE]),
+      startTime(monotonicNanoseconds()) {
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            throw std::runtime_error("Failed to create packet log: " + path);
+    }
+    try {
+        std::filesystem::resize_file(path, SEGMENT);
+        mapping = bip::file_mapping(path.c_str(), bip::read_write);
+        region = bip::mapped_region(mapping, bip::read_write, 0, SEGMENT);
+    } catch (const std::exception &e) {
+        throw std::runtime_error("Failed to map packet log: " + path + " " + e.what());
+    }
+    // 文件头
+    std::array<char, PacketRecord::FILE_HEADER> header{};
+    const uint32_t version = PacketRecord::VERSION;
+    const uint32_t headerLength = PacketRecord::FILE_HEADER;
+    const int64_t wallStart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::memcpy(header.data(), PacketRecord::MAGIC, sizeof(PacketRecord::MAGIC));
+    std::memcpy(header.data() + 8, &version, 4);
+    std::memcpy(header.data() + 12, &headerLength, 4);
+    std::memcpy(header.data() + 16, &wallStart, 8);
+    std::memcpy(region.get_address(), header.data(), header.size());
+    written.store(header.size(), std::memory_order_relaxed);
+    writer = std::thread([this] () { run(); });
+}
+
+PacketRecorder::~PacketRecorder () {
+    stop();
+}
+
+/**
+ * @brief 复制一个数据包到环中 仅由单个生产者线程调用 不等待
+ * @param data 数据包
+ * @param sender 发送方
+ * @param source 来源
+ * @param now 接收时的单调时间 ns
+ * @return false 环已满或数据包过长 已丢弃
+ */
+bool PacketRecorder::push (const std::span<const char> data, const ip::udp::endpoint &sender,
+                           const PacketRecord::Source source, const int64_t now) {
+    if (data.size() > PacketRecord::MAX_DATA) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    const size_t size = PacketRecord::size(data.size());
+    const uint64_t position = head.load(std::memory_order_relaxed);
+    if (position + size - cachedTail > capacity) {
+        cachedTail = tail.load(std::memory_order_acquire);
+        if (position + size - cachedTail > capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    // 环后有一条最大记录的余量 记录总是连续存放
+    char *dst = ring.get() + (position & (capacity - 1));
+    const int64_t time = now - startTime;
+    const auto length = static_cast<uint32_t>(data.size());
+    const uint16_t port = sender.port();
+    const ip::address address = sender.address();
+    std::memcpy(dst, &time, 8);
+    std::memcpy(dst + 8, &length, 4);
+    std::memcpy(dst + 12, &port, 2);
+    dst[14] = static_cast<char>(source);
+    std::memset(dst + 16, 0x00, 16);
+    if (address.is_v6()) {
+        dst[15] = 6;
+        const auto bytes = address.to_v6().to_bytes();
+        std::memcpy(dst + 16, bytes.data(), bytes.size());
+    } else {
+        dst[15] = 4;
+        const auto bytes = address.to_v4().to_bytes();
+        std::memcpy(dst + 16, bytes.data(), bytes.size());
+    }
+    std::memcpy(dst + PacketRecord::HEADER, data.data(), length);
+    std::memset(dst + PacketRecord::HEADER + length, 0x00, size - PacketRecord::HEADER - length);
+    head.store(position + size, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief 写完环中剩余数据 截断文件到有效长度 可重复调用
+ */
+PacketRecorder::Report PacketRecorder::stop () {
+    running.store(false, std::memory_order_release);
+    if (writer.joinable())
+        writer.join();
+    return report();
+}
+
+PacketRecorder::Report PacketRecorder::report () const {
+    return {
+        recorded.load(std::memory_order_relaxed),
+        dropped.load(std::memory_order_relaxed),
+        written.load(std::memory_order_relaxed),
+    };
+}
+
+/**
+ * @brief 写线程 取出环中的记录追加到映射 空闲时休眠
+ */
+void PacketRecorder::run () {
+    while (true) {
+        // 先读停止标志 停止前推入的记录都会被写出
+        const bool stopping = !running.load(std::memory_order_acquire);
+        const uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t position = tail.load(std::memory_order_relaxed);
+        while (position != end) {
+            const char *src = ring.get() + (position & (capacity - 1));
+            uint32_t length;
+            std::memcpy(&length, src + 8, 4);
+            const size_t size = PacketRecord::size(length);
+            if (append(src, size))
+                recorded.fetch_add(1, std::memory_order_relaxed);
+            else
+                dropped.fetch_add(1, std::memory_order_relaxed);
+            position += size;
+            tail.store(position, std::memory_order_release);
+        }
+        if (stopping)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    finish();
+}
+
+/**
+ * @brief 追加到文件末尾 映射用尽时扩展文件
+ * @return 是否完整写入 失败时文件有效长度不变
+ */
+bool PacketRecorder::append (const char *src, size_t length) {
+    size_t offset = written.load(std::memory_order_relaxed);
+    while (length > 0) {
+        if (failed)
+            return false;
+        const size_t end = regionOffset + region.get_size();
+        if (offset == end) {
+            mapSegment(end);
+            continue;
+        }
+        const size_t n = std::min(length, end - offset);
+        std::memcpy(static_cast<char*>(region.get_address()) + (offset - regionOffset), src, n);
+        src += n;
+        length -= n;
+        offset += n;
+    }
+    written.store(offset, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief 扩展文件并映射从 offset 开始的一段
+ * @param offset 文件偏移 SEGMENT 的整数倍 满足映射对齐
+ */
+bool PacketRecorder::mapSegment (const size_t offset) {
+    try {
+        region = bip::mapped_region();
+        std::filesystem::resize_file(path, offset + SEGMENT);
+        region = bip::mapped_region(mapping, bip::read_write, offset, SEGMENT);
+        regionOffset = offset;
+        return true;
+    } catch (const std::exception &) { // 磁盘已满等 之后的记录全部丢弃
+        failed = true;
+        return false;
+    }
+}
+
+void PacketRecorder::finish () {
+    if (region.get_size() != 0)
+        region.flush();
+    region = bip::mapped_region();
+    mapping = bip::file_mapping();
+    std::error_code ec;
+    std::filesystem::resize_file(path, written.load(std::memory_order_relaxed), ec);
+}
+
+PacketLog::PacketLog (const std::string &path) {
+    try {
+        mapping = bip::file_mapping(path.c_str(), bip::read_only);
+        region = bip::mapped_region(mapping, bip::read_only);
+    } catch (const std::exception &) { // 不存在或为空
+        return;
+    }
+    const auto *data = static_cast<const char*>(region.get_address());
+    size = region.get_size();
+    uint32_t version{0};
+    if (size < PacketRecord::FILE_HEADER || std::memcmp(data, PacketRecord::MAGIC, sizeof(PacketRecord::MAGIC)) != 0)
+        return;
+    std::memcpy(&version, data + 8, 4);
+    if (version != PacketRecord::VERSION)
+        return;
+    std::memcpy(&wallStart, data + 16, 8);
+    base = data;
+}
+
+PacketLog::PacketLog (PacketLog &&other) noexcept : mapping(std::move(other.mapping)),
+                                                    region(std::move(other.region)),
+                                                    base(std::exchange(other.base, nullptr)),
+                                                    size(other.size),
+                                                    offset(other.offset),
+                                                    wallStart(other.wallStart) {}
+
+PacketLog& PacketLog::operator= (PacketLog &&other) noexcept {
+    if (this != &other) {
+        mapping = std::move(other.mapping);
+        region = std::move(other.region);
+        base = std::exchange(other.base, nullptr);
+        size = other.size;
+        offset = other.offset;
+        wallStart = other.wallStart;
+    }
+    return *this;
+}
+
+/**
+ * @brief 读取下一条记录 数据指向映射 不复制
+ * @return false 已到末尾或记录损坏
+ */
+bool PacketLog::next (PacketRecord &record) {
+    if (base == nullptr || offset + PacketRecord::HEADER > size)
+        return false;
+    const char *src = base + offset;
+    uint32_t length;
+    uint16_t port;
+    std::memcpy(&record.time, src, 8);
+    std::memcpy(&length, src + 8, 4);
+    std::memcpy(&port, src + 12, 2);
+    const auto source = static_cast<uint8_t>(src[14]);
+    if (source == PacketRecord::END || source > PacketRecord::BEACON || length > PacketRecord::MAX_DATA ||
+        offset + PacketRecord::size(length) > size)
+        return false;
+    if (src[15] == 6) {
+        ip::address_v6::bytes_type bytes;
+        std::memcpy(bytes.data(), src + 16, bytes.size());
+        record.sender = ip::udp::endpoint(ip::address_v6(bytes), port);
+    } else {
+        ip::address_v4::bytes_type bytes;
+        std::memcpy(bytes.data(), src + 16, bytes.size());
+        record.sender = ip::udp::endpoint(ip::address_v4(bytes), port);
+    }
+    record.source = static_cast<PacketRecord::Source>(source);
+    record.data = std::span(src + PacketRecord::HEADER, length);
+    offset += PacketRecord::size(length);
+    return true;
+}
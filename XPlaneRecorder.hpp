@@ -0,0 +1,124 @@
+#ifndef XPLANERECORDER_HPP
+#define XPLANERECORDER_HPP
+
+#include <boost/asio/ip/udp.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+
+/**
+ * @brief 原始数据包日志中的一条记录
+ *        文件头 32 字节: "XPUDPLOG" | uint32 版本 | uint32 文件头长度 | int64 开始时的系统时间(ns) | 保留
+ *        记录头 32 字节: int64 相对开始的单调时间(ns) | uint32 长度 | uint16 端口 | uint8 来源 | uint8 地址族(4/6)
+ *                        | 16 字节地址, 之后为数据 补齐到 8 字节
+ */
+struct PacketRecord {
+    enum Source : uint8_t {
+        END = 0, // 文件预扩展的零填充 表示没有更多记录
+        XPLANE = 1, // xp 通信端口
+        BEACON = 2, // 多播信标
+    };
+    static constexpr char MAGIC[8]{'X', 'P', 'U', 'D', 'P', 'L', 'O', 'G'};
+    static constexpr uint32_t VERSION{1};
+    static constexpr size_t FILE_HEADER{32};
+    static constexpr size_t HEADER{32};
+    static constexpr size_t MAX_DATA{1472};
+    static constexpr size_t MAX_SIZE{HEADER + MAX_DATA};
+
+    /**
+     * @return 长度为 length 的数据包记录占用的字节数
+     */
+    static constexpr size_t size (const size_t length) { return HEADER + ((length + 7) & ~size_t{7}); }
+
+    int64_t time{0}; // 相对记录开始的单调时间 ns
+    Source source{END};
+    boost::asio::ip::udp::endpoint sender;
+    std::span<const char> data; // 指向日志映射 日志关闭后失效
+};
+
+/**
+ * @brief 追加写入的内存映射数据包日志
+ *        io 线程只把数据包复制进单生产者单消费者环, 由后台线程写入映射 环满时丢弃并计数 从不阻塞 io 线程
+ */
+class PacketRecorder {
+    public:
+        struct Report {
+            uint64_t recorded; // 已写入
+            uint64_t dropped; // 环满或写入失败而丢弃
+            uint64_t bytes; // 文件有效长度
+        };
+        static constexpr size_t DEFAULT_RING{8 << 20}; // 约 5000 个满长度数据包
+        static constexpr size_t SEGMENT{64 << 20}; // 每次扩展文件与映射的长度
+
+        /**
+         * @param path 日志文件 已存在时覆盖
+         * @param ringBytes 内存环大小 向上取为 2 的幂
+         * @throw std::runtime_error 无法创建或映射文件
+         */
+        explicit PacketRecorder (const std::string &path, size_t ringBytes = DEFAULT_RING);
+        ~PacketRecorder ();
+        PacketRecorder (const PacketRecorder &) = delete;
+        PacketRecorder& operator= (const PacketRecorder &) = delete;
+
+        bool push (std::span<const char> data, const boost::asio::ip::udp::endpoint &sender,
+                   PacketRecord::Source source, int64_t now);
+        Report stop ();
+        [[nodiscard]] Report report () const;
+
+    private:
+        std::string path;
+        size_t capacity;
+        std::unique_ptr<char[]> ring; // capacity + MAX_SIZE 记录从不跨越末尾
+        int64_t startTime; // 单调时间 ns
+        alignas(64) std::atomic<uint64_t> head{0}; // 生产者写入位置
+        uint64_t cachedTail{0}; // 生产者缓存的 tail 仅在空间不足时重新读取
+        alignas(64) std::atomic<uint64_t> tail{0}; // 写线程读取位置
+        alignas(64) std::atomic<uint64_t> recorded{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> written{0};
+        std::atomic<bool> running{true};
+        // 以下仅写线程访问
+        boost::interprocess::file_mapping mapping;
+        boost::interprocess::mapped_region region;
+        size_t regionOffset{0}; // 当前映射在文件中的起点
+        bool failed{false};
+        std::thread writer;
+
+        void run ();
+        bool append (const char *src, size_t length);
+        bool mapSegment (size_t offset);
+        void finish ();
+};
+
+/**
+ * @brief 只读映射数据包日志 按写入顺序遍历
+ */
+class PacketLog {
+    public:
+        /**
+         * @param path 日志文件 不存在或格式不符时 isOpen() 为 false
+         */
+        explicit PacketLog (const std::string &path);
+        PacketLog (PacketLog &&other) noexcept;
+        PacketLog& operator= (PacketLog &&other) noexcept;
+
+        [[nodiscard]] bool isOpen () const { return base != nullptr; }
+        [[nodiscard]] int64_t startTime () const { return wallStart; }
+        bool next (PacketRecord &record);
+        void rewind () { offset = PacketRecord::FILE_HEADER; }
+
+    private:
+        boost::interprocess::file_mapping mapping;
+        boost::interprocess::mapped_region region;
+        const char *base{nullptr};
+        size_t size{0};
+        size_t offset{PacketRecord::FILE_HEADER};
+        int64_t wallStart{0}; // 系统时间 ns
+};
+
+#endif
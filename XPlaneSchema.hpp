@@ -0,0 +1,118 @@
+#ifndef XPLANESCHEMA_HPP
+#define XPLANESCHEMA_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+/**
+ * @brief 成员类型的 dataref 长度 支持算术类型与其 std::array
+ */
+template <typename T>
+struct SchemaTraits {
+    static_assert(std::is_arithmetic_v<T>, "schema member must be arithmetic or std::array of arithmetic");
+    static constexpr int length{1};
+    static constexpr bool isArray{false};
+};
+template <typename T, size_t N>
+struct SchemaTraits<std::array<T, N>> {
+    static_assert(std::is_arithmetic_v<T>, "schema member must be arithmetic or std::array of arithmetic");
+    static_assert(N > 0, "empty dataref array");
+    static constexpr int length{static_cast<int>(N)};
+    static constexpr bool isArray{true};
+};
+
+/**
+ * @brief 运行期字段描述 供 XPlaneUdp 分配位置与生成 RREF
+ */
+struct SchemaLayout {
+    std::string_view name;
+    int offset; // 相对 schema 起点的位置
+    int length;
+    int32_t freq;
+    bool isArray;
+};
+
+/**
+ * @brief 一个字段 dataref 名称 结构体成员 频率
+ */
+template <typename S, typename M>
+struct SchemaField {
+    using Struct = S;
+    using Member = M;
+    static constexpr int length{SchemaTraits<M>::length};
+    static constexpr bool isArray{SchemaTraits<M>::isArray};
+    std::string_view name;
+    M S::*member;
+    int32_t freq;
+};
+
+template <typename S, typename M>
+constexpr SchemaField<S, M> schemaField (const std::string_view name, M S::*member, const int32_t freq = 1) {
+    return {name, member, freq};
+}
+
+/**
+ * @brief 编译期 dataref 结构 字段在 values 中连续排列 顺序与声明一致
+ * @tparam S 目标结构体
+ */
+template <typename S, typename... Fields>
+class DatarefSchema {
+    static_assert(sizeof...(Fields) > 0, "empty schema");
+    static_assert((std::is_same_v<S, typename Fields::Struct> && ...), "all fields must belong to the same struct");
+    public:
+        using Struct = S;
+        static constexpr size_t FIELD_COUNT{sizeof...(Fields)};
+        static constexpr int LENGTH{(Fields::length + ...)}; // 占用的位置总数
+
+        constexpr explicit DatarefSchema (const Fields &... fields) : fields(fields...) {}
+
+        /**
+         * @brief 各字段位置 偏移为前面字段长度之和
+         */
+        [[nodiscard]] constexpr std::array<SchemaLayout, FIELD_COUNT> layout () const {
+            std::array<SchemaLayout, FIELD_COUNT> result{};
+            int offset = 0;
+            size_t i = 0;
+            std::apply([&](const auto &... field) {
+                ((result[i++] = SchemaLayout{field.name, offset, field.length, field.freq, field.isArray},
+                  offset += field.length), ...);
+            }, fields);
+            return result;
+        }
+
+        /**
+         * @brief 按顺序填充结构体 一次遍历
+         * @param dst 目标
+         * @param get 读取 get(offset) 返回 float
+         */
+        template <typename Getter>
+        void fill (S &dst, Getter &&get) const {
+            int offset = 0;
+            std::apply([&](const auto &... field) { (fillField(dst, field, get, offset), ...); }, fields);
+        }
+    private:
+        std::tuple<Fields...> fields;
+
+        template <typename Field, typename Getter>
+        static void fillField (S &dst, const Field &field, Getter &get, int &offset) {
+            using M = typename Field::Member;
+            auto &target = dst.*field.member;
+            if constexpr (Field::isArray) {
+                for (int i = 0; i < Field::length; ++i)
+                    target[i] = static_cast<typename M::value_type>(get(offset + i));
+            } else {
+                target = static_cast<M>(get(offset));
+            }
+            offset += Field::length;
+        }
+};
+
+template <typename S, typename... Members>
+constexpr auto makeSchema (const SchemaField<S, Members> &... fields) {
+    return DatarefSchema<S, SchemaField<S, Members>...>(fields...);
+}
+
+#endif
@@ -0,0 +1,567 @@
+#include "XPlaneSeries.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace bip = boost::interprocess;
+
+static constexpr size_t BLOCK_HEADER{28}; // 不含各通道列长度
+static constexpr size_t INDEX_ENTRY{32};
+static constexpr size_t INDEX_TAIL{24};
+
+/**
+ * @brief 高位在前的位写入 每满 32 位写出一次 容量由调用方预先保证
+ */
+class BitWriter {
+    public:
+        void reset (const size_t capacity) {
+            if (out.size() < capacity)
+                out.resize(capacity);
+            used = 0;
+            acc = 0;
+            count = 0;
+        }
+        void put (const uint64_t value, const int bits) { // bits <= 32
+            // acc 中高于 count 的旧位在写出时被截断 无需清除
+            acc = acc << bits | (value & ((uint64_t{1} << bits) - 1));
+            count += bits;
+            if (count >= 32) {
+                count -= 32;
+                const auto word = static_cast<uint32_t>(acc >> count);
+                out[used] = static_cast<uint8_t>(word >> 24);
+                out[used + 1] = static_cast<uint8_t>(word >> 16);
+                out[used + 2] = static_cast<uint8_t>(word >> 8);
+                out[used + 3] = static_cast<uint8_t>(word);
+                used += 4;
+            }
+        }
+        void putWide (const uint64_t value, const int bits) { // bits <= 64
+            if (bits > 32) {
+                put(value >> 32, bits - 32);
+                put(value, 32);
+            } else {
+                put(value, bits);
+            }
+        }
+        void finish () {
+            for (int remaining = count; remaining > 0; remaining -= 8)
+                out[used++] = static_cast<uint8_t>(remaining >= 8 ? acc >> (remaining - 8) : acc << (8 - remaining));
+            count = 0;
+        }
+        [[nodiscard]] const uint8_t* data () const { return out.data(); }
+        [[nodiscard]] size_t size () const { return used; }
+    private:
+        std::vector<uint8_t> out;
+        size_t used{0};
+        uint64_t acc{0};
+        int count{0};
+};
+
+class BitReader {
+    public:
+        BitReader (const uint8_t *input, const size_t length) : data(input), size(length) {}
+        uint64_t get (const int bits) { // bits <= 32
+            if (bits == 0)
+                return 0;
+            while (count < bits) {
+                acc = acc << 8 | (pos < size ? data[pos] : 0);
+                ++pos;
+                count += 8;
+            }
+            count -= bits;
+            return acc >> count & ((uint64_t{1} << bits) - 1);
+        }
+        uint64_t getWide (const int bits) {
+            if (bits > 32) {
+                const uint64_t high = get(bits - 32);
+                return high << 32 | get(32);
+            }
+            return get(bits);
+        }
+    private:
+        const uint8_t *data;
+        size_t size;
+        size_t pos{0};
+        uint64_t acc{0};
+        int count{0};
+};
+
+static int widthOf (const SeriesWriter::Type type) {
+    return type == SeriesWriter::FLOAT64 ? 64 : 32;
+}
+
+/**
+ * @brief 异或压缩一列: 与上一值相同写 0, 有效位落在上次窗口内写 10 + 窗口内的位, 否则写 11 + 前导零 + 长度 + 有效位
+ *        每通道一个 写线程按行依次送入各列 顺序读取块内存
+ */
+struct SeriesWriter::ColumnEncoder {
+    BitWriter bits;
+    int width{32};
+    int fieldBits{5};
+    uint64_t prev{0};
+    int prevLead{-1}, prevTrail{0};
+
+    void start (const uint64_t value, const size_t rows) {
+        bits.reset(rows * 10 + 16); // 每个值最多 2 + 6 + 6 + 64 位
+        bits.putWide(value, width);
+        prev = value;
+        prevLead = -1;
+        prevTrail = 0;
+    }
+    void add (const uint64_t value) {
+        const uint64_t x = value ^ prev;
+        prev = value;
+        if (x == 0) {
+            bits.put(0, 1);
+            return;
+        }
+        const int lead = std::countl_zero(x) - (64 - width);
+        const int trail = std::countr_zero(x);
+        if (prevLead >= 0 && lead >= prevLead && trail >= prevTrail) {
+            bits.put(0b10, 2);
+            bits.putWide(x >> prevTrail, width - prevLead - prevTrail);
+        } else {
+            const int length = width - lead - trail;
+            bits.put(0b11, 2);
+            bits.put(static_cast<uint64_t>(lead), fieldBits);
+            bits.put(static_cast<uint64_t>(length - 1), fieldBits);
+            bits.putWide(x >> trail, length);
+            prevLead = lead;
+            prevTrail = trail;
+        }
+    }
+};
+
+static void decodeColumn (const uint8_t *data, const size_t length, const size_t rows, const int width,
+                          uint64_t *column) {
+    BitReader bits(data, length);
+    const int fieldBits = width == 64 ? 6 : 5;
+    uint64_t prev = bits.getWide(width);
+    column[0] = prev;
+    int lead = 0, trail = 0;
+    for (size_t r = 1; r < rows; ++r) {
+        if (bits.get(1) != 0) {
+            if (bits.get(1) != 0) {
+                lead = static_cast<int>(bits.get(fieldBits));
+                trail = width - lead - static_cast<int>(bits.get(fieldBits)) - 1;
+            }
+            prev ^= bits.getWide(width - lead - trail) << trail;
+        }
+        column[r] = prev;
+    }
+}
+
+/**
+ * @brief 时间列 第一行在块头 之后为二阶差分的 zigzag 变长整数
+ */
+static void encodeTimes (const int64_t *times, const size_t rows, std::vector<uint8_t> &out) {
+    int64_t prevDelta = 0;
+    for (size_t r = 1; r < rows; ++r) {
+        const int64_t delta = times[r] - times[r - 1];
+        const int64_t dod = delta - prevDelta;
+        prevDelta = delta;
+        uint64_t zigzag = static_cast<uint64_t>(dod) << 1 ^ static_cast<uint64_t>(dod >> 63);
+        while (zigzag >= 0x80) {
+            out.push_back(static_cast<uint8_t>(zigzag | 0x80));
+            zigzag >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(zigzag));
+    }
+}
+
+static void decodeTimes (const uint8_t *data, const size_t length, const int64_t first, const size_t rows,
+                         int64_t *times) {
+    times[0] = first;
+    int64_t delta = 0;
+    size_t pos = 0;
+    for (size_t r = 1; r < rows; ++r) {
+        uint64_t zigzag = 0;
+        for (int shift = 0; pos < length && shift < 64; shift += 7) {
+            const uint8_t byte = data[pos++];
+            zigzag |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                break;
+        }
+        delta += static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        times[r] = times[r - 1] + delta;
+    }
+}
+
+template <typename T>
+static T load (const uint8_t *src) {
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    return value;
+}
+
+SeriesWriter::SeriesWriter (const std::string &path, std::vector<Channel> channelList, const size_t rowsInBlock,
+                            const int64_t wallOffset)
+    : channels(std::move(channelList)), blockRows(std::max<size_t>(rowsInBlock, 1)), row(channels.size(), 0) {
+    if (channels.empty())
+        throw std::runtime_error("Series needs at least one channel: " + path);
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        throw std::runtime_error("Failed to open file: " + path);
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    // 文件头
+    const auto channelCount = static_cast<uint32_t>(channels.size());
+    const auto rowsPerBlock = static_cast<uint32_t>(blockRows);
+    const uint32_t reserved{0};
+    put(MAGIC, sizeof(MAGIC));
+    put(&VERSION, 4);
+    put(&channelCount, 4);
+    put(&rowsPerBlock, 4);
+    put(&reserved, 4);
+    put(&wallOffset, 8);
+    for (const auto &[name, type] : channels) {
+        const auto nameLength = static_cast<uint16_t>(std::min<size_t>(name.size(), UINT16_MAX));
+        put(&type, 1);
+        put(&nameLength, 2);
+        put(name.data(), nameLength);
+    }
+    encoders.resize(channels.size());
+    for (size_t c = 0; c < channels.size(); ++c) {
+        encoders[c].width = widthOf(channels[c].type);
+        encoders[c].fieldBits = encoders[c].width == 64 ? 6 : 5;
+    }
+    for (size_t i = 0; i < QUEUE_BLOCKS; ++i) {
+        auto &block = blocks.emplace_back(std::make_unique<Block>());
+        block->times.resize(blockRows);
+        block->values.resize(blockRows * channels.size());
+        freeBlocks.push_back(block.get());
+    }
+    current = freeBlocks.back();
+    freeBlocks.pop_back();
+    writer = std::thread([this] () { run(); });
+}
+
+SeriesWriter::~SeriesWriter () {
+    close();
+}
+
+/**
+ * @brief 开始新的一行
+ * @param time 时间戳 ns 应单调不减
+ */
+void SeriesWriter::begin (const int64_t time) {
+    rowTime = time;
+    column = 0;
+}
+
+void SeriesWriter::write (const float value) {
+    if (column == channels.size())
+        return;
+    if (channels[column].type == FLOAT32)
+        row[column] = std::bit_cast<uint32_t>(value);
+    else
+        row[column] = std::bit_cast<uint64_t>(static_cast<double>(value));
+    ++column;
+}
+
+void SeriesWriter::write (const double value) {
+    if (column == channels.size())
+        return;
+    if (channels[column].type == FLOAT32)
+        row[column] = std::bit_cast<uint32_t>(static_cast<float>(value));
+    else
+        row[column] = std::bit_cast<uint64_t>(value);
+    ++column;
+}
+
+void SeriesWriter::write (const std::span<const float> value) {
+    for (const float v : value)
+        write(v);
+}
+
+/**
+ * @brief 结束当前行 复制到块中 块满时交给写线程
+ * @param wait 全部块都在等待写入时是否等待 为 false 时丢弃本行
+ * @return false 本行被丢弃
+ */
+bool SeriesWriter::end (const bool wait) {
+    if (!current) {
+        std::unique_lock lock(queueMutex);
+        if (wait)
+            queueCond.wait(lock, [this] { return !freeBlocks.empty(); });
+        if (!freeBlocks.empty()) {
+            current = freeBlocks.back();
+            freeBlocks.pop_back();
+        }
+    }
+    if (!current) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    const size_t r = current->rows;
+    current->times[r] = rowTime;
+    std::ranges::copy(row, current->values.begin() + static_cast<ptrdiff_t>(r * channels.size()));
+    if (++current->rows == blockRows) {
+        {
+            std::lock_guard lock(queueMutex);
+            readyBlocks.push_back(current);
+        }
+        current = nullptr;
+        queueCond.notify_all();
+    }
+    return true;
+}
+
+/**
+ * @brief 写出未满的块与文件尾 由生产者线程调用 可重复调用
+ */
+SeriesWriter::Report SeriesWriter::close () {
+    if (!writer.joinable())
+        return report();
+    {
+        std::lock_guard lock(queueMutex);
+        if (current && current->rows > 0)
+            readyBlocks.push_back(current);
+        current = nullptr;
+        closing = true;
+    }
+    queueCond.notify_all();
+    writer.join();
+    return report();
+}
+
+SeriesWriter::Report SeriesWriter::report () const {
+    size_t rowBytes = 8;
+    for (const auto &channel : channels)
+        rowBytes += static_cast<size_t>(widthOf(channel.type)) / 8;
+    const uint64_t written = rows.load(std::memory_order_relaxed);
+    return {
+        written,
+        dropped.load(std::memory_order_relaxed),
+        blockCount.load(std::memory_order_relaxed),
+        bytes.load(std::memory_order_relaxed),
+        written * rowBytes,
+    };
+}
+
+/**
+ * @brief 写线程 压缩并写出就绪的块 结束时写文件尾
+ */
+void SeriesWriter::run () {
+    while (true) {
+        Block *block;
+        {
+            std::unique_lock lock(queueMutex);
+            queueCond.wait(lock, [this] { return closing || !readyBlocks.empty(); });
+            if (readyBlocks.empty())
+                break;
+            block = readyBlocks.front();
+            readyBlocks.pop_front();
+        }
+        writeBlock(*block);
+        {
+            std::lock_guard lock(queueMutex);
+            block->rows = 0;
+            freeBlocks.push_back(block);
+        }
+        queueCond.notify_all();
+    }
+    writeFooter();
+    std::fclose(file);
+    file = nullptr;
+}
+
+void SeriesWriter::writeBlock (const Block &block) {
+    const size_t count = block.rows;
+    const size_t width = channels.size();
+    encoded.clear();
+    encodeTimes(block.times.data(), count, encoded);
+    const auto timeBytes = static_cast<uint32_t>(encoded.size());
+    const uint64_t *values = block.values.data();
+    for (size_t c = 0; c < width; ++c)
+        encoders[c].start(values[c], count);
+    for (size_t r = 1; r < count; ++r) {
+        const uint64_t *line = values + r * width;
+        for (size_t c = 0; c < width; ++c)
+            encoders[c].add(line[c]);
+    }
+    std::vector<uint32_t> lengths(width);
+    for (size_t c = 0; c < width; ++c) {
+        encoders[c].bits.finish();
+        lengths[c] = static_cast<uint32_t>(encoders[c].bits.size());
+    }
+    const IndexEntry entry{bytes.load(std::memory_order_relaxed), block.times[0], block.times[count - 1],
+                           static_cast<uint32_t>(count)};
+    put(BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+    put(&entry.rows, 4);
+    put(&entry.firstTime, 8);
+    put(&entry.lastTime, 8);
+    put(&timeBytes, 4);
+    put(lengths.data(), lengths.size() * 4);
+    put(encoded.data(), encoded.size());
+    for (const auto &encoder : encoders)
+        put(encoder.bits.data(), encoder.bits.size());
+    index.push_back(entry);
+    rows.fetch_add(count, std::memory_order_relaxed);
+    blockCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SeriesWriter::writeFooter () {
+    const uint64_t indexOffset = bytes.load(std::memory_order_relaxed);
+    const uint32_t reserved{0};
+    for (const auto &entry : index) {
+        put(&entry.offset, 8);
+        put(&entry.firstTime, 8);
+        put(&entry.lastTime, 8);
+        put(&entry.rows, 4);
+        put(&reserved, 4);
+    }
+    const uint64_t count = index.size();
+    put(&indexOffset, 8);
+    put(&count, 8);
+    put(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+}
+
+void SeriesWriter::put (const void *data, const size_t length) {
+    std::fwrite(data, 1, length, file);
+    bytes.fetch_add(length, std::memory_order_relaxed);
+}
+
+SeriesReader::SeriesReader (const std::string &path) {
+    try {
+        mapping = bip::file_mapping(path.c_str(), bip::read_only);
+        region = bip::mapped_region(mapping, bip::read_only);
+    } catch (const std::exception &) { // 不存在或为空
+        return;
+    }
+    const auto *data = static_cast<const uint8_t*>(region.get_address());
+    size = region.get_size();
+    if (size < 32 || std::memcmp(data, SeriesWriter::MAGIC, sizeof(SeriesWriter::MAGIC)) != 0 ||
+        load<uint32_t>(data + 8) != SeriesWriter::VERSION)
+        return;
+    const uint32_t channelCount = load<uint32_t>(data + 12);
+    clockOffset = load<int64_t>(data + 24);
+    size_t offset = 32;
+    for (uint32_t i = 0; i < channelCount; ++i) {
+        if (offset + 3 > size)
+            return;
+        const auto type = static_cast<SeriesWriter::Type>(data[offset]);
+        const auto nameLength = load<uint16_t>(data + offset + 1);
+        offset += 3;
+        if (offset + nameLength > size)
+            return;
+        channels.push_back({std::string(reinterpret_cast<const char*>(data + offset), nameLength), type});
+        offset += nameLength;
+    }
+    base = data;
+    if (!loadIndex(offset))
+        scanBlocks(offset);
+}
+
+/**
+ * @return 通道下标 不存在时为 -1
+ */
+int SeriesReader::findChannel (const std::string_view name) const {
+    for (size_t i = 0; i < channels.size(); ++i) {
+        if (channels[i].name == name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+size_t SeriesReader::rowCount () const {
+    size_t count = 0;
+    for (const auto &block : blocks)
+        count += block.rows;
+    return count;
+}
+
+/**
+ * @brief 读取一个通道在 [from, to] 内的全部行 追加到 times 与 values
+ * @param channel 通道下标
+ * @param from 起始时间 ns 包含
+ * @param to 结束时间 ns 包含
+ * @return 追加的行数
+ */
+size_t SeriesReader::read (const size_t channel, const int64_t from, const int64_t to, std::vector<int64_t> &times,
+                           std::vector<double> &values) const {
+    if (!base || channel >= channels.size())
+        return 0;
+    const int width = widthOf(channels[channel].type);
+    std::vector<int64_t> blockTimes;
+    std::vector<uint64_t> column;
+    size_t appended = 0;
+    auto it = std::ranges::lower_bound(blocks, from, {}, &BlockInfo::lastTime);
+    for (; it != blocks.end() && it->firstTime <= to; ++it) {
+        const uint8_t *header = base + it->offset;
+        const uint32_t timeBytes = load<uint32_t>(header + 24);
+        const uint8_t *lengthTable = header + BLOCK_HEADER;
+        size_t columnOffset = timeBytes;
+        for (size_t c = 0; c < channel; ++c)
+            columnOffset += load<uint32_t>(lengthTable + c * 4);
+        const uint8_t *payload = lengthTable + channels.size() * 4;
+        blockTimes.resize(it->rows);
+        column.resize(it->rows);
+        decodeTimes(payload, timeBytes, it->firstTime, it->rows, blockTimes.data());
+        decodeColumn(payload + columnOffset, load<uint32_t>(lengthTable + channel * 4), it->rows, width,
+                     column.data());
+        for (size_t r = 0; r < it->rows; ++r) {
+            if (blockTimes[r] < from || blockTimes[r] > to)
+                continue;
+            times.push_back(blockTimes[r]);
+            values.push_back(width == 64 ? std::bit_cast<double>(column[r])
+                                         : std::bit_cast<float>(static_cast<uint32_t>(column[r])));
+            ++appended;
+        }
+    }
+    return appended;
+}
+
+/**
+ * @brief 读取文件尾的块索引
+ * @return 文件尾完整
+ */
+bool SeriesReader::loadIndex (const size_t dataStart) {
+    if (size < dataStart + INDEX_TAIL ||
+        std::memcmp(base + size - 8, SeriesWriter::INDEX_MAGIC, sizeof(SeriesWriter::INDEX_MAGIC)) != 0)
+        return false;
+    const auto indexOffset = load<uint64_t>(base + size - INDEX_TAIL);
+    const auto count = load<uint64_t>(base + size - INDEX_TAIL + 8);
+    if (indexOffset < dataStart || indexOffset + count * INDEX_ENTRY + INDEX_TAIL != size)
+        return false;
+    for (uint64_t i = 0; i < count; ++i) {
+        const uint8_t *entry = base + indexOffset + i * INDEX_ENTRY;
+        const BlockInfo block{load<uint64_t>(entry), load<int64_t>(entry + 8), load<int64_t>(entry + 16),
+                              load<uint32_t>(entry + 24)};
+        if (block.rows == 0 || block.offset + blockLength(block.offset) > indexOffset)
+            return false;
+        blocks.push_back(block);
+    }
+    return true;
+}
+
+/**
+ * @brief 无文件尾时依次读取块头 截断的块被忽略
+ */
+void SeriesReader::scanBlocks (size_t offset) {
+    blocks.clear();
+    while (true) {
+        const size_t length = blockLength(offset);
+        if (length == 0 || offset + length > size)
+            return;
+        const uint8_t *header = base + offset;
+        const uint32_t count = load<uint32_t>(header + 4);
+        if (count == 0)
+            return;
+        blocks.push_back({offset, load<int64_t>(header + 8), load<int64_t>(header + 16), count});
+        offset += length;
+    }
+}
+
+/**
+ * @return 从 offset 开始的块总长度 块头不完整或标记不符时为 0
+ */
+size_t SeriesReader::blockLength (const size_t offset) const {
+    const size_t tableEnd = offset + BLOCK_HEADER + channels.size() * 4;
+    if (tableEnd > size || std::memcmp(base + offset, SeriesWriter::BLOCK_MAGIC, sizeof(SeriesWriter::BLOCK_MAGIC)) != 0)
+        return 0;
+    size_t length = BLOCK_HEADER + channels.size() * 4 + load<uint32_t>(base + offset + 24);
+    for (size_t c = 0; c < channels.size(); ++c)
+        length += load<uint32_t>(base + offset + BLOCK_HEADER + c * 4);
+    return length;
+}
@@ -0,0 +1,157 @@
+#ifndef XPLANESERIES_HPP
+#define XPLANESERIES_HPP
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 列式时间序列文件写入 每行一个时间戳与每个通道一个值
+ *        按行复制进块 块满后交给后台线程逐列压缩写入: 时间列为二阶差分, 数值列与上一值异或后只保存有效位
+ *
+ *        行时间需单调不减 (块按末行时间二分查找) 通常为 steady_clock 文件头中的时钟偏移换算为系统时间
+ *
+ *        文件头: "XPUDPSER" | uint32 版本 | uint32 通道数 | uint32 块行数 | uint32 保留 | int64 时钟偏移
+ *                | 每个通道 uint8 类型 uint16 名称长度 名称
+ *        数据块: "SBLK" | uint32 行数 | int64 首行时间 | int64 末行时间 | uint32 时间列长度 | uint32 各通道列长度
+ *                | 时间列 | 各通道列
+ *        文件尾: 每块 uint64 偏移 int64 首行时间 int64 末行时间 uint32 行数 uint32 保留
+ *                | uint64 索引偏移 | uint64 块数 | "XPSERIDX"
+ */
+class SeriesWriter {
+    public:
+        enum Type : uint8_t {
+            FLOAT32 = 0,
+            FLOAT64 = 1,
+        };
+        struct Channel {
+            std::string name;
+            Type type{FLOAT32};
+        };
+        struct Report {
+            uint64_t rows; // 已写入
+            uint64_t dropped; // 写线程跟不上而丢弃
+            uint64_t blocks;
+            uint64_t bytes; // 已写入的文件长度
+            uint64_t rawBytes; // 不压缩时的长度 每行 8 字节时间 + 每通道 4/8 字节
+        };
+        static constexpr char MAGIC[8]{'X', 'P', 'U', 'D', 'P', 'S', 'E', 'R'};
+        static constexpr char BLOCK_MAGIC[4]{'S', 'B', 'L', 'K'};
+        static constexpr char INDEX_MAGIC[8]{'X', 'P', 'S', 'E', 'R', 'I', 'D', 'X'};
+        static constexpr uint32_t VERSION{2};
+        static constexpr size_t DEFAULT_BLOCK_ROWS{1024};
+        static constexpr size_t QUEUE_BLOCKS{4}; // 含正在填充的块 全部在等待写入时丢弃新行
+
+        /**
+         * @param path 文件 已存在时覆盖
+         * @param channelList 通道 顺序即每行 write 的顺序
+         * @param blockRows 每块行数
+         * @param wallOffset 行时间加该值为系统时间 ns 只记录在文件头
+         * @throw std::runtime_error 无法创建文件
+         */
+        SeriesWriter (const std::string &path, std::vector<Channel> channelList, size_t blockRows = DEFAULT_BLOCK_ROWS,
+                      int64_t wallOffset = 0);
+        ~SeriesWriter ();
+        SeriesWriter (const SeriesWriter &) = delete;
+        SeriesWriter& operator= (const SeriesWriter &) = delete;
+
+        // 以下由同一个生产者线程调用
+        void begin (int64_t time);
+        void write (float value);
+        void write (double value);
+        void write (std::span<const float> value);
+        bool end (bool wait = false);
+        Report close ();
+
+        [[nodiscard]] Report report () const;
+        [[nodiscard]] const std::vector<Channel>& getChannels () const { return channels; }
+
+    private:
+        struct Block {
+            std::vector<int64_t> times;
+            std::vector<uint64_t> values; // 按行存放 blockRows * channels.size() 个值的位表示
+            size_t rows{0};
+        };
+        struct ColumnEncoder; // 单列压缩状态 定义见 cpp
+        struct IndexEntry {
+            uint64_t offset;
+            int64_t firstTime, lastTime;
+            uint32_t rows;
+        };
+        std::vector<Channel> channels;
+        size_t blockRows;
+        std::FILE *file{nullptr};
+        // 生产者
+        std::vector<uint64_t> row; // 当前行 本行未写的通道保持上一行的值
+        int64_t rowTime{0};
+        size_t column{0};
+        Block *current{nullptr};
+        // 块交接
+        std::vector<std::unique_ptr<Block>> blocks;
+        std::vector<Block*> freeBlocks;
+        std::deque<Block*> readyBlocks;
+        std::mutex queueMutex;
+        std::condition_variable queueCond;
+        bool closing{false};
+        // 写线程
+        std::vector<IndexEntry> index;
+        std::vector<ColumnEncoder> encoders; // 每通道一个 按行顺序压缩全部列
+        std::vector<uint8_t> encoded; // 时间列
+        std::atomic<uint64_t> rows{0}, dropped{0}, blockCount{0}, bytes{0};
+        std::thread writer;
+
+        void run ();
+        void writeBlock (const Block &block);
+        void writeFooter ();
+        void put (const void *data, size_t length);
+};
+
+/**
+ * @brief 读取 SeriesWriter 写入的文件 只解码时间窗口内的块中所需的一列
+ *        没有文件尾(写入未正常结束)时顺序扫描块头建立索引
+ */
+class SeriesReader {
+    public:
+        explicit SeriesReader (const std::string &path);
+
+        [[nodiscard]] bool isOpen () const { return base != nullptr; }
+        [[nodiscard]] const std::vector<SeriesWriter::Channel>& getChannels () const { return channels; }
+        [[nodiscard]] int findChannel (std::string_view name) const;
+        [[nodiscard]] size_t rowCount () const;
+        [[nodiscard]] int64_t firstTime () const { return blocks.empty() ? 0 : blocks.front().firstTime; }
+        [[nodiscard]] int64_t lastTime () const { return blocks.empty() ? 0 : blocks.back().lastTime; }
+        [[nodiscard]] int64_t wallOffset () const { return clockOffset; } // 行时间加该值为系统时间 ns
+        size_t read (size_t channel, int64_t from, int64_t to, std::vector<int64_t> &times,
+                     std::vector<double> &values) const;
+
+    private:
+        struct BlockInfo {
+            size_t offset;
+            int64_t firstTime, lastTime;
+            uint32_t rows;
+        };
+        boost::interprocess::file_mapping mapping;
+        boost::interprocess::mapped_region region;
+        const uint8_t *base{nullptr};
+        size_t size{0};
+        std::vector<SeriesWriter::Channel> channels;
+        std::vector<BlockInfo> blocks;
+        int64_t clockOffset{0};
+
+        bool loadIndex (size_t dataStart);
+        void scanBlocks (size_t dataStart);
+        [[nodiscard]] size_t blockLength (size_t offset) const;
+};
+
+#endif
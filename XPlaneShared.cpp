@@ -0,0 +1,256 @@
+#include "XPlaneShared.hpp"
+#include <cstring>
+
+namespace bip = boost::interprocess;
+
+static constexpr size_t alignLine (const size_t size) { return (size + 63) & ~size_t{63}; }
+
+size_t SharedSegment::size (const size_t valueCapacity, const size_t refCapacity) {
+    return alignLine(sizeof(Header)) + alignLine(sizeof(Ref) * refCapacity) + sizeof(std::atomic<float>) * valueCapacity;
+}
+
+SharedSegment SharedSegment::at (void *base, const size_t refCapacity) {
+    auto *bytes = static_cast<char*>(base);
+    SharedSegment segment;
+    segment.header = reinterpret_cast<Header*>(bytes);
+    segment.refs = reinterpret_cast<Ref*>(bytes + alignLine(sizeof(Header)));
+    segment.values = reinterpret_cast<std::atomic<float>*>(
+        bytes + alignLine(sizeof(Header)) + alignLine(sizeof(Ref) * refCapacity));
+    return segment;
+}
+
+SharedPublisher::SharedPublisher (const std::string &name, const size_t valueCapacity, const size_t refCapacity)
+    : name(name) {
+    bip::shared_memory_object::remove(name.c_str());
+    memory = bip::shared_memory_object(bip::create_only, name.c_str(), bip::read_write);
+    const size_t bytes = SharedSegment::size(valueCapacity, refCapacity);
+    memory.truncate(static_cast<bip::offset_t>(bytes));
+    region = bip::mapped_region(memory, bip::read_write, 0, bytes);
+    segment = SharedSegment::at(region.get_address(), refCapacity);
+    // 新建的共享内存为零 在其上构造原子量
+    auto *header = new (segment.header) SharedSegment::Header{};
+    std::memcpy(header->magic, SharedSegment::MAGIC, sizeof(SharedSegment::MAGIC));
+    header->valueCapacity = static_cast<uint32_t>(valueCapacity);
+    header->refCapacity = static_cast<uint32_t>(refCapacity);
+    for (size_t i = 0; i < refCapacity; ++i)
+        new (segment.refs + i) SharedSegment::Ref{};
+    for (size_t i = 0; i < valueCapacity; ++i)
+        new (segment.values + i) std::atomic<float>{0};
+    header->flags.store(SharedSegment::PUBLISHING, std::memory_order_relaxed);
+    header->version.store(SharedSegment::VERSION, std::memory_order_release);
+}
+
+/**
+ * @brief 清除发布标志并删除名称 已映射的读者仍可读取最后的值
+ */
+SharedPublisher::~SharedPublisher () {
+    auto &header = *segment.header;
+    header.lock.write([&] {
+        header.flags.store(header.flags.load(std::memory_order_relaxed) & ~SharedSegment::PUBLISHING,
+                           std::memory_order_relaxed);
+    });
+    bip::shared_memory_object::remove(name.c_str());
+}
+
+/**
+ * @brief 发布目录项 订阅、取消订阅与位置改变时调用 超出容量的 dataref 不发布
+ * @param refIndex dataRefs 下标
+ * @param name dataref 名称
+ * @param start values 中起点 -1 为未订阅
+ * @param end values 中终点
+ */
+void SharedPublisher::publishRef (const size_t refIndex, const std::string_view name, int32_t start,
+                                  const int32_t end) {
+    auto &header = *segment.header;
+    if (refIndex >= header.refCapacity) {
+        overflow.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (end >= static_cast<int32_t>(header.valueCapacity)) {
+        overflow.fetch_add(static_cast<uint64_t>(end - start + 1), std::memory_order_relaxed);
+        start = -1;
+    }
+    SharedSegment::Ref &ref = segment.refs[refIndex];
+    const uint32_t count = header.refCount.load(std::memory_order_relaxed);
+    if (refIndex >= count) { // dataRefs 只追加 新目录项先写名称
+        const size_t length = std::min(name.size(), SharedSegment::NAME_LENGTH - 1);
+        std::memcpy(ref.name, name.data(), length);
+        ref.name[length] = '\0';
+    }
+    header.lock.write([&] {
+        ref.start.store(start, std::memory_order_relaxed);
+        ref.end.store(end, std::memory_order_relaxed);
+    });
+    if (refIndex >= count)
+        header.refCount.store(static_cast<uint32_t>(refIndex + 1), std::memory_order_release);
+}
+
+/**
+ * @brief 发布一个 RREF 数据包解码后的值
+ * @param indices values 中位置
+ * @param decoded 对应的值
+ * @param now 接收时间 steady ns
+ */
+void SharedPublisher::publishValues (const std::span<const int32_t> indices, const std::span<const float> decoded,
+                                     const int64_t now) {
+    auto &header = *segment.header;
+    const auto capacity = static_cast<int32_t>(header.valueCapacity);
+    size_t skipped{0};
+    header.lock.write([&] {
+        for (size_t i = 0; i < indices.size(); ++i) {
+            if (indices[i] < capacity)
+                segment.values[indices[i]].store(decoded[i], std::memory_order_relaxed);
+            else
+                ++skipped;
+        }
+        header.updateTime.store(now, std::memory_order_relaxed);
+    });
+    published.fetch_add(1, std::memory_order_relaxed);
+    if (skipped != 0)
+        overflow.fetch_add(skipped, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 发布全部值 开始发布时调用
+ */
+void SharedPublisher::publishAll (const ValueStore &values, const int64_t now) {
+    auto &header = *segment.header;
+    const size_t count = std::min<size_t>(values.size(), header.valueCapacity);
+    header.lock.write([&] {
+        for (size_t i = 0; i < count; ++i)
+            segment.values[i].store(values.get(i), std::memory_order_relaxed);
+        header.updateTime.store(now, std::memory_order_relaxed);
+    });
+}
+
+/**
+ * @brief 发布基本信息
+ * @param info 基本信息
+ * @param now 接收时间 steady ns 0 为未收到
+ */
+void SharedPublisher::publishInfo (const XPlaneUdp::PlaneInfo &info, const int64_t now) {
+    auto &header = *segment.header;
+    std::array<uint32_t, SharedSegment::INFO_WORDS> words{};
+    std::memcpy(words.data(), &info, sizeof(info));
+    header.lock.write([&] {
+        for (size_t i = 0; i < words.size(); ++i)
+            header.info[i].store(words[i], std::memory_order_relaxed);
+        header.infoTime.store(now, std::memory_order_relaxed);
+        if (now != 0)
+            header.updateTime.store(now, std::memory_order_relaxed);
+    });
+    if (now != 0)
+        published.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 发布与 XPlane 的连接状态
+ */
+void SharedPublisher::publishState (const bool connected) {
+    auto &header = *segment.header;
+    header.lock.write([&] {
+        const uint32_t flags = header.flags.load(std::memory_order_relaxed);
+        header.flags.store(connected ? flags | SharedSegment::CONNECTED : flags & ~SharedSegment::CONNECTED,
+                           std::memory_order_relaxed);
+    });
+}
+
+SharedPublisher::Report SharedPublisher::report () const {
+    return {published.load(std::memory_order_relaxed), overflow.load(std::memory_order_relaxed), region.get_size()};
+}
+
+SharedReader::SharedReader (const std::string &name) {
+    try {
+        memory = bip::shared_memory_object(bip::open_only, name.c_str(), bip::read_only);
+        region = bip::mapped_region(memory, bip::read_only);
+    } catch (const bip::interprocess_exception &) {
+        return;
+    }
+    if (region.get_size() < sizeof(SharedSegment::Header))
+        return;
+    const auto *header = static_cast<const SharedSegment::Header*>(region.get_address());
+    if (header->version.load(std::memory_order_acquire) != SharedSegment::VERSION ||
+        std::memcmp(header->magic, SharedSegment::MAGIC, sizeof(SharedSegment::MAGIC)) != 0 ||
+        SharedSegment::size(header->valueCapacity, header->refCapacity) > region.get_size())
+        return;
+    segment = SharedSegment::at(region.get_address(), header->refCapacity);
+}
+
+/**
+ * @return 发布者仍在运行 异常退出时保持为 true 可结合 lastUpdate 判断
+ */
+bool SharedReader::isPublishing () const {
+    return (segment.header->flags.load(std::memory_order_acquire) & SharedSegment::PUBLISHING) != 0;
+}
+
+/**
+ * @return 发布者与 XPlane 已连接
+ */
+bool SharedReader::isConnected () const {
+    return (segment.header->flags.load(std::memory_order_acquire) & SharedSegment::CONNECTED) != 0;
+}
+
+/**
+ * @return 最后一次发布的 steady 时间 ns
+ */
+int64_t SharedReader::lastUpdate () const {
+    return segment.header->updateTime.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief 按名称查找发布者订阅的 dataref 只需在开始时调用一次 之后用标识读取
+ * @param dataref dataref 名称
+ * @param dst 找到时写入标识
+ * @param index 数组元素 -1 为整个 dataref 与 XPlaneUdp::addDataref 相同
+ * @return 是否找到
+ */
+bool SharedReader::findDataref (const std::string &dataref, DatarefIndex &dst, const int index) const {
+    const std::string name = (index == -1) ? dataref : std::format("{}[{}]", dataref, index);
+    const uint32_t count = segment.header->refCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (std::strncmp(segment.refs[i].name, name.c_str(), SharedSegment::NAME_LENGTH) == 0) {
+            dst = DatarefIndex{i};
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 获取 dataref 最新值
+ * @param dataref findDataref 得到的标识
+ * @param value 返回值
+ * @param defaultValue 未订阅时的值
+ * @return 值可用 发布者在写入区内退出时为 false
+ */
+bool SharedReader::getDataref (const DatarefIndex &dataref, float &value, const float defaultValue) const {
+    if (dataref.getIdx() >= segment.header->refCount.load(std::memory_order_acquire)) {
+        value = defaultValue;
+        return false;
+    }
+    const SharedSegment::Ref &ref = segment.refs[dataref.getIdx()];
+    int32_t start{-1};
+    const bool read = segment.header->lock.tryRead([&] {
+        start = ref.start.load(std::memory_order_relaxed);
+        value = start < 0 ? defaultValue : segment.values[start].load(std::memory_order_relaxed);
+    }, WRITER_TIMEOUT);
+    if (!read)
+        value = defaultValue;
+    return read && start >= 0;
+}
+
+/**
+ * @brief 获取基本信息
+ * @param infoDst 基本信息 未收到 RPOS 时 track 为 -999
+ * @return 是否读到 发布者在写入区内退出时为 false infoDst 不变
+ */
+bool SharedReader::getPlaneInfo (PlaneInfo &infoDst) const {
+    std::array<uint32_t, SharedSegment::INFO_WORDS> words{};
+    if (!segment.header->lock.tryRead([&] {
+        for (size_t i = 0; i < words.size(); ++i)
+            words[i] = segment.header->info[i].load(std::memory_order_relaxed);
+    }, WRITER_TIMEOUT))
+        return false;
+    std::memcpy(&infoDst, words.data(), sizeof(PlaneInfo));
+    return true;
+}
@@ -0,0 +1,172 @@
+#ifndef XPLANESHARED_HPP
+#define XPLANESHARED_HPP
+
+#include "XPlaneUDP.hpp"
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+/**
+ * @brief 共享内存段布局 一个发布者写入 任意多个进程只读映射
+ *        Header | Ref * refCapacity | float * valueCapacity 各部分按 64 字节对齐
+ *        values 与发布者的 values 下标相同 目录项下标与发布者的 DatarefIndex 相同
+ *        目录项名称只追加不修改 先写名称再递增 refCount 其余字段均在 lock 写入区内更新
+ */
+struct SharedSegment {
+    static constexpr char MAGIC[8]{'X', 'P', 'U', 'D', 'P', 'S', 'H', 'M'};
+    static constexpr uint32_t VERSION{1};
+    static constexpr size_t NAME_LENGTH{400}; // 与 RREF 请求中的名称长度相同
+    static constexpr size_t INFO_WORDS{(sizeof(XPlaneUdp::PlaneInfo) + 3) / 4};
+    enum Flags : uint32_t {
+        PUBLISHING = 1, // 发布者在运行 停止时清除
+        CONNECTED = 2, // 发布者与 XPlane 已连接
+    };
+    struct Header {
+        char magic[8];
+        uint32_t valueCapacity;
+        uint32_t refCapacity;
+        std::atomic<uint32_t> version{0}; // 初始化完成后最后写入 读者据此判断是否就绪
+        std::atomic<uint32_t> refCount{0}; // 已发布的目录项
+        SeqLock lock;
+        std::atomic<uint32_t> flags{0};
+        std::atomic<int64_t> updateTime{0}; // 最后一次发布 steady ns
+        std::atomic<int64_t> infoTime{0}; // 最后一个 RPOS steady ns 0 为未收到
+        std::array<std::atomic<uint32_t>, INFO_WORDS> info{}; // PlaneInfo 按字存储
+    };
+    struct Ref {
+        char name[NAME_LENGTH]; // 发布后不再改变
+        std::atomic<int32_t> start{-1}, end{-1}; // values 中 [start, end] 未订阅时 start 为 -1
+    };
+
+    /**
+     * @return 对应容量的共享内存段字节数
+     */
+    static size_t size (size_t valueCapacity, size_t refCapacity);
+    /**
+     * @brief 按容量定位各部分 不检查内容
+     */
+    static SharedSegment at (void *base, size_t refCapacity);
+
+    Header *header{nullptr};
+    Ref *refs{nullptr};
+    std::atomic<float> *values{nullptr};
+};
+
+/**
+ * @brief 把一个 XPlaneUdp 的订阅发布到命名共享内存 由 XPlaneUdp::startPublishing 创建
+ *        全部写入在 XPlaneUdp 的 writeMutex 内进行 读者只读映射 不会阻塞或拖慢写入
+ */
+class SharedPublisher {
+    public:
+        using Report = XPlaneUdp::PublishReport;
+
+        /**
+         * @param name 共享内存名称 已存在时覆盖
+         * @param valueCapacity 最多发布的值 超出 values 中该位置的值不发布
+         * @param refCapacity 最多发布的 dataref
+         * @throw boost::interprocess::interprocess_exception 无法创建或映射
+         */
+        SharedPublisher (const std::string &name, size_t valueCapacity, size_t refCapacity);
+        ~SharedPublisher ();
+        SharedPublisher (const SharedPublisher &) = delete;
+        SharedPublisher& operator= (const SharedPublisher &) = delete;
+
+        void publishRef (size_t refIndex, std::string_view name, int32_t start, int32_t end);
+        void publishValues (std::span<const int32_t> indices, std::span<const float> decoded, int64_t now);
+        void publishAll (const ValueStore &values, int64_t now);
+        void publishInfo (const XPlaneUdp::PlaneInfo &info, int64_t now);
+        void publishState (bool connected);
+        [[nodiscard]] Report report () const;
+
+    private:
+        std::string name;
+        boost::interprocess::shared_memory_object memory;
+        boost::interprocess::mapped_region region;
+        SharedSegment segment;
+        std::atomic<uint64_t> published{0};
+        std::atomic<uint64_t> overflow{0};
+};
+
+/**
+ * @brief 只读映射发布者的共享内存 接口与 XPlaneUdp 相同 读取不进入内核 不写共享内存
+ *        发布者停止后映射仍有效 值停在最后一次发布
+ */
+class SharedReader {
+    public:
+        using DatarefIndex = XPlaneUdp::DatarefIndex;
+        using PlaneInfo = XPlaneUdp::PlaneInfo;
+        static constexpr std::chrono::milliseconds WRITER_TIMEOUT{100}; // 发布者停在写入区超过此时间视为已退出
+
+        /**
+         * @param name 共享内存名称 不存在或未就绪时 isOpen() 为 false
+         */
+        explicit SharedReader (const std::string &name);
+
+        [[nodiscard]] bool isOpen () const { return segment.header != nullptr; }
+        [[nodiscard]] bool isPublishing () const;
+        [[nodiscard]] bool isConnected () const;
+        [[nodiscard]] int64_t lastUpdate () const;
+        [[nodiscard]] uint64_t sequence () const { return segment.header->lock.version(); }
+
+        bool findDataref (const std::string &dataref, DatarefIndex &dst, int index = -1) const;
+        bool getDataref (const DatarefIndex &dataref, float &value, float defaultValue = 0) const;
+        template <Container T>
+        bool getDataref (const DatarefIndex &dataref, T &container, float defaultValue = 0) const;
+        bool getPlaneInfo (PlaneInfo &infoDst) const;
+
+    private:
+        boost::interprocess::shared_memory_object memory;
+        boost::interprocess::mapped_region region;
+        SharedSegment segment;
+};
+
+/**
+ * @brief 获取 dataref 最新值 目录项与值在同一读取区内读取 发布者重新订阅后位置改变也一致
+ * @param dataref findDataref 得到的标识
+ * @param container 容器 可扩容时扩到 dataref 长度
+ * @param defaultValue 未订阅时的值
+ * @return 值可用 发布者在写入区内退出时为 false
+ */
+template <Container T>
+bool SharedReader::getDataref (const DatarefIndex &dataref, T &container, const float defaultValue) const {
+    if (dataref.getIdx() >= segment.header->refCount.load(std::memory_order_acquire)) {
+        std::ranges::fill(container, defaultValue);
+        return false;
+    }
+    const SharedSegment::Ref &ref = segment.refs[dataref.getIdx()];
+    const SeqLock &lock = segment.header->lock;
+    while (true) {
+        int32_t start{-1}, end{-1};
+        const bool read = lock.tryRead([&] {
+            start = ref.start.load(std::memory_order_relaxed);
+            end = ref.end.load(std::memory_order_relaxed);
+        }, WRITER_TIMEOUT);
+        if (!read || start < 0) {
+            std::ranges::fill(container, defaultValue);
+            return false;
+        }
+        const size_t datarefSize = static_cast<size_t>(end - start + 1);
+        if constexpr (requires { container.resize(datarefSize); }) { // vector等
+            if (container.size() < datarefSize)
+                container.resize(datarefSize);
+        }
+        const size_t copyCount = std::min(datarefSize, static_cast<size_t>(container.size()));
+        bool available{true};
+        if (!lock.tryRead([&] {
+            // 两次读取之间可能重新订阅 位置改变时重新读取目录项
+            available = ref.start.load(std::memory_order_relaxed) == start &&
+                        ref.end.load(std::memory_order_relaxed) == end;
+            if (available) {
+                const std::atomic<float> *src = segment.values + start;
+                for (size_t i = 0; i < copyCount; ++i)
+                    container[i] = src[i].load(std::memory_order_relaxed);
+            }
+        }, WRITER_TIMEOUT)) {
+            std::ranges::fill(container, defaultValue);
+            return false;
+        }
+        if (available)
+            return true;
+    }
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef XPLANESTATS_HPP
+#define XPLANESTATS_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <algorithm>
+
+/**
+ * @brief 以 2 为底的对数直方图 第 i 个桶统计 [2^(i-1), 2^i) 的值
+ *        只允许单个线程记录, 任意线程读取
+ */
+class Histogram {
+    public:
+        static constexpr size_t BUCKETS{40};
+        struct Report {
+            std::array<uint64_t, BUCKETS> counts{};
+            uint64_t total{0};
+            uint64_t max{0};
+            [[nodiscard]] uint64_t percentile (double p) const;
+        };
+
+        void record (const uint64_t value) {
+            const size_t bucket = std::min<size_t>(std::bit_width(value), BUCKETS - 1);
+            counts[bucket].store(counts[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (value > maxValue.load(std::memory_order_relaxed))
+                maxValue.store(value, std::memory_order_relaxed);
+        }
+        [[nodiscard]] Report report () const {
+            Report result{};
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                result.counts[i] = counts[i].load(std::memory_order_relaxed);
+                result.total += result.counts[i];
+            }
+            result.max = maxValue.load(std::memory_order_relaxed);
+            return result;
+        }
+    private:
+        std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+        std::atomic<uint64_t> maxValue{0};
+};
+
+/**
+ * @brief 近似分位数 返回所在桶的上界
+ * @param p 0~1
+ */
+inline uint64_t Histogram::Report::percentile (const double p) const {
+    if (total == 0)
+        return 0;
+    const auto target = static_cast<uint64_t>(p * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= target)
+            return std::min(i == 0 ? 0 : (uint64_t{1} << i) - 1, max);
+    }
+    return max;
+}
+
+/**
+ * @brief 运行统计 计数器均为 relaxed 原子量
+ *        接收相关只由 io 线程写入, 以 load+store 递增避免加锁指令
+ */
+class XPlaneStats {
+    public:
+        enum PacketType : size_t { RREF, RPOS, BECN, DREF, DATA, DSEL, UNKNOWN, TYPE_COUNT }; // DSEL 包括 USEL
+        struct Report {
+            std::array<uint64_t, TYPE_COUNT> packetsReceived{}, bytesReceived{};
+            std::array<uint64_t, TYPE_COUNT> packetsSent{}, bytesSent{};
+            uint64_t malformed{0}; // 长度不合法的数据包
+            uint64_t outOfRange{0}; // RREF 中越界或为负的 index 与 DATA 中超出 DATA_GROUPS 的组
+            int64_t sendQueued{0}; // 等待发送
+            int64_t sendInFlight{0}; // 发送协程正在处理
+            uint64_t writesSuppressed{0}; // 写入缓冲中与上次发送的值相同 未发送的 setDataref
+            uint64_t writesCoalesced{0}; // 写入缓冲中同一周期内被后一次覆盖的 setDataref
+            Histogram::Report decodeTime; // 单个数据包解码耗时 ns
+            std::array<Histogram::Report, TYPE_COUNT> interArrival; // 同类数据包到达间隔 us
+            Histogram::Report predictError; // RPOS 到达时 由上一个 RPOS 外推的位置误差 mm
+            Histogram::Report holdError; // 不外推 直接使用上一个 RPOS 的位置误差 mm
+            Histogram::Report attitudeError; // 外推姿态误差 0.001 度
+            Histogram::Report resubscribeTime; // 听见信标重新订阅到全部订阅再次收到 us
+            uint64_t lastResubscribe{0}; // 最近一次重新订阅耗时 us
+            Histogram::Report kernelQueueTime; // 内核收到到 recvmmsg 读出 ns 需 enableKernelTimestamps
+            Histogram::Report kernelToVisible; // 内核收到到解码完成 值可读 ns 需 enableKernelTimestamps
+        };
+
+        static void bump (std::atomic<uint64_t> &counter, const uint64_t n = 1) {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        [[nodiscard]] Report report () const;
+
+        std::atomic<bool> enabled{true};
+        std::array<std::atomic<uint64_t>, TYPE_COUNT> packetsReceived{}, bytesReceived{}; // io 线程
+        std::array<std::atomic<uint64_t>, TYPE_COUNT> packetsSent{}, bytesSent{}; // io 线程
+        std::atomic<uint64_t> malformed{0}, outOfRange{0}; // io 线程
+        std::atomic<int64_t> sendQueued{0}, sendInFlight{0}; // 任意线程
+        std::atomic<uint64_t> writesSuppressed{0}, writesCoalesced{0}; // 写入缓冲锁内
+        Histogram decodeTime; // io 线程
+        std::array<Histogram, TYPE_COUNT> interArrival; // io 线程
+        Histogram predictError, holdError, attitudeError; // io 线程
+        Histogram resubscribeTime; // io 线程
+        std::atomic<uint64_t> lastResubscribe{0}; // io 线程
+        Histogram kernelQueueTime, kernelToVisible; // io 线程
+        std::array<int64_t, TYPE_COUNT> lastArrival{}; // 上次到达 ns 仅 io 线程访问
+};
+
+inline XPlaneStats::Report XPlaneStats::report () const {
+    Report result{};
+    for (size_t i = 0; i < TYPE_COUNT; ++i) {
+        result.packetsReceived[i] = packetsReceived[i].load(std::memory_order_relaxed);
+        result.bytesReceived[i] = bytesReceived[i].load(std::memory_order_relaxed);
+        result.packetsSent[i] = packetsSent[i].load(std::memory_order_relaxed);
+        result.bytesSent[i] = bytesSent[i].load(std::memory_order_relaxed);
+        result.interArrival[i] = interArrival[i].report();
+    }
+    result.malformed = malformed.load(std::memory_order_relaxed);
+    result.outOfRange = outOfRange.load(std::memory_order_relaxed);
+    result.sendQueued = sendQueued.load(std::memory_order_relaxed);
+    result.sendInFlight = sendInFlight.load(std::memory_order_relaxed);
+    result.writesSuppressed = writesSuppressed.load(std::memory_order_relaxed);
+    result.writesCoalesced = writesCoalesced.load(std::memory_order_relaxed);
+    result.decodeTime = decodeTime.report();
+    result.predictError = predictError.report();
+    result.holdError = holdError.report();
+    result.attitudeError = attitudeError.report();
+    result.resubscribeTime = resubscribeTime.report();
+    result.lastResubscribe = lastResubscribe.load(std::memory_order_relaxed);
+    result.kernelQueueTime = kernelQueueTime.report();
+    result.kernelToVisible = kernelToVisible.report();
+    return result;
+}
+
+#endif
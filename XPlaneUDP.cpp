@@ -1,4 +1,5 @@
 #include "XPlaneUDP.hpp"
+#include "XPlaneShared.hpp"
 
 #ifdef _WIN32
 constexpr bool IS_WIN = true;
@@ -6,399 +7,3095 @@ constexpr bool IS_WIN = true;
 constexpr bool IS_WIN = false;
 #endif
 
+#include <charconv>
+#include <cmath>
+#include <future>
+#include <numbers>
+#include <numeric>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#endif
+
 static constexpr std::string MULTI_CAST_GROUP{"239.255.1.1"};
 static constexpr unsigned short MULTI_CAST_PORT{49707};
+static constexpr size_t SEND_BATCH{64}; // 单次 sendmmsg 最多发送的数据包
+static constexpr size_t RECV_BATCH{32}; // 单次 recvmmsg 最多接收的数据包
+static constexpr int RECV_BUFFER{1 << 20}; // 内核接收缓冲 容纳一帧内的突发数据包
+static constexpr size_t CONTROL_BYTES{64}; // 每个数据包的控制消息缓冲 容纳 SO_TIMESTAMPNS
+static constexpr auto BEACON_TIMEOUT{std::chrono::seconds(2)}; // 超时未收到信标视为断开
+
+/**
+ * @brief 固定的接收缓冲环 解码直接读取其中数据 不分配不清零
+ */
+struct XPlaneUdp::ReceiveRing {
+    std::array<std::array<char, 1472>, RECV_BATCH> buffers{};
+    std::array<ip::udp::endpoint, RECV_BATCH> senders{};
+    std::array<size_t, RECV_BATCH> lengths{};
+    std::array<int32_t, RrefDecoder::MAX_PAIRS> indices{}; // RREF 解码结果
+    std::array<float, RrefDecoder::MAX_PAIRS> decoded{};
+    std::array<int64_t, RECV_BATCH> arrivals{}; // 到达时间 steady ns 有内核时间戳时为内核收到的时刻
+    std::array<bool, RECV_BATCH> stamped{}; // arrivals 来自内核时间戳
+#ifdef __linux__
+    std::array<mmsghdr, RECV_BATCH> msgs{};
+    std::array<iovec, RECV_BATCH> iovs{};
+    std::array<std::array<char, CONTROL_BYTES>, RECV_BATCH> controls{};
+
+    ReceiveRing () {
+        for (size_t i = 0; i < RECV_BATCH; ++i) {
+            iovs[i].iov_base = buffers[i].data();
+            iovs[i].iov_len = buffers[i].size();
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+#endif
+};
+
+bool compareHead (const std::string &templateHead, const std::span<const char> data) {
+    return std::ranges::equal(templateHead | std::views::take(4), data | std::views::take(4));
+}
+
+BeaconRole parseBeacon (const std::span<const char> data, uint16_t &port) {
+    if (data.size() < HEADER_LENGTH + 16 || !compareHead(BECON_HEAD, data))
+        return BeaconRole::INVALID;
+    uint8_t mainVer, minorVer;
+    int32_t software, xpVer;
+    uint32_t role;
+    unpack(data, HEADER_LENGTH, mainVer, minorVer, software, xpVer, role, port);
+    return role == 1 ? BeaconRole::MASTER : BeaconRole::OTHER;
+}
+
+/**
+ * @brief 数据包类型
+ */
+static XPlaneStats::PacketType packetType (const std::span<const char> data) {
+    if (compareHead(DATAREF_GET_HEAD, data))
+        return XPlaneStats::RREF;
+    if (compareHead(BASIC_INFO_HEAD, data))
+        return XPlaneStats::RPOS;
+    if (compareHead(BECON_HEAD, data))
+        return XPlaneStats::BECN;
+    if (compareHead(DATAREF_SET_HEAD, data))
+        return XPlaneStats::DREF;
+    if (compareHead(DATA_HEAD, data))
+        return XPlaneStats::DATA;
+    if (compareHead(DATA_SELECT_HEAD, data) || compareHead(DATA_UNSELECT_HEAD, data))
+        return XPlaneStats::DSEL;
+    return XPlaneStats::UNKNOWN;
+}
+
+static int64_t steadyNanoseconds () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief 每个 values 位置一个时间戳 全部为未分配
+ */
+static std::unique_ptr<std::atomic<uint32_t>[]> freeStamps (const size_t capacity) {
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free);
+    auto stamps = std::make_unique<std::atomic<uint32_t>[]>(capacity);
+    for (size_t i = 0; i < capacity; ++i)
+        stamps[i].store(UINT32_MAX, std::memory_order_relaxed);
+    return stamps;
+}
+
+/**
+ * @brief 保存协程的完成处理器 完成时投递到其关联的执行器
+ */
+template <typename Handler>
+class HandlerWaiter final : public AsyncWaiter {
+    public:
+        explicit HandlerWaiter (Handler &&handler) : handler(std::move(handler)) {}
+        void complete (const bool result) override {
+            const auto executor = asio::get_associated_executor(handler);
+            asio::post(executor, [handler = std::move(handler), result] () mutable { handler(result); });
+        }
+    private:
+        Handler handler;
+};
+
+/**
+ * @brief 设置 SO_BUSY_POLL 增大需要 CAP_NET_ADMIN
+ * @param micros 微秒 0 为关闭
+ * @return 是否成功
+ */
+static bool setSocketBusyPoll (ip::udp::socket &socket, const int micros) {
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+    return socket.is_open() &&
+           ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &micros, sizeof(micros)) == 0;
+#else
+    (void)socket;
+    return micros == 0;
+#endif
+}
+
+/**
+ * @brief 绑定当前线程到一个核 -1 为允许全部核
+ * @return 是否成功
+ */
+static bool pinCurrentThread (const int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu < 0) {
+        for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i)
+            CPU_SET(i, &set);
+    } else {
+        CPU_SET(cpu, &set);
+    }
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+    return cpu < 0;
+#endif
+}
+
+/**
+ * @brief 设置当前线程的调度 需要 CAP_SYS_NICE
+ * @param priority SCHED_FIFO 优先级 0 为恢复普通调度
+ * @return 是否成功
+ */
+static bool setCurrentThreadPriority (const int priority) {
+#ifdef __linux__
+    sched_param param{};
+    param.sched_priority = priority;
+    return ::pthread_setschedparam(::pthread_self(), priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) == 0;
+#else
+    return priority == 0;
+#endif
+}
+
+static int64_t realtimeNanoseconds () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief 开关 SO_TIMESTAMPNS 接收时附带内核收到数据包的时刻
+ * @return 是否成功
+ */
+static bool setSocketTimestamps (ip::udp::socket &socket, const bool enable) {
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+    const int value = enable ? 1 : 0;
+    return ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &value, sizeof(value)) == 0;
+#else
+    (void)socket;
+    return !enable;
+#endif
+}
+
+#ifdef __linux__
+/**
+ * @brief 从控制消息中取出内核接收时间
+ * @return CLOCK_REALTIME ns 没有时为 0
+ */
+static int64_t kernelTime (msghdr &msg) {
+#ifdef SCM_TIMESTAMPNS
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec time{};
+            std::memcpy(&time, CMSG_DATA(cmsg), sizeof(time));
+            return static_cast<int64_t>(time.tv_sec) * 1'000'000'000 + time.tv_nsec;
+        }
+    }
+#endif
+    return 0;
+}
+#endif
+
+/**
+ * @brief 非阻塞读取一个数据包 有内核时间戳时取内核收到的时刻
+ * @param arrival 到达时间 steady ns
+ * @return 长度 没有数据包时为 0
+ */
+static size_t receiveStamped (ip::udp::socket &socket, const std::span<char> buffer, ip::udp::endpoint &sender,
+                              int64_t &arrival) {
+#ifdef __linux__
+    std::array<char, CONTROL_BYTES> control{};
+    iovec iov{buffer.data(), buffer.size()};
+    msghdr msg{};
+    msg.msg_name = sender.data();
+    msg.msg_namelen = static_cast<socklen_t>(sender.capacity());
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    const ssize_t size = ::recvmsg(socket.native_handle(), &msg, MSG_DONTWAIT);
+    if (size <= 0)
+        return 0;
+    sender.resize(msg.msg_namelen);
+    arrival = steadyNanoseconds();
+    if (const int64_t kernel = kernelTime(msg); kernel != 0)
+        arrival += kernel - realtimeNanoseconds();
+    return static_cast<size_t>(size);
+#else
+    sys::error_code ec;
+    socket.non_blocking(true, ec);
+    const size_t size = socket.receive_from(asio::buffer(buffer.data(), buffer.size()), sender, 0, ec);
+    arrival = steadyNanoseconds();
+    return ec ? 0 : size;
+#endif
+}
+
+static constexpr double EARTH_RADIUS{6371008.8}; // 平均半径 m
+static constexpr double DEGREE{std::numbers::pi / 180};
 
+/**
+ * @brief 角度差 归一化到 (-180, 180]
+ */
+static double wrapDegrees (const double angle) {
+    const double wrapped = std::fmod(angle + 180, 360);
+    return wrapped <= 0 ? wrapped + 180 : wrapped - 180;
+}
+
+/**
+ * @brief 机体角速度换算为欧拉角变化率
+ * @param roll 滚转 度
+ * @param pitch 俯仰 度
+ * @param p 滚转角速度 rad/s
+ * @param q 俯仰角速度 rad/s
+ * @param r 偏航角速度 rad/s
+ * @return 滚转 俯仰 航向变化率 度/s
+ */
+static std::array<double, 3> eulerRates (const double roll, const double pitch, const double p, const double q,
+                                         const double r) {
+    const double phi = roll * DEGREE;
+    const double theta = std::clamp(pitch, -89.9, 89.9) * DEGREE;
+    const double turn = q * std::sin(phi) + r * std::cos(phi);
+    return {
+        (p + turn * std::tan(theta)) / DEGREE,
+        (q * std::cos(phi) - r * std::sin(phi)) / DEGREE,
+        turn / std::cos(theta) / DEGREE,
+    };
+}
 
 /**
- * @brief 获取一个 array<char, 1472>
- * @param length 会使用的长度
- * @return 智能指针包含的数组
+ * @brief 由最近两个 RPOS 外推 速度与角速度按两包间的变化匀加速 位置与经纬度以 double 计算
+ * @param last 最近一个 RPOS
+ * @param previous 上一个 RPOS
+ * @param interval 两包接收间隔 ns 不大于 0 或过长时不估计加速度
+ * @param elapsed 自最近一个 RPOS 经过的时间 ns 截断到 [0, PREDICT_LIMIT]
+ * @return 外推结果
  */
-std::shared_ptr<std::array<char, 1472>> BufferPool::getBuffer (const size_t length) {
-    BufferPro *buffer = boost::pool_allocator<BufferPro>::allocate(1);
-    new(buffer) BufferPro();
-    buffer->length = length;
-    std::memset(buffer->data.data(), 0x00, buffer->data.size());
-    auto deleter = [](std::array<char, 1472> *ptr) {
-        auto *buffer_ = reinterpret_cast<BufferPro*>(ptr);
-        recycleBuffer(buffer_);
+static XPlaneUdp::PlaneInfo extrapolate (const XPlaneUdp::PlaneInfo &last, const XPlaneUdp::PlaneInfo &previous,
+                                         const int64_t interval, const int64_t elapsed) {
+    const double dt = static_cast<double>(std::clamp<int64_t>(elapsed, 0, XPlaneUdp::PREDICT_LIMIT)) / 1e9;
+    const bool accelerate = interval > 0 && interval <= XPlaneUdp::PREDICT_LIMIT;
+    const double span = static_cast<double>(interval) / 1e9;
+    const auto rate = [&](const float current, const float before) {
+        return accelerate ? (static_cast<double>(current) - before) / span : 0.0;
     };
-    return {&buffer->data, deleter};
+    XPlaneUdp::PlaneInfo out = last;
+    // 位置 OpenGL 坐标 x 东 y 上 z 南
+    const double aX = rate(last.vX, previous.vX), aY = rate(last.vY, previous.vY), aZ = rate(last.vZ, previous.vZ);
+    const double east = last.vX * dt + 0.5 * aX * dt * dt;
+    const double up = last.vY * dt + 0.5 * aY * dt * dt;
+    const double south = last.vZ * dt + 0.5 * aZ * dt * dt;
+    out.lat = last.lat - south / EARTH_RADIUS / DEGREE;
+    out.lon = last.lon + east / (EARTH_RADIUS * std::cos(last.lat * DEGREE)) / DEGREE;
+    out.alt = last.alt + up;
+    out.agl = static_cast<float>(last.agl + up);
+    out.vX = static_cast<float>(last.vX + aX * dt);
+    out.vY = static_cast<float>(last.vY + aY * dt);
+    out.vZ = static_cast<float>(last.vZ + aZ * dt);
+    // 姿态 中点法积分 角速度取区间中点
+    const double p = last.rollRate + rate(last.rollRate, previous.rollRate) * dt;
+    const double q = last.pitchRate + rate(last.pitchRate, previous.pitchRate) * dt;
+    const double r = last.yawRate + rate(last.yawRate, previous.yawRate) * dt;
+    const double pm = (last.rollRate + p) / 2, qm = (last.pitchRate + q) / 2, rm = (last.yawRate + r) / 2;
+    const auto start = eulerRates(last.roll, last.pitch, pm, qm, rm);
+    const auto middle = eulerRates(last.roll + start[0] * dt / 2, last.pitch + start[1] * dt / 2, pm, qm, rm);
+    out.roll = static_cast<float>(wrapDegrees(last.roll + middle[0] * dt));
+    out.pitch = static_cast<float>(std::clamp(last.pitch + middle[1] * dt, -90.0, 90.0));
+    const double track = std::fmod(last.track + middle[2] * dt, 360);
+    out.track = static_cast<float>(track < 0 ? track + 360 : track);
+    out.rollRate = static_cast<float>(p);
+    out.pitchRate = static_cast<float>(q);
+    out.yawRate = static_cast<float>(r);
+    return out;
+}
+
+/**
+ * @brief 两个位置间的距离 m 短距离按平面近似
+ */
+static double positionError (const XPlaneUdp::PlaneInfo &a, const XPlaneUdp::PlaneInfo &b) {
+    const double north = (a.lat - b.lat) * DEGREE * EARTH_RADIUS;
+    const double east = (a.lon - b.lon) * DEGREE * EARTH_RADIUS * std::cos(b.lat * DEGREE);
+    const double up = a.alt - b.alt;
+    return std::sqrt(north * north + east * east + up * up);
+}
+
+/**
+ * @brief 两个姿态间滚转 俯仰 航向差的最大值 度
+ */
+static double attitudeError (const XPlaneUdp::PlaneInfo &a, const XPlaneUdp::PlaneInfo &b) {
+    return std::max({std::abs(wrapDegrees(a.roll - b.roll)), std::abs(static_cast<double>(a.pitch) - b.pitch),
+                     std::abs(wrapDegrees(a.track - b.track))});
+}
+
+BufferPool::~BufferPool () {
+    for (size_t i = 0; i < chunkCount.load(std::memory_order_relaxed); ++i)
+        delete[] chunks[i].load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief 获取一个块 内容不清零
+ * @param length 会写入的长度
+ * @param padTo 发送长度 [length, padTo) 会被置零
+ * @return 块的引用
+ */
+BufferPool::Buffer BufferPool::getBuffer (const size_t length, const size_t padTo) {
+    Block *block = pop();
+    if (!block)
+        block = grow();
+    if (!block) { // 池已满
+        block = new Block();
+        block->owner = this;
+        overflow.fetch_add(1, std::memory_order_relaxed);
+    }
+    block->refs.store(1, std::memory_order_relaxed);
+    if (padTo > length)
+        std::memset(block->data.data() + length, 0x00, std::min(padTo, BLOCK_SIZE) - length);
+    acquired.fetch_add(1, std::memory_order_relaxed);
+    const size_t used = inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t peak = highWater.load(std::memory_order_relaxed);
+    while (used > peak && !highWater.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+    return Buffer(block);
+}
+
+BufferPool::Report BufferPool::report () const {
+    Report result{};
+    result.capacity = chunkCount.load(std::memory_order_relaxed) * CHUNK_BLOCKS;
+    result.inUse = inUse.load(std::memory_order_relaxed);
+    result.highWater = highWater.load(std::memory_order_relaxed);
+    result.acquired = acquired.load(std::memory_order_relaxed);
+    result.overflow = overflow.load(std::memory_order_relaxed);
+    return result;
+}
+
+/**
+ * @brief 从空闲链表取出一块
+ * @return 链表为空时返回 nullptr
+ */
+BufferPool::Block* BufferPool::pop () {
+    uint64_t head = freeHead.load(std::memory_order_acquire);
+    while (static_cast<uint32_t>(head) != NO_BLOCK) {
+        Block *block = blockAt(static_cast<uint32_t>(head));
+        // next 可能已被其它线程改写 此时版本号不同 CAS 失败
+        const uint64_t next = ((head >> 32) + 1) << 32 | block->next.load(std::memory_order_relaxed);
+        if (freeHead.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+            return block;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 将 first 到 last 已串好的一段块放回空闲链表
+ */
+void BufferPool::push (Block *first, Block *last) {
+    uint64_t head = freeHead.load(std::memory_order_relaxed);
+    do {
+        last->next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    } while (!freeHead.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | first->index,
+                                             std::memory_order_release, std::memory_order_relaxed));
+}
+
+/**
+ * @brief 扩容一组块 返回其中一块 其余放入空闲链表
+ * @return 达到上限时返回 nullptr
+ */
+BufferPool::Block* BufferPool::grow () {
+    std::lock_guard lock(growMutex);
+    if (Block *block = pop()) // 等待锁期间其它线程已扩容或归还
+        return block;
+    const size_t count = chunkCount.load(std::memory_order_relaxed);
+    if (count == MAX_CHUNKS)
+        return nullptr;
+    auto *chunk = new Block[CHUNK_BLOCKS];
+    const auto base = static_cast<uint32_t>(count * CHUNK_BLOCKS);
+    for (uint32_t i = 0; i < CHUNK_BLOCKS; ++i) {
+        chunk[i].index = base + i;
+        chunk[i].owner = this;
+        chunk[i].next.store(base + i + 1, std::memory_order_relaxed);
+    }
+    chunks[count].store(chunk, std::memory_order_release);
+    chunkCount.store(count + 1, std::memory_order_relaxed);
+    push(&chunk[1], &chunk[CHUNK_BLOCKS - 1]);
+    return &chunk[0];
+}
+
+/**
+ * @brief 最后一个引用释放时归还
+ */
+void BufferPool::release (Block *block) {
+    inUse.fetch_sub(1, std::memory_order_relaxed);
+    if (block->index == NO_BLOCK) {
+        delete block;
+        return;
+    }
+    push(block, block);
+}
+
+/**
+ * @brief 调整使用的长度 不超过容量 不分配内存
+ * @param length 新长度
+ */
+void ValueStore::resize (const size_t length) {
+    count.store(std::min(length, total), std::memory_order_release);
+}
+
+SlotAllocator::SlotAllocator (const size_t capacity) : total(capacity) {
+    if (capacity > 0) {
+        byStart.emplace(0, capacity);
+        byLength.emplace(capacity, 0);
+    }
+}
+
+/**
+ * @brief 分配一段连续位置 取能容纳的最短空闲区间 同长度取起点最小的
+ * @param length 长度
+ * @return 起点 NO_SPACE 为没有足够长的空闲区间
+ */
+size_t SlotAllocator::allocate (const size_t length) {
+    if (length == 0)
+        return 0;
+    const auto fit = byLength.lower_bound({length, 0});
+    if (fit == byLength.end())
+        return NO_SPACE;
+    const size_t start = fit->second;
+    take(byStart.find(start), length);
+    return start;
+}
+
+/**
+ * @brief 分配一段连续位置 取起点最小的能容纳的空闲区间 O(空闲区间数) 整理时使用
+ * @param length 长度
+ * @return 起点 NO_SPACE 为没有足够长的空闲区间
+ */
+size_t SlotAllocator::allocateLowest (const size_t length) {
+    if (length == 0)
+        return 0;
+    for (auto it = byStart.begin(); it != byStart.end(); ++it) {
+        if (it->second >= length) {
+            const size_t start = it->first;
+            take(it, length);
+            return start;
+        }
+    }
+    return NO_SPACE;
+}
+
+/**
+ * @brief 从空闲区间的开头取出 length 个位置
+ */
+void SlotAllocator::take (const std::map<size_t, size_t>::iterator extent, const size_t length) {
+    const auto [start, size] = *extent;
+    byLength.erase({size, start});
+    byStart.erase(extent);
+    if (size > length) {
+        byStart.emplace(start + length, size - length);
+        byLength.emplace(size - length, start + length);
+    }
+    usedCount += length;
+}
+
+/**
+ * @brief 释放一段位置 与前后相邻的空闲区间合并
+ * @param start 起点
+ * @param length 长度
+ */
+void SlotAllocator::release (size_t start, size_t length) {
+    if (length == 0)
+        return;
+    usedCount -= length;
+    auto next = byStart.lower_bound(start);
+    if (next != byStart.end() && next->first == start + length) {
+        length += next->second;
+        byLength.erase({next->second, next->first});
+        next = byStart.erase(next);
+    }
+    if (next != byStart.begin()) {
+        if (const auto previous = std::prev(next); previous->first + previous->second == start) {
+            start = previous->first;
+            length += previous->second;
+            byLength.erase({previous->second, previous->first});
+            byStart.erase(previous);
+        }
+    }
+    byStart.emplace(start, length);
+    byLength.emplace(length, start);
+}
+
+/**
+ * @return 最后一个已分配位置 + 1
+ */
+size_t SlotAllocator::end () const {
+    if (byStart.empty())
+        return total;
+    const auto &[start, length] = *byStart.rbegin();
+    return start + length == total ? start : total;
+}
+
+/**
+ * @brief 登记名称 已登记时不修改
+ * @param name 名称
+ * @param value 对应的 dataRefs 下标
+ * @return 内存区中的名称 与是否新登记
+ */
+std::pair<std::string_view, bool> NameRegistry::insert (const std::string_view name, const size_t value) {
+    if (const auto it = index.find(name); it != index.end())
+        return {it->first, false};
+    if (chunkUsed + name.size() > CHUNK_BYTES || chunks.empty()) {
+        chunks.push_back(std::make_unique<char[]>(std::max(CHUNK_BYTES, name.size())));
+        chunkUsed = 0;
+    }
+    char *target = chunks.back().get() + chunkUsed;
+    std::memcpy(target, name.data(), name.size());
+    chunkUsed += name.size();
+    const std::string_view stored(target, name.size());
+    index.emplace(stored, value);
+    return {stored, true};
+}
+
+/**
+ * @return 登记的 dataRefs 下标 NOT_FOUND 为未登记
+ */
+size_t NameRegistry::find (const std::string_view name) const {
+    const auto it = index.find(name);
+    return it == index.end() ? NOT_FOUND : it->second;
+}
+
+/**
+ * @return 内存区与索引约占的字节 索引每项按键值与两个指针估计
+ */
+size_t NameRegistry::bytes () const {
+    using Entry = std::pair<const std::string_view, size_t>;
+    return chunks.size() * CHUNK_BYTES + index.bucket_count() * sizeof(void*) +
+           index.size() * (sizeof(Entry) + 2 * sizeof(void*));
+}
+
+/**
+ * @brief 以 relaxed 写入原子数组的输出迭代器 供 ValueStore::copy 使用
+ */
+struct RelaxedOutput {
+    std::atomic<float> *target;
+    RelaxedOutput& operator* () { return *this; }
+    RelaxedOutput& operator++ () {
+        ++target;
+        return *this;
+    }
+    void operator= (const float value) const { target->store(value, std::memory_order_relaxed); }
+};
+
+HistoryRing::HistoryRing (const size_t length, const size_t valueCount, const size_t first)
+    : capacity(std::max<size_t>(length, 1)),
+      columns(valueCount),
+      start(first),
+      stamps(std::make_unique<std::atomic<int64_t>[]>(capacity)),
+      data(std::make_unique<std::atomic<float>[]>(capacity * columns)) {}
+
+/**
+ * @brief 追加一个样本 覆盖最旧的样本 在 io 线程 dataLock 写入区内调用
+ * @param time 接收时间 ns
+ * @param values 当前值 复制 [start, start + width) 位置
+ */
+void HistoryRing::push (const int64_t time, const ValueStore &values) {
+    const uint64_t n = head.load(std::memory_order_relaxed);
+    stamps[n % capacity].store(time, std::memory_order_relaxed);
+    values.copy(start, columns, RelaxedOutput{data.get() + n % capacity * columns});
+    head.store(n + 1, std::memory_order_release);
+}
+
+/**
+ * @brief 二分查找第一个时间晚于 time 的样本 样本按时间递增
+ * @param time 时间 ns
+ * @param first 最旧样本序号
+ * @param end 最新样本序号 + 1
+ * @return 样本序号 均不晚于 time 时为 end
+ */
+uint64_t HistoryRing::upperBound (const int64_t time, uint64_t first, uint64_t end) const {
+    while (first < end) {
+        const uint64_t middle = first + (end - first) / 2;
+        if (timeOf(middle) <= time)
+            first = middle + 1;
+        else
+            end = middle;
+    }
+    return first;
+}
+
+/**
+ * @brief 复制 [from, to] 内的样本 需在 dataLock 读取区内调用
+ * @param times 各样本接收时间 先清空
+ * @param dst 样本值 先清空 第 i 个样本的第 j 个值位于 i * width + j
+ * @return 样本数
+ */
+size_t HistoryRing::copy (const Clock::time_point from, const Clock::time_point to,
+                          std::vector<Clock::time_point> &times, std::vector<float> &dst) const {
+    const uint64_t end = head.load(std::memory_order_acquire);
+    const uint64_t first = end > capacity ? end - capacity : 0;
+    const int64_t begin = toNanoseconds(from);
+    // 第一个不早于 from 的样本
+    const uint64_t low = begin == INT64_MIN ? first : upperBound(begin - 1, first, end);
+    const uint64_t high = upperBound(toNanoseconds(to), low, end);
+    copyRange(low, high, times, dst);
+    return high - low;
+}
+
+/**
+ * @brief 复制最新的 count 个样本 需在 dataLock 读取区内调用
+ * @return 样本数 不超过已有样本
+ */
+size_t HistoryRing::copyLast (const size_t count, std::vector<Clock::time_point> &times,
+                              std::vector<float> &dst) const {
+    const uint64_t end = head.load(std::memory_order_acquire);
+    const uint64_t first = end - std::min<uint64_t>({end, capacity, count});
+    copyRange(first, end, times, dst);
+    return end - first;
+}
+
+void HistoryRing::copyRange (const uint64_t first, const uint64_t last, std::vector<Clock::time_point> &times,
+                             std::vector<float> &dst) const {
+    times.resize(last - first);
+    dst.resize((last - first) * columns);
+    float *out = dst.data();
+    for (uint64_t n = first; n < last; ++n) {
+        times[n - first] = Clock::time_point(
+            std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(timeOf(n))));
+        const std::atomic<float> *src = row(n);
+        for (size_t i = 0; i < columns; ++i)
+            *out++ = src[i].load(std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @param autoReConnect 断线后重新收到信标时重新订阅
+ * @param valueCapacity 最多订阅的值 数组每个元素一个 接收时不再分配
+ */
+XPlaneUdp::XPlaneUdp (const bool autoReConnect, const size_t valueCapacity)
+    : values(valueCapacity),
+      space(valueCapacity),
+      autoReconnect(autoReConnect),
+      ownContext(std::make_unique<asio::io_context>()),
+      strand(asio::any_io_executor(ownContext->get_executor())),
+      workGuard(strand.get_inner_executor()),
+      worker([this] () { ownContext->run(); }),
+      ring(std::make_unique<ReceiveRing>()),
+      slotOwner(valueCapacity, RelaxedAtomic<int32_t>(-1)),
+      slotTimes(freeStamps(valueCapacity)),
+      stampEpoch(steadyNanoseconds()) {
+    storeInfo(PlaneInfo{.track = -999}, info);
+    // 监听信标帧
+    openBeaconSocket(multicastSocket);
+    detectBeacon();
+    spawn(ageLoop());
+}
+
+/**
+ * @brief 在外部执行器上运行 监听多播信标 不启动线程
+ *        执行器可由线程池的多个线程运行 内部操作都在 getExecutor() 返回的 strand 上串行执行
+ *        在同一 strand 上运行的协程 co_await nextUpdate 等不加锁也不切换线程
+ * @param executor 外部执行器 需在本实例关闭前持续运行
+ * @param autoReConnect 断线后重新收到信标时重新订阅
+ * @param valueCapacity 最多订阅的值 数组每个元素一个 接收时不再分配
+ */
+XPlaneUdp::XPlaneUdp (const asio::any_io_executor &executor, const bool autoReConnect, const size_t valueCapacity)
+    : values(valueCapacity),
+      space(valueCapacity),
+      autoReconnect(autoReConnect),
+      strand(executor),
+      workGuard(executor),
+      ring(std::make_unique<ReceiveRing>()),
+      slotOwner(valueCapacity, RelaxedAtomic<int32_t>(-1)),
+      slotTimes(freeStamps(valueCapacity)),
+      stampEpoch(steadyNanoseconds()) {
+    storeInfo(PlaneInfo{.track = -999}, info);
+    openBeaconSocket(multicastSocket);
+    detectBeacon();
+    spawn(ageLoop());
+}
+
+/**
+ * @brief 在外部执行器上连接已知地址的 XPlane 不监听多播 不启动线程 多个实例可共享同一执行器
+ *        创建后即视为已连接 之后由 receiveBeacon 转交的信标检测断线与重连
+ * @param executor 外部执行器 需在本实例关闭前持续运行
+ * @param endpoint XPlane 接收地址 信标发送方地址与信标中的端口
+ * @param autoReConnect 断线后重新收到信标时重新订阅
+ * @param valueCapacity 最多订阅的值 数组每个元素一个 接收时不再分配
+ */
+XPlaneUdp::XPlaneUdp (const asio::any_io_executor &executor, const ip::udp::endpoint &endpoint,
+                      const bool autoReConnect, const size_t valueCapacity)
+    : values(valueCapacity),
+      space(valueCapacity),
+      autoReconnect(autoReConnect),
+      strand(executor),
+      workGuard(executor),
+      ring(std::make_unique<ReceiveRing>()),
+      slotOwner(valueCapacity, RelaxedAtomic<int32_t>(-1)),
+      slotTimes(freeStamps(valueCapacity)),
+      stampEpoch(steadyNanoseconds()) {
+    storeInfo(PlaneInfo{.track = -999}, info);
+    openSocket(endpoint);
+    spawn(ageLoop());
+    state = true;
+}
+
+/**
+ * @brief 打开并加入 XPlane 信标多播组
+ * @param socket 未打开的 socket
+ */
+void XPlaneUdp::openBeaconSocket (ip::udp::socket &socket) {
+    // * 自身地址
+    socket.open(ip::udp::v4());
+    const asio::socket_base::reuse_address option(true);
+    socket.set_option(option);
+    // * XPlane广播地址
+    ip::udp::endpoint multicastEndpoint;
+    if constexpr (IS_WIN)
+        multicastEndpoint = ip::udp::endpoint(ip::udp::v4(), MULTI_CAST_PORT);
+    else
+        multicastEndpoint = ip::udp::endpoint(ip::make_address(MULTI_CAST_GROUP), MULTI_CAST_PORT);
+    socket.bind(multicastEndpoint);
+    // * 加入多播组
+    const ip::address_v4 multicastAddress = ip::make_address_v4(MULTI_CAST_GROUP);
+    socket.set_option(ip::multicast::join_group(multicastAddress));
+}
+
+XPlaneUdp::~XPlaneUdp () {
+    close();
+}
+
+/**
+ * @brief 设置一个回调函数,xp连接状态改变时会调用
+ * @param callbackFunc 回调函数 接受形参bool
+ */
+void XPlaneUdp::setCallback (const std::function<void  (bool)> &callbackFunc) {
+    callback = callbackFunc;
+}
+
+/**
+ * @brief 获取运行统计
+ */
+XPlaneStats::Report XPlaneUdp::getStats () const {
+    return stats.report();
+}
+
+/**
+ * @brief 开关耗时与到达间隔统计 计数器始终有效
+ */
+void XPlaneUdp::enableStats (const bool enable) {
+    stats.enabled.store(enable, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 设置一个回调函数,每收到一个数据包在 io 线程调用一次
+ * @param callbackFunc 回调函数 接受本包更新的 dataref 与基本信息是否更新
+ */
+void XPlaneUdp::setUpdateCallback (const std::function<void  (std::span<const DatarefIndex>, bool)> &callbackFunc) {
+    updateCallback = callbackFunc;
+}
+
+/**
+ * @brief 设置一个回调函数,每收到一个 DATA 数据包在 io 线程调用一次
+ * @param callbackFunc 回调函数 接受本包更新的组序号
+ */
+void XPlaneUdp::setGroupCallback (const std::function<void  (std::span<const int32_t>)> &callbackFunc) {
+    groupCallback = callbackFunc;
+}
+
+/**
+ * @brief 等待 dataref 下一次更新
+ * @param dataref 标识
+ * @param timeout 超时
+ * @return 超时前是否更新
+ */
+bool XPlaneUdp::waitUpdate (const DatarefIndex &dataref, const std::chrono::milliseconds timeout) {
+    const size_t idx = dataref.getIdx();
+    ++waiters;
+    std::unique_lock lock(notifyMutex);
+    if (refGeneration.size() <= idx)
+        refGeneration.resize(idx + 1, 0);
+    const uint64_t generation = refGeneration[idx];
+    const bool updated = notifyCond.wait_for(lock, timeout, [&] { return refGeneration[idx] != generation || closed; });
+    --waiters;
+    if (updated && !closed)
+        noteRead(idx);
+    return updated && !closed;
+}
+
+/**
+ * @brief 等待基本信息下一次更新
+ * @param timeout 超时
+ * @return 超时前是否更新
+ */
+bool XPlaneUdp::waitPlaneInfo (const std::chrono::milliseconds timeout) {
+    ++waiters;
+    std::unique_lock lock(notifyMutex);
+    const uint64_t generation = infoGeneration;
+    const bool updated = notifyCond.wait_for(lock, timeout, [&] { return infoGeneration != generation || closed; });
+    --waiters;
+    return updated && !closed;
+}
+
+/**
+ * @brief 协程等待 dataref 下一次更新 在协程自身的执行器上恢复
+ * @param dataref 标识
+ * @return 是否更新 关闭时为 false
+ */
+asio::awaitable<bool> XPlaneUdp::nextUpdate (const DatarefIndex dataref) {
+    const size_t idx = dataref.getIdx();
+    const bool updated = co_await suspend([this, idx] (std::unique_ptr<AsyncWaiter> waiter) {
+        updateWaiters.emplace_back(idx, std::move(waiter));
+    });
+    if (updated) // 恢复时计入读取 与 waitUpdate 相同
+        noteRead(idx);
+    co_return updated;
+}
+
+/**
+ * @brief 协程等待基本信息下一次更新
+ * @return 是否更新 关闭时为 false
+ */
+asio::awaitable<bool> XPlaneUdp::nextPlaneInfo () {
+    return suspend([this] (std::unique_ptr<AsyncWaiter> waiter) {
+        updateWaiters.emplace_back(INFO_WAITER, std::move(waiter));
+    });
+}
+
+/**
+ * @brief 协程等待与 XPlane 建立连接 已连接时立即完成
+ * @return 是否已连接 关闭时为 false
+ */
+asio::awaitable<bool> XPlaneUdp::waitConnected () {
+    return suspend([this] (std::unique_ptr<AsyncWaiter> waiter) {
+        if (state)
+            waiter->complete(true);
+        else
+            connectWaiters.push_back(std::move(waiter));
+    });
+}
+
+/**
+ * @brief 挂起调用的协程 在 io 线程把等待者交给 enqueue 由其登记或立即完成
+ *        协程已在 strand 上时直接登记 完成时投递回协程的执行器
+ * @param enqueue 在 io 线程调用
+ * @return 等待者完成时的结果
+ */
+asio::awaitable<bool> XPlaneUdp::suspend (std::function<void  (std::unique_ptr<AsyncWaiter>)> enqueue) {
+    co_return co_await asio::async_initiate<const asio::use_awaitable_t<>, void (bool)>(
+        [this, enqueue = std::move(enqueue)] (auto handler) mutable {
+            std::unique_ptr<AsyncWaiter> waiter =
+                std::make_unique<HandlerWaiter<decltype(handler)>>(std::move(handler));
+            tasks.fetch_add(1, std::memory_order_relaxed);
+            asio::dispatch(strand, [this, enqueue = std::move(enqueue), waiter = std::move(waiter)] () mutable {
+                if (closed)
+                    waiter->complete(false);
+                else
+                    enqueue(std::move(waiter));
+                tasks.fetch_sub(1, std::memory_order_release);
+            });
+        }, asio::use_awaitable);
+}
+
+/**
+ * @brief 完成本包更新了所等待内容的协程 在 io 线程调用
+ * @param infoUpdated 基本信息是否更新
+ */
+void XPlaneUdp::wakeUpdateWaiters (const bool infoUpdated) {
+    std::erase_if(updateWaiters, [&](const auto &waiter) {
+        const bool hit = waiter.first == INFO_WAITER
+                             ? infoUpdated
+                             : std::ranges::any_of(updatedRefs, [&waiter](const DatarefIndex &ref) {
+                                   return ref.getIdx() == waiter.first;
+                               });
+        if (hit)
+            waiter.second->complete(true);
+        return hit;
+    });
+}
+
+/**
+ * @brief 完成并清空 完成只是投递 期间不会加入新的等待者
+ */
+void XPlaneUdp::wakeAll (std::vector<std::unique_ptr<AsyncWaiter>> &list, const bool result) {
+    for (const auto &waiter : list)
+        waiter->complete(result);
+    list.clear();
+}
+
+/**
+ * @brief 发送者发完后完成 flushWrites 的等待者 在 io 线程调用
+ */
+void XPlaneUdp::wakeFlushWaiters () {
+    if (sendScheduled) // 又有新的发送者 它发完时再次唤醒
+        return;
+    flushPending = false;
+    wakeAll(flushWaiters, true);
+}
+
+/**
+ * @brief 关闭时以 false 完成全部等待者 在 io 线程调用
+ */
+void XPlaneUdp::cancelWaiters () {
+    for (const auto &waiter : updateWaiters | std::views::values)
+        waiter->complete(false);
+    updateWaiters.clear();
+    wakeAll(connectWaiters, false);
+    flushPending = false;
+    wakeAll(flushWaiters, false);
+}
+
+/**
+ * @brief 重连 直接复制订阅时预先打包的请求 先发 RPOS dataref 按 setDatarefPriority 从高到低
+ *        听见信标到全部值再次收到的耗时见 getStats()
+ */
+void XPlaneUdp::reconnect (const bool del) {
+    // 信息 只有一个数据包 最先发送
+    if (infoFreq != 0) {
+        const std::string sentence = std::format("{}{}\x00", BASIC_INFO_HEAD, del ? 0 : infoFreq);
+        const auto buffer2 = pool.getBuffer(sentence.size());
+        pack(*buffer2, 0, sentence);
+        queueData(buffer2, sentence.size());
+    }
+    // dataref 按优先级从高到低 同优先级按订阅顺序 直接复制预先打包的请求
+    std::vector<size_t> order(dataRefs.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::ranges::stable_sort(order, std::greater{}, [this](const size_t i) { return dataRefs[i].priority; });
+    for (const size_t i : order) {
+        if (const auto &ref = dataRefs[i]; ref.available)
+            queueRequests(ref.requests, del);
+    }
+    // DATA 组 全部在一个数据包
+    std::vector<int32_t> groups;
+    {
+        std::lock_guard lock(writeMutex);
+        groups = dataGroups;
+    }
+    queueGroupSelect(groups, del);
+    flushData();
+}
+
+/**
+ * @brief 停止所有 UDP 接收
+ */
+void XPlaneUdp::stop () {
+    reconnect(true);
+}
+
+/**
+ * @brief 彻底关闭 UDP
+ */
+void XPlaneUdp::close () {
+    if (closed.exchange(true))
+        return;
+    // 在 io 线程执行并等待 closed 已置位 不能使用 runInIo
+    const auto inIo = [this] (const auto &func) {
+        if (strand.running_in_this_thread()) {
+            func();
+            return;
+        }
+        std::promise<void> done;
+        asio::post(strand, [&func, &done] {
+            func();
+            done.set_value();
+        });
+        done.get_future().wait();
+    };
+    if (ownContext) {
+        inIo([this] { // socket 只在 io 线程打开、发送与关闭
+            cancelWaiters();
+            xpOpen.store(false, std::memory_order_release);
+            if (xpSocket.is_open()) {
+                xpSocket.cancel();
+                xpSocket.close();
+            }
+            multicastSocket.cancel();
+            multicastSocket.close();
+        });
+        workGuard.reset();
+        ownContext->stop();
+        if (worker.joinable())
+            worker.join();
+    } else { // 外部执行器不能停止 在 io 线程取消全部操作 等待协程退出
+        inIo([this] {
+            xpOpen.store(false, std::memory_order_release);
+            if (xpSocket.is_open()) {
+                xpSocket.cancel();
+                xpSocket.close();
+            }
+            if (multicastSocket.is_open()) {
+                multicastSocket.cancel();
+                multicastSocket.close();
+            }
+            beaconTimer.cancel();
+            writeTimer.cancel();
+            stampTimer.cancel();
+            cancelWaiters();
+        });
+        if (!strand.running_in_this_thread()) {
+            while (tasks.load(std::memory_order_acquire) != 0) {
+                std::promise<void> idle;
+                asio::post(strand, [&idle] { idle.set_value(); });
+                idle.get_future().wait();
+            }
+        }
+        workGuard.reset();
+    }
+    {
+        std::lock_guard lock(notifyMutex);
+    }
+    notifyCond.notify_all();
+}
+
+/**
+ * @brief 开始把收到的原始数据包记录到文件 已在记录时切换到新文件
+ * @param path 日志文件 已存在时覆盖
+ * @param ringBytes 内存环大小 写入跟不上时超出部分丢弃 不阻塞 io 线程
+ * @return 是否成功创建文件
+ */
+bool XPlaneUdp::startRecording (const std::string &path, const size_t ringBytes) {
+    std::unique_ptr<PacketRecorder> next;
+    try {
+        next = std::make_unique<PacketRecorder>(path, ringBytes);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+    std::lock_guard lock(recordMutex);
+    runInIo([this, &next] { recording = next.get(); });
+    recorder.swap(next); // 旧记录器在此析构 写完剩余数据
+    return true;
+}
+
+/**
+ * @brief 停止记录 等待剩余数据写入文件
+ * @return 最终统计
+ */
+PacketRecorder::Report XPlaneUdp::stopRecording () {
+    std::lock_guard lock(recordMutex);
+    if (!recorder)
+        return {};
+    runInIo([this] { recording = nullptr; });
+    const auto report = recorder->stop();
+    recorder.reset();
+    return report;
+}
+
+PacketRecorder::Report XPlaneUdp::getRecordingReport () const {
+    std::lock_guard lock(recordMutex);
+    return recorder ? recorder->report() : PacketRecorder::Report{};
+}
+
+/**
+ * @brief 将记录的数据包按原有间隔交给 receiveDataProcess 解码 调用线程等待回放结束
+ *        到达时间为回放开始时刻加记录中的相对时间 历史、外推、时间序列与更新时间与实时接收时的间隔相同
+ *        回放期间忽略实时信标 不与 XPlane 建立连接 不可在回调中调用
+ *        RREF 中的 index 为 values 中的位置 回放实例需按记录时的顺序订阅
+ * @param path 日志文件
+ * @param speed 回放倍速 1 为原速 0 为尽快
+ * @return 已回放的数据包数量
+ */
+size_t XPlaneUdp::replay (const std::string &path, const double speed) {
+    PacketLog log(path);
+    if (!log.isOpen() || closed || replaying.exchange(true))
+        return 0;
+    struct Release { // 任何返回路径都结束回放
+        std::atomic<bool> &flag;
+        ~Release () { flag = false; }
+    } release{replaying};
+    auto result = asio::co_spawn(strand, replayLog(std::move(log), speed), asio::use_future);
+    while (result.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+        if (closed) // io 线程已停止 回放不会再继续
+            return 0;
+    }
+    return result.get();
+}
+
+/**
+ * @brief 开始把解码后的值按行记录为列式时间序列 已在记录时切换到新文件
+ *        每个更新了所选 dataref 的 RREF 数据包, 以及 planeInfo 为 true 时每个 RPOS 数据包记录一行
+ *        通道为数组的每个元素与基本信息各字段 写入在后台线程进行 跟不上时丢弃行 不阻塞 io 线程
+ *        行时间为数据包到达的 steady 时间 加 SeriesReader::wallOffset() 为系统时间
+ * @param path 文件 已存在时覆盖
+ * @param refs 记录的 dataref 之后新增的订阅不会记录
+ * @param planeInfo 是否同时记录基本信息
+ * @param blockRows 每块行数
+ * @return 是否成功创建文件
+ */
+bool XPlaneUdp::startSeries (const std::string &path, const std::span<const DatarefIndex> refs, const bool planeInfo,
+                             const size_t blockRows) {
+    std::vector<SeriesWriter::Channel> channels;
+    SeriesTarget target;
+    target.refs.resize(dataRefs.size(), false);
+    target.info = planeInfo;
+    for (const auto &ref : refs) {
+        if (ref.getIdx() >= dataRefs.size())
+            continue;
+        const auto &info = dataRefs[ref.getIdx()];
+        if (info.isArray) {
+            for (int i = 0; i <= info.end - info.start; ++i)
+                channels.push_back({std::format("{}[{}]", info.name, i)});
+        } else {
+            channels.push_back({std::string(info.name)});
+        }
+        target.slots.emplace_back(info.start, info.end);
+        target.refs[ref.getIdx()] = true;
+    }
+    if (planeInfo) {
+        for (const auto name : {"plane/lon", "plane/lat", "plane/alt"})
+            channels.push_back({name, SeriesWriter::FLOAT64});
+        for (const auto name : {"plane/agl", "plane/pitch", "plane/track", "plane/roll", "plane/vX", "plane/vY",
+                                "plane/vZ", "plane/rollRate", "plane/pitchRate", "plane/yawRate"})
+            channels.push_back({name});
+    }
+    std::unique_ptr<SeriesWriter> next;
+    try {
+        // 行时间为数据包到达的 steady 时间 不受系统时间调整影响 文件头记录与系统时间的偏移
+        next = std::make_unique<SeriesWriter>(path, std::move(channels), blockRows,
+                                              realtimeNanoseconds() - steadyNanoseconds());
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+    target.writer = next.get();
+    std::lock_guard lock(recordMutex);
+    runInIo([this, &target] { series = std::move(target); });
+    seriesWriter.swap(next); // 旧文件在此写完并关闭
+    return true;
+}
+
+/**
+ * @brief 停止时间序列记录 写出剩余的行与索引
+ * @return 最终统计
+ */
+SeriesWriter::Report XPlaneUdp::stopSeries () {
+    std::lock_guard lock(recordMutex);
+    if (!seriesWriter)
+        return {};
+    runInIo([this] { series = SeriesTarget{}; });
+    const auto report = seriesWriter->close();
+    seriesWriter.reset();
+    return report;
+}
+
+SeriesWriter::Report XPlaneUdp::getSeriesReport () const {
+    std::lock_guard lock(recordMutex);
+    return seriesWriter ? seriesWriter->report() : SeriesWriter::Report{};
+}
+
+/**
+ * @brief 把订阅的 dataref 与基本信息发布到命名共享内存 其它进程用 SharedReader 读取 无需各自订阅
+ *        之后每个数据包在写入本地后写入共享内存 已在发布时替换为新的共享内存
+ * @param name 共享内存名称 已存在时覆盖
+ * @param valueCapacity 最多发布的值 values 中超出该位置的值不发布
+ * @param refCapacity 最多发布的 dataref
+ * @return 是否成功创建
+ */
+bool XPlaneUdp::startPublishing (const std::string &name, const size_t valueCapacity, const size_t refCapacity) {
+    std::unique_ptr<SharedPublisher> next;
+    try {
+        next = std::make_unique<SharedPublisher>(name, valueCapacity, refCapacity);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+    PlaneInfo current{};
+    loadInfo(info, current);
+    std::lock_guard lock(writeMutex);
+    for (size_t i = 0; i < dataRefs.size(); ++i) {
+        const auto &ref = dataRefs[i];
+        next->publishRef(i, ref.name, ref.available ? ref.start.load() : -1, ref.end);
+    }
+    next->publishAll(values, steadyNanoseconds());
+    next->publishInfo(current, infoTime.load(std::memory_order_relaxed));
+    next->publishState(state);
+    publisher.swap(next); // 旧的共享内存在此删除
+    return true;
+}
+
+/**
+ * @brief 停止发布 删除共享内存名称 已打开的读者停在最后的值
+ * @return 最终统计
+ */
+XPlaneUdp::PublishReport XPlaneUdp::stopPublishing () {
+    std::lock_guard lock(writeMutex);
+    if (!publisher)
+        return {};
+    const auto report = publisher->report();
+    publisher.reset();
+    return report;
+}
+
+XPlaneUdp::PublishReport XPlaneUdp::getPublishingReport () const {
+    std::lock_guard lock(writeMutex);
+    return publisher ? publisher->report() : PublishReport{};
+}
+
+/**
+ * @brief 在 io 线程执行并等待完成 已在 io 线程或已关闭时直接执行
+ */
+void XPlaneUdp::runInIo (const std::function<void  ()> &func) {
+    if (closed || strand.running_in_this_thread()) {
+        func();
+        return;
+    }
+    std::promise<void> done;
+    asio::post(strand, [&func, &done] {
+        func();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+asio::awaitable<size_t> XPlaneUdp::replayLog (PacketLog log, const double speed) {
+    asio::steady_timer timer(co_await asio::this_coro::executor);
+    const auto begin = std::chrono::steady_clock::now();
+    const int64_t origin = steadyNanoseconds(); // 记录时间平移到回放开始 与倍速无关
+    PacketRecord record;
+    size_t count = 0;
+    int64_t first = -1;
+    while (!closed && log.next(record)) {
+        if (first < 0)
+            first = record.time;
+        if (speed > 0) {
+            const auto due = begin + std::chrono::nanoseconds(
+                static_cast<int64_t>(static_cast<double>(record.time - first) / speed));
+            if (due > std::chrono::steady_clock::now()) {
+                timer.expires_at(due);
+                co_await timer.async_wait(asio::use_awaitable);
+            }
+        } else if (count % 64 == 63) { // 尽快回放时定期让出 io 线程
+            co_await asio::post(co_await asio::this_coro::executor, asio::use_awaitable);
+        }
+        receiveDataProcess(record.data, record.sender, origin + (record.time - first));
+        ++count;
+    }
+    if (!xpSocket.is_open()) // 与 XPlane 停止发送信标相同
+        setState(false);
+    else // 回放期间超时不断开 之后由主机信标维持连接
+        armBeaconTimer();
+    co_return count;
+}
+
+/**
+ * @brief 新增监听目标
+ * @param dataref dataref 名称
+ * @param freq 频率
+ * @param index 目标为数组时的索引
+ * @throw std::runtime_error values 容量不足
+ */
+XPlaneUdp::DatarefIndex XPlaneUdp::addDataref (const std::string &dataref, int32_t freq, int index) {
+    const std::string name = (index == -1) ? dataref : std::format("{}[{}]", dataref, index);
+    if (const size_t found = names.find(name); found != NameRegistry::NOT_FOUND) {
+        std::cerr << "already exist! nothing change.";
+        return DatarefIndex{found};
+    }
+    const auto start = static_cast<int32_t>(findSpace(1)); // RREF 中 index 为 4 字节
+    const auto stored = names.insert(name, dataRefs.size()).first;
+    auto &ref = dataRefs.emplace_back(stored, start, start, freq, true, false);
+    ref.requests = packRequests(stored, 1, freq, start, false);
+    bindSlots(dataRefs.size() - 1, true);
+    queueRequests(ref.requests, false);
+    flushData();
+    return DatarefIndex{dataRefs.size() - 1};
+}
+
+/**
+ * @brief 新增监听目标,目标为数组
+ * @param dataref dataref 名称
+ * @param length 数组长度
+ * @param freq 频率
+ * @throw std::runtime_error values 容量不足
+ */
+XPlaneUdp::DatarefIndex XPlaneUdp::addDatarefArray (const std::string &dataref, const int length, int32_t freq) {
+    if (const size_t found = names.find(dataref); found != NameRegistry::NOT_FOUND) {
+        std::cerr << "already exist! nothing change.";
+        return DatarefIndex{found};
+    }
+    const int start = static_cast<int>(findSpace(length));
+    const auto stored = names.insert(dataref, dataRefs.size()).first;
+    auto &ref = dataRefs.emplace_back(stored, start, start + length - 1, freq, true, true);
+    ref.requests = packRequests(stored, length, freq, start, true);
+    bindSlots(dataRefs.size() - 1, true);
+    queueRequests(ref.requests, false);
+    flushData();
+    return DatarefIndex{dataRefs.size() - 1};
+}
+
+/**
+ * @brief 获取 dataref 最新值
+ * @param dataref 标识
+ * @param value 返回值
+ * @param defaultValue 默认值
+ * @return 值可用
+ */
+bool XPlaneUdp::getDataref (const DatarefIndex &dataref, float &value, const float defaultValue) const {
+    const auto &ref = dataRefs.at(dataref.getIdx());
+    bool available{false};
+    dataLock.read([&] { // 位置与值一起读取 移动或停止时不会读到其它 dataref 的值
+        available = ref.available;
+        value = available ? values.get(ref.start) : defaultValue;
+    });
+    if (available)
+        noteRead(dataref.getIdx());
+    return available;
+}
+
+/**
+ * @brief 获取 dataref 最新值及其是否在 maxAge 内收到
+ * @param dataref 标识
+ * @param value 返回值 未订阅时不变 返回 NEVER 时其值无意义
+ * @param maxAge 最长允许的时间
+ * @return 值与时间来自同一时刻
+ */
+XPlaneUdp::Freshness XPlaneUdp::getDataref (const DatarefIndex &dataref, float &value,
+                                            const std::chrono::milliseconds maxAge) const {
+    const auto &ref = dataRefs.at(dataref.getIdx());
+    const uint32_t now = nowStamp();
+    uint32_t stamp{NEVER_STAMP};
+    bool available{false};
+    dataLock.read([&] {
+        available = ref.available;
+        if (available) {
+            value = values.get(ref.start);
+            stamp = slotTimes[ref.start].load(std::memory_order_relaxed);
+        }
+    });
+    if (!available)
+        return Freshness::NEVER;
+    noteRead(dataref.getIdx());
+    return freshness(stamp, now, maxAge);
+}
+
+/**
+ * @brief 找出超过 maxAge 未收到或尚未收到的 dataref 数组任一元素过期即计入
+ *        按位置扫描时间戳 (SIMD) 不逐个访问 dataref 每 StaleScan::CHUNK 个位置一个 dataLock 读取区
+ *        SIMD 核心以 uint32_t 读取 std::atomic<uint32_t> 两者大小相同且无锁 (见 freeStamps) 读到的值由顺序锁校验
+ * @param maxAge 最长允许的时间
+ * @param dst 输出 先清空 按 values 中位置排列
+ * @return 过期的 dataref 数
+ */
+size_t XPlaneUdp::findStale (const std::chrono::milliseconds maxAge, std::vector<DatarefIndex> &dst) const {
+    dst.clear();
+    const uint32_t now = nowStamp();
+    // 年龄在 (age, 2^32 - STAMP_LEAD) 内者过期 即时间戳在 (now + STAMP_LEAD, now - age - 1] 内
+    // 尚未收到与 ANCIENT_STAMP 的总是过期
+    const auto age = static_cast<uint32_t>(std::clamp<int64_t>(maxAge.count(), 0, UINT32_MAX - 2 * STAMP_LEAD));
+    const uint32_t newest = now - age - 1;
+    const uint32_t span = UINT32_MAX - STAMP_LEAD - age;
+    const auto *stamps = reinterpret_cast<const uint32_t*>(slotTimes.get());
+    const size_t end = values.size();
+    std::array<uint32_t, StaleScan::CHUNK> found;
+    int32_t last{-1};
+    for (size_t first = 0; first < end; first += StaleScan::CHUNK) {
+        const size_t before = dst.size();
+        const int32_t previous = last;
+        // 时间戳与位置所属都在写入区内修改 整块在读取区内扫描 期间有写入时重新扫描该块 不取 writeMutex 不阻塞接收
+        dataLock.read([&] {
+            dst.resize(before);
+            last = previous;
+            const size_t hits = staleKernel(stamps + first, std::min(StaleScan::CHUNK, end - first), newest, span,
+                                            found.data());
+            for (size_t i = 0; i < hits; ++i) {
+                const int32_t owner = slotOwner[first + found[i]];
+                if (owner >= 0 && owner != last) // 同一 dataref 的位置连续
+                    dst.emplace_back(static_cast<size_t>(owner));
+                last = owner;
+            }
+        });
+    }
+    return dst.size();
+}
+
+/**
+ * @brief 把年龄超过 STAMP_ANCIENT 的时间戳改为 ANCIENT_STAMP 之后不论多久未收到都过期
+ *        没有需要修改的位置时不进入写入区 时间戳只在 writeMutex 内写入 持有 writeMutex 时扫描不会与写入并发
+ * @return 修改的位置数
+ */
+size_t XPlaneUdp::ageStamps () {
+    std::lock_guard lock(writeMutex);
+    const uint32_t now = nowStamp();
+    // 年龄在 [STAMP_ANCIENT, 2^32 - STAMP_LEAD) 内 即时间戳在 (now + STAMP_LEAD, now - STAMP_ANCIENT] 内
+    const uint32_t newest = now - STAMP_ANCIENT;
+    const uint32_t span = UINT32_MAX - STAMP_LEAD - STAMP_ANCIENT + 1;
+    const auto *stamps = reinterpret_cast<const uint32_t*>(slotTimes.get());
+    const size_t end = values.size();
+    std::array<uint32_t, StaleScan::CHUNK> found;
+    size_t aged{0};
+    for (size_t first = 0; first < end; first += StaleScan::CHUNK) {
+        const size_t hits = staleKernel(stamps + first, std::min(StaleScan::CHUNK, end - first), newest, span,
+                                        found.data());
+        size_t lapsed{0};
+        for (size_t i = 0; i < hits; ++i) {
+            if (stamps[first + found[i]] > ANCIENT_STAMP) // 同时输出的 NEVER 与 ANCIENT 不修改
+                found[lapsed++] = found[i];
+        }
+        if (lapsed == 0)
+            continue;
+        dataLock.write([&] {
+            for (size_t i = 0; i < lapsed; ++i)
+                slotTimes[first + found[i]].store(ANCIENT_STAMP, std::memory_order_relaxed);
+        });
+        aged += lapsed;
+    }
+    return aged;
+}
+
+/**
+ * @brief 每 STAMP_SWEEP 调用一次 ageStamps 与是否连接无关
+ */
+asio::awaitable<void> XPlaneUdp::ageLoop () {
+    while (true) {
+        stampTimer.expires_after(STAMP_SWEEP);
+        co_await stampTimer.async_wait(asio::use_awaitable);
+        ageStamps();
+    }
+}
+
+/**
+ * @brief steady ns 换算为时间戳 模 2^32 回绕 跳过 NEVER_STAMP、ANCIENT_STAMP 与 FREE_STAMP
+ */
+uint32_t XPlaneUdp::toStamp (const int64_t nanoseconds) const {
+    const auto elapsed = (nanoseconds - stampEpoch.load(std::memory_order_relaxed)) / 1'000'000 + 1;
+    const auto stamp = static_cast<uint32_t>(static_cast<uint64_t>(elapsed));
+    return stamp <= ANCIENT_STAMP || stamp == FREE_STAMP ? ANCIENT_STAMP + 1 : stamp;
+}
+
+uint32_t XPlaneUdp::nowStamp () const {
+    return toStamp(steadyNanoseconds());
+}
+
+/**
+ * @brief 模 2^32 的年龄 晚于 now 不超过 STAMP_LEAD 的时间戳 (读取 now 之后写入) 年龄为 0
+ */
+uint32_t XPlaneUdp::stampAge (const uint32_t now, const uint32_t stamp) {
+    const uint32_t age = now - stamp;
+    return age > UINT32_MAX - STAMP_LEAD ? 0 : age;
+}
+
+/**
+ * @brief 一段位置中年龄最大的时间戳 有尚未收到的位置时为 NEVER_STAMP 需在 dataLock 读取区内调用
+ */
+uint32_t XPlaneUdp::oldestStamp (const size_t start, const size_t length, const uint32_t now) const {
+    uint32_t oldest{now};
+    for (size_t i = start; i < start + length; ++i) {
+        const uint32_t stamp = slotTimes[i].load(std::memory_order_relaxed);
+        if (stamp == NEVER_STAMP || stamp == FREE_STAMP)
+            return NEVER_STAMP;
+        if (stamp == ANCIENT_STAMP)
+            oldest = ANCIENT_STAMP;
+        else if (oldest != ANCIENT_STAMP && stampAge(now, stamp) > stampAge(now, oldest))
+            oldest = stamp;
+    }
+    return oldest;
+}
+
+XPlaneUdp::Freshness XPlaneUdp::freshness (const uint32_t stamp, const uint32_t now,
+                                           const std::chrono::milliseconds maxAge) {
+    if (stamp == NEVER_STAMP || stamp == FREE_STAMP)
+        return Freshness::NEVER;
+    if (stamp == ANCIENT_STAMP)
+        return Freshness::STALE;
+    return static_cast<int64_t>(stampAge(now, stamp)) <= maxAge.count() ? Freshness::FRESH : Freshness::STALE;
+}
+
+/**
+ * @brief 修改获取 dataref 的频率 只修改预先打包请求中的频率与位置
+ *        停止接收时释放 values 中的位置 恢复时重新分配
+ * @param dataref 标识
+ * @param freq 频率 0 为停止接收
+ * @throw std::runtime_error 恢复接收时 values 容量不足
+ */
+void XPlaneUdp::changeDatarefFreq (const DatarefIndex &dataref, const float freq) {
+    auto &ref = dataRefs.at(dataref.getIdx());
+    const int size = ref.end - ref.start + 1;
+    auto &requests = ref.requests;
+    const auto sendFreq = static_cast<int32_t>(freq); // RREF 中频率与 index 均为 4 字节整数
+    if (dataref.getIdx() < requestedFreq.size()) // 自适应频率从新的频率开始
+        requestedFreq[dataref.getIdx()] = sendFreq == 0 ? -1 : sendFreq;
+    if (ref.schema >= 0) { // schema 字段位置固定 只修改频率
+        if (freq == 0) // 在清零前以频率 0 发送 通知 xp 停止
+            queueRequests(requests, true);
+        ref.freq = sendFreq;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            auto packet = requests.at(i);
+            pack(packet, HEADER_LENGTH, ref.freq);
+        }
+        queueRequests(requests, false);
+        flushData();
+        return;
+    }
+    if (freq == 0) { // 停止接收
+        if (!ref.available)
+            return;
+        // 以频率 0 发往原位置 否则 xp 会继续写入之后被其它 dataref 复用的位置
+        queueRequests(requests, true);
+        flushData();
+        bindSlots(dataref.getIdx(), false);
+        releaseSpace(ref.start, size);
+        return;
+    }
+    // 先恢复
+    if (!ref.available) {
+        const int start = takeQuarantined(static_cast<size_t>(ref.start), static_cast<size_t>(size))
+                              ? ref.start.load() // 原位置仍在隔离中 直接取回
+                              : static_cast<int>(findSpace(size));
+        {
+            std::lock_guard lock(writeMutex);
+            dataLock.write([&] {
+                ref.start = start;
+                ref.end = start + size - 1;
+            });
+        }
+        bindSlots(dataref.getIdx(), true);
+    }
+    // 再发送
+    ref.freq = sendFreq;
+    for (int i = 0; i < size; ++i) {
+        auto packet = requests.at(i);
+        pack(packet, HEADER_LENGTH, ref.freq, int32_t{ref.start + i});
+    }
+    queueRequests(requests, false);
+    flushData();
+}
+
+/**
+ * @brief 启用自适应频率 统计每个 DatarefIndex 的读取 (getDataref/getDatarefAt/view 与 waitUpdate/nextUpdate 的每次返回)
+ *        由 adaptFreq 按读取频率在上下限内修改 RREF 频率 schema 字段由 getSchema 整体读取 不受控
+ *        启用后每次读取多一次原子加 各读者线程计入各自的缓存行 多线程读取同一 dataref 时不争用
+ *        启用前后每次读取的耗时见 adaptiveFreqBenchmark
+ * @param options 上下限 余量与回差
+ */
+void XPlaneUdp::enableAdaptiveFreq (const AdaptiveOptions &options) {
+    const size_t size = std::max<size_t>(dataRefs.size(), 64); // 之后的订阅由 reserveReadCounts 加倍
+    if (readCountStores.empty() || readCountStores.back()->size < size)
+        readCountStores.push_back(std::make_unique<ReadCounts>(size));
+    else
+        for (size_t i = 0; i < readCountStores.back()->size; ++i)
+            readCountStores.back()->take(i);
+    adaptiveOptions = options;
+    adaptiveOptions.minFreq = std::max(options.minFreq, 1);
+    adaptiveOptions.maxFreq = std::max(options.maxFreq, adaptiveOptions.minFreq);
+    requestedFreq.assign(dataRefs.size(), -1);
+    adaptTime = std::chrono::steady_clock::now();
+    readCounts.store(readCountStores.back().get(), std::memory_order_release);
+}
+
+/**
+ * @brief 保证读取计数能容纳 refs 个 dataref 不足时换用加倍的计数 已有的计数一并移过去
+ *        旧计数保留到析构 换用前后读者在旧计数上的少量递增会丢失
+ * @param refs dataref 数
+ */
+void XPlaneUdp::reserveReadCounts (const size_t refs) {
+    ReadCounts *current = readCounts.load(std::memory_order_relaxed);
+    if (current == nullptr || current->size >= refs)
+        return;
+    auto &grown = readCountStores.emplace_back(std::make_unique<ReadCounts>(std::max(refs, current->size * 2)));
+    for (size_t i = 0; i < current->size; ++i)
+        grown->at(0, i).store(current->take(i), std::memory_order_relaxed);
+    readCounts.store(grown.get(), std::memory_order_release);
+}
+
+/**
+ * @brief 停止自适应频率 恢复订阅时的频率
+ */
+void XPlaneUdp::disableAdaptiveFreq () {
+    if (readCounts.exchange(nullptr, std::memory_order_acq_rel) == nullptr)
+        return;
+    bool changed{false};
+    for (size_t i = 0; i < std::min(requestedFreq.size(), dataRefs.size()); ++i) {
+        auto &ref = dataRefs[i];
+        if (requestedFreq[i] > 0 && ref.available && ref.freq > 0 && ref.freq != requestedFreq[i]) {
+            patchFreq(ref, requestedFreq[i]);
+            changed = true;
+        }
+    }
+    requestedFreq.clear();
+    if (changed)
+        flushData();
+}
+
+/**
+ * @brief 按上次调用以来的读取频率修改 RREF 频率 在订阅线程周期调用 (如每秒一次)
+ *        目标频率为读取频率 * headroom 限制在上下限内 未设置 allowRaise 时不超过订阅时的频率
+ *        与当前频率相差超过 hysteresis 时才修改
+ *        只修改预先打包请求中的频率 一次批量发送
+ * @return 修改频率的 dataref 数
+ */
+size_t XPlaneUdp::adaptFreq () {
+    if (readCounts.load(std::memory_order_relaxed) == nullptr)
+        return 0;
+    reserveReadCounts(dataRefs.size());
+    const ReadCounts *reads = readCounts.load(std::memory_order_relaxed);
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - adaptTime).count();
+    if (elapsed <= 0)
+        return 0;
+    adaptTime = now;
+    if (requestedFreq.size() < dataRefs.size())
+        requestedFreq.resize(dataRefs.size(), -1);
+    const auto &[minFreq, maxFreq, headroom, hysteresis, allowRaise] = adaptiveOptions;
+    size_t changed{0};
+    for (size_t i = 0; i < dataRefs.size(); ++i) {
+        auto &ref = dataRefs[i];
+        if (!ref.available || ref.schema >= 0 || ref.freq <= 0)
+            continue;
+        if (requestedFreq[i] < 0)
+            requestedFreq[i] = ref.freq;
+        const double rate = reads->take(i) / elapsed;
+        const int32_t upper = allowRaise ? maxFreq : std::min(maxFreq, requestedFreq[i]);
+        const auto target = static_cast<int32_t>(std::clamp(std::ceil(rate * headroom),
+                                                            static_cast<double>(std::min(minFreq, upper)),
+                                                            static_cast<double>(upper)));
+        if (std::abs(target - ref.freq) <= ref.freq * hysteresis)
+            continue;
+        patchFreq(ref, target);
+        ++changed;
+    }
+    adaptChanges += changed;
+    if (changed != 0)
+        flushData();
+    return changed;
+}
+
+/**
+ * @brief 自适应频率的效果 按订阅时与当前频率估算 不含数据包头部
+ */
+XPlaneUdp::AdaptiveReport XPlaneUdp::getAdaptiveReport () const {
+    AdaptiveReport report{.changes = adaptChanges, .requestBytes = adaptRequestBytes};
+    for (size_t i = 0; i < std::min(requestedFreq.size(), dataRefs.size()); ++i) {
+        const auto &ref = dataRefs[i];
+        if (requestedFreq[i] <= 0 || !ref.available)
+            continue;
+        const auto elements = static_cast<double>(ref.end - ref.start + 1);
+        ++report.refs;
+        report.requestedValues += requestedFreq[i] * elements;
+        report.currentValues += ref.freq * elements;
+    }
+    report.savedBytes = (report.requestedValues - report.currentValues) * 8;
+    return report;
+}
+
+/**
+ * @brief 修改预先打包请求中的频率并加入发送队列 位置不变
+ * @param ref dataref
+ * @param freq 新频率 大于 0
+ */
+void XPlaneUdp::patchFreq (DatarefInfo &ref, const int32_t freq) {
+    ref.freq = freq;
+    for (size_t i = 0; i < ref.requests.size(); ++i) {
+        auto packet = ref.requests.at(i);
+        pack(packet, HEADER_LENGTH, freq);
+    }
+    queueRequests(ref.requests, false);
+    adaptRequestBytes += ref.requests.size() * RrefRequests::PACKET_SIZE;
+}
+
+/**
+ * @brief 设置重新订阅的优先级 听见信标重新订阅时先发送优先级高的 dataref 的请求
+ * @param dataref 标识
+ * @param priority 优先级 默认 0
+ */
+void XPlaneUdp::setDatarefPriority (const DatarefIndex &dataref, const int32_t priority) {
+    dataRefs.at(dataref.getIdx()).priority = priority;
+}
+
+/**
+ * @brief 保留 dataref 最近的样本 每次数据包更新该 dataref 时追加一个样本
+ *        显示帧率高于 XPlane 发送频率时 可按显示时刻用 getDatarefAt 插值
+ * @param dataref 标识
+ * @param depth 样本数 0 为停止记录 修改深度时丢弃已有样本
+ * @return 标识是否有效
+ */
+bool XPlaneUdp::setHistory (const DatarefIndex &dataref, const size_t depth) {
+    if (dataref.getIdx() >= dataRefs.size())
+        return false;
+    const auto &ref = dataRefs[dataref.getIdx()];
+    HistoryRing *target{nullptr};
+    if (depth > 0) // 在订阅线程分配 接收时不分配
+        target = historyRings.emplace_back(std::make_unique<HistoryRing>(
+            depth, static_cast<size_t>(ref.end - ref.start + 1), static_cast<size_t>(ref.start))).get();
+    std::lock_guard lock(writeMutex);
+    growHistory();
+    auto &slot = history[dataref.getIdx()];
+    historyRefs = historyRefs + (target != nullptr) - (slot.load(std::memory_order_relaxed) != nullptr);
+    slot.store(target, std::memory_order_release); // 旧的历史保留在 historyRings 中 仍在读取的读者不受影响
+    return true;
+}
+
+/**
+ * @brief 从历史获取 dataref 某时刻的值 需先 setHistory
+ * @param dataref 标识
+ * @param time 时刻 晚于最新样本时为最新值
+ * @param value 返回值 数组为第一个元素
+ * @param mode 插值方式
+ * @return false 未启用历史或没有不晚于该时刻的样本 value 不变
+ */
+bool XPlaneUdp::getDatarefAt (const DatarefIndex &dataref, const HistoryRing::Clock::time_point time, float &value,
+                              const HistoryRing::Interpolation mode) const {
+    const HistoryRing *target = historyOf(dataref);
+    if (target == nullptr)
+        return false;
+    noteRead(dataref.getIdx());
+    bool found{false};
+    dataLock.read([&] { found = target->at(time, mode, 1, &value); });
+    return found;
+}
+
+/**
+ * @brief 复制一段时间内的历史
+ * @param dataref 标识
+ * @param from 起始时刻 包含
+ * @param to 结束时刻 包含
+ * @param times 各样本接收时间
+ * @param dst 样本值 第 i 个样本的第 j 个元素位于 i * 长度 + j
+ * @return 样本数
+ */
+size_t XPlaneUdp::copyHistory (const DatarefIndex &dataref, const HistoryRing::Clock::time_point from,
+                               const HistoryRing::Clock::time_point to,
+                               std::vector<HistoryRing::Clock::time_point> &times, std::vector<float> &dst) const {
+    const HistoryRing *target = historyOf(dataref);
+    size_t count{0};
+    if (target == nullptr) {
+        times.clear();
+        dst.clear();
+        return count;
+    }
+    dataLock.read([&] { count = target->copy(from, to, times, dst); });
+    return count;
+}
+
+/**
+ * @brief 复制最新的若干个样本
+ * @param dataref 标识
+ * @param last 样本数
+ * @param times 各样本接收时间 由旧到新
+ * @param dst 样本值 第 i 个样本的第 j 个元素位于 i * 长度 + j
+ * @return 样本数 不超过已有样本
+ */
+size_t XPlaneUdp::copyHistory (const DatarefIndex &dataref, const size_t last,
+                               std::vector<HistoryRing::Clock::time_point> &times, std::vector<float> &dst) const {
+    const HistoryRing *target = historyOf(dataref);
+    size_t count{0};
+    if (target == nullptr) {
+        times.clear();
+        dst.clear();
+        return count;
+    }
+    dataLock.read([&] { count = target->copyLast(last, times, dst); });
+    return count;
+}
+
+const HistoryRing* XPlaneUdp::historyOf (const DatarefIndex &dataref) const {
+    return dataref.getIdx() < history.size() ? history[dataref.getIdx()].load(std::memory_order_acquire) : nullptr;
+}
+
+/**
+ * @brief 追加 history 至 dataRefs 的数量 调用方持有 writeMutex
+ */
+void XPlaneUdp::growHistory () {
+    while (history.size() < dataRefs.size())
+        history.emplace_back(nullptr);
+}
+
+/**
+ * @brief 为 schema 分配连续位置 登记各字段 打包并发送 RREF
+ * @param layout 字段描述
+ * @param length 位置总数
+ * @return values 中起点 与第一个字段的 dataRefs 下标
+ */
+std::pair<size_t, size_t> XPlaneUdp::addSchemaLayout (const std::span<const SchemaLayout> layout, const int length) {
+    const size_t start = findSpace(length);
+    const size_t firstRef = dataRefs.size();
+    const int32_t schemaIndex = schemaCount++;
+    for (const auto &field : layout) {
+        const auto stored = names.insert(field.name, dataRefs.size()).first; // 与已有的同名时只共用名称
+        const int fieldStart = static_cast<int>(start) + field.offset;
+        auto &ref = dataRefs.emplace_back(stored, fieldStart, fieldStart + field.length - 1, field.freq, true,
+                                          field.isArray, schemaIndex);
+        ref.requests = packRequests(stored, field.length, field.freq, fieldStart, field.isArray);
+        bindSlots(dataRefs.size() - 1, true);
+        queueRequests(ref.requests, false);
+    }
+    flushData();
+    return {start, firstRef};
+}
+
+/**
+ * @brief 打包 dataref 每个元素的 RREF 请求 名称只在此格式化一次 之后只修改频率与位置
+ * @param name dataref 名称
+ * @param length 元素数
+ * @param freq 频率
+ * @param start values 中起点
+ * @param isArray 是否为数组 数组的请求为 name[i]
+ */
+XPlaneUdp::RrefRequests XPlaneUdp::packRequests (const std::string_view name, const int length, const int32_t freq,
+                                                 const int32_t start, const bool isArray) {
+    RrefRequests requests;
+    const auto element = [&](const int i) {
+        return isArray ? std::format("{}[{}]", name, i) : std::string(name);
+    };
+    // 最后一个元素的名称最长
+    requests.stride = packSize(0, DATAREF_GET_HEAD, freq, start, element(std::max(length - 1, 0)));
+    requests.bytes.resize(requests.stride * static_cast<size_t>(length));
+    for (int i = 0; i < length; ++i) {
+        auto packet = requests.at(i);
+        pack(packet, 0, DATAREF_GET_HEAD, freq, int32_t{start + i}, element(i));
+    }
+    return requests;
+}
+
+/**
+ * @brief 将预先打包的请求加入发送队列 跳过频率为 0 的
+ * @param requests 请求
+ * @param del 以频率 0 发送 停止接收
+ */
+void XPlaneUdp::queueRequests (const RrefRequests &requests, const bool del) {
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const auto packet = requests.at(i);
+        int32_t freq;
+        unpack(packet, HEADER_LENGTH, freq);
+        if (freq == 0)
+            continue;
+        const auto buffer = pool.getBuffer(packet.size(), RrefRequests::PACKET_SIZE); // 补零
+        std::memcpy(buffer->data(), packet.data(), packet.size());
+        if (del)
+            pack(*buffer, HEADER_LENGTH, int32_t{0});
+        queueData(buffer, RrefRequests::PACKET_SIZE);
+    }
+}
+
+/**
+ * @brief 把 DSEL 或 USEL 加入发送队列 全部组在一个数据包
+ * @param groups 组序号 为空时不发送
+ * @param del 是否停止
+ */
+void XPlaneUdp::queueGroupSelect (const std::span<const int32_t> groups, const bool del) {
+    if (groups.empty())
+        return;
+    const size_t size = HEADER_LENGTH + groups.size() * sizeof(int32_t);
+    const auto buffer = pool.getBuffer(size);
+    pack(*buffer, 0, del ? DATA_UNSELECT_HEAD : DATA_SELECT_HEAD);
+    std::memcpy(buffer->data() + HEADER_LENGTH, groups.data(), groups.size() * sizeof(int32_t));
+    queueData(buffer, size);
+}
+
+/**
+ * @brief 设置dataref值 启用写入缓冲时只记录 由 flushWrites 发送
+ * @param dataref dataref 名称
+ * @param value 值
+ * @param index 目标为数组时的索引
+ */
+void XPlaneUdp::setDataref (const std::string &dataref, const float value, const int index) {
+    if (!bufferWrite(dataref, value, index))
+        sendData(packWrite(dataref, value, index), 509);
+}
+
+/**
+ * @brief 打包一个 DREF
+ * @param dataref dataref 名称
+ * @param value 值
+ * @param index 目标为数组时的索引
+ * @return 补齐到 509 字节的数据包
+ */
+BufferPool::Buffer XPlaneUdp::packWrite (const std::string &dataref, const float value, const int index) {
+    // 数组下标直接写入缓冲 不构造临时字符串
+    std::array<char, 16> suffix{};
+    size_t suffixSize = 0;
+    if (index != -1) {
+        suffix[0] = '[';
+        char *end = std::to_chars(suffix.data() + 1, suffix.data() + suffix.size() - 1, index).ptr;
+        *end = ']';
+        suffixSize = end - suffix.data() + 1;
+    }
+    const size_t nameEnd = packSize(0, DATAREF_SET_HEAD, value, dataref);
+    auto buffer = pool.getBuffer(nameEnd + suffixSize, 509);
+    pack(*buffer, 0, DATAREF_SET_HEAD, value, dataref);
+    std::memcpy(buffer->data() + nameEnd, suffix.data(), suffixSize);
+    return buffer;
+}
+
+/**
+ * @brief 启用写入缓冲 setDataref 只保留每个目标最后的值 与上次发送的值相同时丢弃 由 flushWrites 一次批量发送
+ *        抑制与合并的次数见 getStats()
+ * @param tick 自动 flushWrites 的周期 0 为由调用者在每个周期结束时调用
+ * @param epsilon 与上次发送的值相差不超过该值时不发送 0 为完全相同
+ */
+void XPlaneUdp::enableWriteBuffer (const std::chrono::microseconds tick, const float epsilon) {
+    {
+        std::lock_guard lock(writeBufferMutex);
+        writeEpsilon = epsilon;
+        writeBuffered = true;
+    }
+    runInIo([this, tick] {
+        writeTimer.cancel();
+        if (tick.count() > 0)
+            spawn(flushLoop(tick));
+    });
+}
+
+/**
+ * @brief 发送缓冲中剩余的值 之后 setDataref 立即发送
+ *        未连接时剩余的值丢弃 不在重新连接后发送 与未启用缓冲时未连接期间的 setDataref 相同
+ */
+void XPlaneUdp::disableWriteBuffer () {
+    runInIo([this] { writeTimer.cancel(); });
+    {
+        std::lock_guard lock(writeBufferMutex);
+        writeBuffered = false;
+    }
+    flushWrites();
+    std::lock_guard lock(writeBufferMutex);
+    dirtyWrites.clear(); // 未连接时 flushWrites 不清空 其中的指针指向 writeSlots 的元素
+    writeSlots.clear();
+}
+
+/**
+ * @brief 发送写入缓冲中与上次发送不同的值 每个目标一个 DREF 一次批量发送 未连接时保留到连接后
+ * @return 发送的 DREF 数
+ */
+size_t XPlaneUdp::flushWrites () {
+    if (!xpOpen.load(std::memory_order_acquire))
+        return 0;
+    size_t count{0};
+    {
+        std::lock_guard lock(writeBufferMutex);
+        for (const auto &[target, index] : dirtyWrites) {
+            WriteSlot &slot = target->second[index + 1];
+            slot.queued = false;
+            if (!slot.dirty) // 后来被改回上次发送的值
+                continue;
+            slot.dirty = false;
+            slot.sent = slot.pending;
+            slot.hasSent = true;
+            queueData(packWrite(target->first, slot.pending, index), 509);
+            ++count;
+        }
+        dirtyWrites.clear();
+    }
+    if (count != 0)
+        flushData();
+    return count;
+}
+
+/**
+ * @brief 协程版 flushWrites 批量发送交给内核后完成 用法 co_await xp.flushWrites(asio::use_awaitable)
+ *        发送缓冲区满时挂起 由发送者发完后在协程的执行器上恢复 不阻塞线程
+ * @return 发送的 DREF 数
+ */
+asio::awaitable<size_t> XPlaneUdp::flushWrites (asio::use_awaitable_t<>) {
+    const size_t count = flushWrites();
+    if (sendScheduled) { // 先置 flushPending 再检查 与 drainSend 的顺序相反 两者至少一方看到对方
+        co_await suspend([this] (std::unique_ptr<AsyncWaiter> waiter) {
+            flushPending = true;
+            if (sendScheduled) {
+                flushWaiters.push_back(std::move(waiter));
+                return;
+            }
+            flushPending = !flushWaiters.empty();
+            waiter->complete(true);
+        });
+    }
+    co_return count;
+}
+
+/**
+ * @brief 写入缓冲 同一目标只保留最后的值 每个目标每个周期最多排队一次
+ *        改回上次发送的值时取消本周期待发送的修改 计为抑制
+ * @return false 未启用写入缓冲 需立即发送
+ */
+bool XPlaneUdp::bufferWrite (const std::string &dataref, const float value, const int index) {
+    std::lock_guard lock(writeBufferMutex);
+    if (!writeBuffered)
+        return false;
+    auto it = writeSlots.find(dataref);
+    if (it == writeSlots.end())
+        it = writeSlots.try_emplace(dataref).first;
+    auto &slots = it->second;
+    if (slots.size() < static_cast<size_t>(index + 2))
+        slots.resize(index + 2);
+    WriteSlot &slot = slots[index + 1];
+    const bool unchanged = slot.hasSent && std::abs(value - slot.sent) <= writeEpsilon;
+    if (unchanged) { // 与上次发送的值相同 同时取消本周期待发送的修改
+        XPlaneStats::bump(stats.writesSuppressed);
+        slot.dirty = false;
+        return true;
+    }
+    if (slot.dirty)
+        XPlaneStats::bump(stats.writesCoalesced);
+    slot.pending = value;
+    slot.dirty = true;
+    if (!slot.queued) {
+        slot.queued = true;
+        dirtyWrites.emplace_back(&*it, index);
+    }
+    return true;
+}
+
+asio::awaitable<void> XPlaneUdp::flushLoop (const std::chrono::microseconds tick) {
+    auto due = std::chrono::steady_clock::now();
+    while (true) {
+        due = std::max(due + tick, std::chrono::steady_clock::now());
+        writeTimer.expires_at(due);
+        co_await writeTimer.async_wait(asio::use_awaitable);
+        flushWrites();
+    }
+}
+
+/**
+ * @brief 以 DSEL 订阅一个 DATA 组 每组 8 个值 序号同 XPlane 数据输出界面
+ *        XPlane 按其数据输出设置中的 UDP 频率发送 不能按组设置频率 重新连接时与 RREF 一起重新订阅
+ *        每组在 DATA 中只占 36 字节 RREF 每个值占 8 字节 且每个值需一个 413 字节的请求
+ * @param group 组序号 0 ~ DATA_GROUPS - 1
+ * @return 序号是否合法
+ */
+bool XPlaneUdp::addDataGroup (const int group) {
+    if (group < 0 || static_cast<size_t>(group) >= DATA_GROUPS)
+        return false;
+    {
+        std::lock_guard lock(writeMutex);
+        if (std::ranges::find(dataGroups, group) != dataGroups.end())
+            return true;
+        dataGroups.push_back(group);
+    }
+    const std::array<int32_t, 1> selected{group};
+    queueGroupSelect(selected, false);
+    flushData();
+    return true;
+}
+
+/**
+ * @brief 以 USEL 停止一个 DATA 组 已收到的值保留
+ * @param group 组序号
+ */
+void XPlaneUdp::removeDataGroup (const int group) {
+    {
+        std::lock_guard lock(writeMutex);
+        const auto it = std::ranges::find(dataGroups, group);
+        if (it == dataGroups.end())
+            return;
+        dataGroups.erase(it);
+    }
+    const std::array<int32_t, 1> selected{group};
+    queueGroupSelect(selected, true);
+    flushData();
+}
+
+/**
+ * @brief 获取 DATA 组最新值
+ * @param group 组序号
+ * @param dst 目标 未收到时不变
+ * @return 是否收到过
+ */
+bool XPlaneUdp::getDataGroup (const int group, DataGroup &dst) const {
+    if (group < 0 || static_cast<size_t>(group) >= DATA_GROUPS ||
+        groupTime[group].load(std::memory_order_relaxed) == 0)
+        return false;
+    dataLock.read([&] { groupValues.copy(static_cast<size_t>(group) * GROUP_WIDTH, GROUP_WIDTH, dst.begin()); });
+    return true;
+}
+
+/**
+ * @brief 一次读取多个 DATA 组 各组来自同一时刻 序号不合法或未收到的组为 0
+ * @param groups 组序号
+ * @param dst 目标 与 groups 一一对应 较短时只读取前面的组
+ * @return 更新序号 同 snapshot
+ */
+uint64_t XPlaneUdp::getDataGroups (const std::span<const int> groups, const std::span<DataGroup> dst) const {
+    const size_t count = std::min(groups.size(), dst.size());
+    const uint64_t version = dataLock.read([&] {
+        for (size_t i = 0; i < count; ++i) {
+            if (groups[i] < 0 || static_cast<size_t>(groups[i]) >= DATA_GROUPS)
+                dst[i].fill(0);
+            else
+                groupValues.copy(static_cast<size_t>(groups[i]) * GROUP_WIDTH, GROUP_WIDTH, dst[i].begin());
+        }
+    });
+    return version / 2;
+}
+
+/**
+ * @brief 开始接收基本信息
+ * @param freq 接收频率
+ */
+void XPlaneUdp::addPlaneInfo (int freq) {
+    infoFreq = freq;
+    const std::string sentence = std::format("{}{}\x00", BASIC_INFO_HEAD, freq);
+    const size_t bufferSize = packSize(0, sentence);
+    const auto buffer = pool.getBuffer(bufferSize);
+    pack(*buffer, 0, sentence);
+    sendData(buffer, bufferSize);
+}
+
+/**
+ * @brief 获取基本信息最新值
+ */
+void XPlaneUdp::getPlaneInfo (PlaneInfo &infoDst) const {
+    dataLock.read([&] { loadInfo(info, infoDst); });
+}
+
+/**
+ * @brief 外推某时刻的基本信息 由最近两个 RPOS 的速度与角速度推算 两包之间与丢包时仍平滑变化
+ *        距最近一个 RPOS 超过 PREDICT_LIMIT 时停在该时刻 早于最近一个 RPOS 时为其值
+ *        经纬度以 double 计算 每个 RPOS 到达时的外推误差计入 getStats()
+ * @param time 时刻 通常为显示时刻
+ * @param infoDst 外推结果
+ * @return false 尚未收到 RPOS infoDst 为 getPlaneInfo 的值
+ */
+bool XPlaneUdp::predictPlaneInfo (const std::chrono::steady_clock::time_point time, PlaneInfo &infoDst) const {
+    PlaneInfo last{}, previous{};
+    int64_t lastTime{0}, previousTime{0};
+    dataLock.read([&] {
+        loadInfo(info, last);
+        loadInfo(previousInfo, previous);
+        lastTime = infoTime.load(std::memory_order_relaxed);
+        previousTime = previousInfoTime.load(std::memory_order_relaxed);
+    });
+    if (lastTime == 0) {
+        infoDst = last;
+        return false;
+    }
+    const int64_t target = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    infoDst = extrapolate(last, previous, previousTime == 0 ? 0 : lastTime - previousTime, target - lastTime);
+    return true;
+}
+
+/**
+ * @brief 一次性复制全部 dataref 值与基本信息 各值来自同一时刻
+ *        dst 可重复使用 容量足够时不分配内存 序号未变化时不复制
+ * @param dst 目标 sequence 为上次的序号
+ * @return 更新序号
+ */
+uint64_t XPlaneUdp::snapshot (Snapshot &dst) const {
+    if (dataLock.version() / 2 == dst.sequence && dst.sequence != 0)
+        return dst.sequence;
+    if (const size_t size = values.size(); dst.values.size() < size)
+        dst.values.resize(size);
+    const uint64_t version = dataLock.read([&] {
+        values.copy(0, dst.values.size(), dst.values.begin());
+        loadInfo(info, dst.info);
+    });
+    dst.sequence = version / 2;
+    return dst.sequence;
+}
+
+/**
+ * @brief 快照中某个 dataref 的值
+ * @param snap 快照
+ * @param dataref 标识
+ * @return 值 不可用或快照之后位置改变 (停止、恢复、compactSpace) 时为空 需重新 snapshot
+ */
+std::span<const float> XPlaneUdp::view (const Snapshot &snap, const DatarefIndex &dataref) const {
+    const auto &ref = dataRefs.at(dataref.getIdx());
+    Placement place;
+    uint64_t placed{0};
+    dataLock.read([&] {
+        place = {ref.start, ref.end, ref.available};
+        placed = ref.placed;
+    });
+    if (!place.available || placed > snap.sequence || static_cast<size_t>(place.end) >= snap.values.size())
+        return {};
+    noteRead(dataref.getIdx());
+    return std::span(snap.values).subspan(static_cast<size_t>(place.start), place.end - place.start + 1);
 }
 
-void BufferPool::recycleBuffer (BufferPro *buffer) {
-    if (buffer) {
-        std::memset(buffer->data.data(), 0x00, buffer->length);
-        buffer->~BufferPro();
-        boost::pool_allocator<BufferPro>::deallocate(buffer, 1);
-    }
+/**
+ * @brief 读取基本信息 需在 dataLock 读取区内调用
+ * @param src 按字存储的基本信息
+ * @param dst 基本信息
+ */
+void XPlaneUdp::loadInfo (const InfoWords &src, PlaneInfo &dst) {
+    std::array<uint32_t, INFO_WORDS> words{};
+    for (size_t i = 0; i < INFO_WORDS; ++i)
+        words[i] = src[i].load(std::memory_order_relaxed);
+    std::memcpy(&dst, words.data(), sizeof(PlaneInfo));
 }
 
-XPlaneUdp::XPlaneUdp (const bool autoReConnect) : autoReconnect(autoReConnect),
-                                                  workGuard(asio::make_work_guard(io_context)),
-                                                  worker([this] () { io_context.run(); }) {
-    // 监听信标帧
-    // * 自身地址
-    multicastSocket.open(ip::udp::v4());
-    const asio::socket_base::reuse_address option(true);
-    multicastSocket.set_option(option);
-    // * XPlane广播地址
-    ip::udp::endpoint multicastEndpoint;
-    if constexpr (IS_WIN)
-        multicastEndpoint = ip::udp::endpoint(ip::udp::v4(), MULTI_CAST_PORT);
-    else
-        multicastEndpoint = ip::udp::endpoint(ip::make_address(MULTI_CAST_GROUP), MULTI_CAST_PORT);
-    multicastSocket.bind(multicastEndpoint);
-    // * 加入多播组
-    const ip::address_v4 multicastAddress = ip::make_address_v4(MULTI_CAST_GROUP);
-    multicastSocket.set_option(ip::multicast::join_group(multicastAddress));
-    detectBeacon();
+/**
+ * @brief 写入基本信息 需在 dataLock 写入区内调用
+ * @param src 基本信息
+ * @param dst 按字存储的位置
+ */
+void XPlaneUdp::storeInfo (const PlaneInfo &src, InfoWords &dst) {
+    std::array<uint32_t, INFO_WORDS> words{};
+    std::memcpy(words.data(), &src, sizeof(PlaneInfo));
+    for (size_t i = 0; i < INFO_WORDS; ++i)
+        dst[i].store(words[i], std::memory_order_relaxed);
 }
 
-XPlaneUdp::~XPlaneUdp () {
-    close();
+/**
+ * @brief 设置xp状态 触发回调
+ * @param newState 新状态
+ */
+void XPlaneUdp::setState (const bool newState) {
+    if (newState == state)
+        return;
+    resubscribePending = 0; // 断开时放弃未完成的统计
+    if (newState && autoReconnect) {
+        reconnect();
+        startResubscribe();
+    }
+    state = newState;
+    {
+        std::lock_guard lock(writeMutex);
+        if (publisher)
+            publisher->publishState(newState);
+    }
+    if (newState) { // 重新连接的 XPlane 不一定保留之前写入的值
+        std::lock_guard lock(writeBufferMutex);
+        for (auto &slots : writeSlots | std::views::values) {
+            for (auto &slot : slots)
+                slot.hasSent = false;
+        }
+    }
+    if (newState)
+        wakeAll(connectWaiters, true);
+    if (callback)
+        callback(newState);
 }
 
 /**
- * @brief 设置一个回调函数,xp连接状态改变时会调用
- * @param callbackFunc 回调函数 接受形参bool
+ * @brief 开始统计重新订阅耗时 记录需要再次收到的 dataref 与 RPOS 在 io 线程调用
  */
-void XPlaneUdp::setCallback (const std::function<void  (bool)> &callbackFunc) {
-    callback = callbackFunc;
+void XPlaneUdp::startResubscribe () {
+    resubscribeWaiting.assign(dataRefs.size(), false);
+    resubscribePending = 0;
+    for (size_t i = 0; i < dataRefs.size(); ++i) {
+        if (dataRefs[i].available && dataRefs[i].freq != 0) {
+            resubscribeWaiting[i] = true;
+            ++resubscribePending;
+        }
+    }
+    resubscribeInfo = infoFreq != 0;
+    resubscribePending += resubscribeInfo;
+    resubscribeStart = steadyNanoseconds();
 }
 
 /**
- * @brief 重连
+ * @brief 本包更新的 dataref 或 RPOS 不再等待 全部收到时记录耗时 在 io 线程调用
+ * @param infoUpdated 本包为 RPOS
  */
-void XPlaneUdp::reconnect (const bool del) {
-    // dataref
-    for (auto &[name, start, end, freq, available, isArray] : dataRefs) {
-        if (!available)
-            continue;
-        for (int i = start; i <= end; ++i) {
-            const int32_t sendFreq = del ? 0 : freq;
-            std::string combine = isArray ? std::format("{}[{}]", name, i - start) : name;
-            const size_t size = packSize(0, DATAREF_GET_HEAD, sendFreq, i, combine);
-            auto buffer = BufferPool::getBuffer(size);
-            pack(*buffer, 0, DATAREF_GET_HEAD, sendFreq, i, combine);
-            sendData(buffer, 413);
+void XPlaneUdp::trackResubscribe (const bool infoUpdated) {
+    if (infoUpdated) {
+        if (resubscribeInfo) {
+            resubscribeInfo = false;
+            --resubscribePending;
+        }
+    } else {
+        for (const auto &ref : updatedRefs) {
+            if (ref.getIdx() < resubscribeWaiting.size() && resubscribeWaiting[ref.getIdx()]) {
+                resubscribeWaiting[ref.getIdx()] = false;
+                --resubscribePending;
+            }
         }
     }
-    // 信息
-    if (infoFreq == 0)
-        return;
-    const std::string sentence = std::format("{}{}\x00", BASIC_INFO_HEAD, del ? 0 : infoFreq);
-    const auto buffer2 = BufferPool::getBuffer(sentence.size());
-    pack(*buffer2, 0, sentence);
-    sendData(buffer2, sentence.size());
+    if (resubscribePending == 0) {
+        const auto elapsed = static_cast<uint64_t>(steadyNanoseconds() - resubscribeStart) / 1000;
+        stats.resubscribeTime.record(elapsed);
+        stats.lastResubscribe.store(elapsed, std::memory_order_relaxed);
+    }
 }
 
 /**
- * @brief 停止所有 UDP 接收
+ * @brief 分配一段连续位置 values 容量固定 不会重新分配 不等待隔离中的位置
+ * @param length 长度
+ * @return 起始位置
+ * @throw std::runtime_error 没有足够长的连续空闲位置 有隔离中的位置时可在 SLOT_QUARANTINE 后重试
  */
-void XPlaneUdp::stop () {
-    reconnect(true);
+size_t XPlaneUdp::findSpace (const size_t length) {
+    reclaimSpace();
+    const size_t start = space.allocate(length);
+    if (start == SlotAllocator::NO_SPACE) {
+        size_t quarantined{0};
+        for (const auto &entry : quarantine)
+            quarantined += entry.length;
+        throw std::runtime_error(std::format(
+            "Not enough dataref space: need {}, largest free {}, {} of {} used{}{}", length, space.largestFree(),
+            space.used(), space.capacity(),
+            quarantined != 0 ? std::format(", {} quarantined, retry after {} ms", quarantined, SLOT_QUARANTINE.count())
+                             : "",
+            space.capacity() - space.used() + quarantined >= length ? ", try compactSpace" : ""));
+    }
+    if (start + length > values.size())
+        values.resize(start + length);
+    return start;
 }
 
 /**
- * @brief 彻底关闭 UDP
+ * @brief 释放一段位置 隔离 SLOT_QUARANTINE 后才重新分配
+ *        xp 收到停止或新位置的请求前发出的数据包仍写往旧位置 隔离期内无所属而被丢弃 不会写入其它 dataref
+ * @param start 起点
+ * @param length 长度
  */
-void XPlaneUdp::close () {
-    if (closed.exchange(true))
-        return;
-    if (xpSocket.is_open()) {
-        xpSocket.cancel();
-        xpSocket.close();
-    }
-    multicastSocket.cancel();
-    multicastSocket.close();
-    workGuard.reset();
-    io_context.stop();
-    if (worker.joinable())
-        worker.join();
+void XPlaneUdp::releaseSpace (const size_t start, const size_t length) {
+    quarantine.push_back({start, length, std::chrono::steady_clock::now() + SLOT_QUARANTINE});
 }
 
 /**
- * @brief 新增监听目标
- * @param dataref dataref 名称
- * @param freq 频率
- * @param index 目标为数组时的索引
+ * @brief 取回仍在隔离中的一段位置 供原 dataref 恢复时使用 其中迟到的数据包本就属于该 dataref
+ * @return 是否在隔离中
  */
-XPlaneUdp::DatarefIndex XPlaneUdp::addDataref (const std::string &dataref, int32_t freq, int index) {
-    std::string name = (index == -1) ? dataref : std::format("{}[{}]", dataref, index);
-    if (const auto it = exist.find(name); it != exist.end()) {
-        std::cerr << "already exist! nothing change.";
-        return DatarefIndex{it->second};
-    }
-    size_t start = findSpace(1);
-    dataRefs.emplace_back(name, start, start, freq, true, false);
-    const size_t size = packSize(0, DATAREF_GET_HEAD, freq, start, name);
-    const auto buffer = BufferPool::getBuffer(size);
-    pack(*buffer, 0, DATAREF_GET_HEAD, freq, start, name);
-    sendData(buffer, 413);
-    exist[name] = dataRefs.size() - 1;
-    return DatarefIndex{dataRefs.size() - 1};
+bool XPlaneUdp::takeQuarantined (const size_t start, const size_t length) {
+    const auto it = std::ranges::find_if(quarantine, [&](const Quarantined &entry) {
+        return entry.start == start && entry.length == length;
+    });
+    if (it == quarantine.end())
+        return false;
+    quarantine.erase(it);
+    return true;
 }
 
 /**
- * @brief 新增监听目标,目标为数组
- * @param dataref dataref 名称
- * @param length 数组长度
- * @param freq 频率
+ * @brief 把隔离期已过的位置交还分配器
  */
-XPlaneUdp::DatarefIndex XPlaneUdp::addDatarefArray (const std::string &dataref, const int length, int32_t freq) {
-    if (const auto it = exist.find(dataref); it != exist.end()) {
-        std::cerr << "already exist! nothing change.";
-        return DatarefIndex{it->second};
-    }
-    int start = static_cast<int>(findSpace(length));
-    dataRefs.emplace_back(dataref, start, start + length - 1, freq, true, true);
-    for (int i = 0; i < length; ++i) {
-        std::string name = std::format("{}[{}]", dataref, i);
-        const size_t size{packSize(0, DATAREF_GET_HEAD, freq, start + i, name)};
-        auto buffer = BufferPool::getBuffer(size);
-        pack(*buffer, 0, DATAREF_GET_HEAD, freq, start + i, name);
-        sendData(buffer, 413);
+void XPlaneUdp::reclaimSpace () {
+    const auto now = std::chrono::steady_clock::now();
+    while (!quarantine.empty() && quarantine.front().until <= now) {
+        space.release(quarantine.front().start, quarantine.front().length);
+        quarantine.pop_front();
     }
-    exist[dataref] = dataRefs.size() - 1;
-    return DatarefIndex{dataRefs.size() - 1};
 }
 
 /**
- * @brief 获取 dataref 最新值
- * @param dataref 标识
- * @param value 返回值
- * @param defaultValue 默认值
- * @return 值可用
+ * @brief 在一个读取区内读取 dataref 的位置 起点与终点一致
  */
-bool XPlaneUdp::getDataref (const DatarefIndex &dataref, float &value, const float defaultValue) const {
-    if (!dataRefs.at(dataref.getIdx()).available) {
-        value = defaultValue;
-        return false;
+XPlaneUdp::Placement XPlaneUdp::placement (const DatarefInfo &ref) const {
+    Placement place;
+    dataLock.read([&] { place = {ref.start, ref.end, ref.available}; });
+    return place;
+}
+
+/**
+ * @brief 整理 values 中的位置 由高到低把单独订阅的 dataref 移入更低且足够长的空闲位置 合并零碎的空闲区间
+ *        移动的 dataref 先以频率 0 停止原位置 再订阅新位置 已有的值与时间一并移动
+ *        原位置隔离 SLOT_QUARANTINE 后才重新分配 (见 releaseSpace) 因此只移入调用时已空闲的位置
+ *        腾出的高处位置在隔离期后与末尾的空闲区间合并 通常一次即可 schema 字段位置固定 不移动
+ *        O(dataref 数 x 空闲区间数) 记录时间序列时不整理
+ * @return 移动的 dataref 数
+ */
+size_t XPlaneUdp::compactSpace () {
+    {
+        std::lock_guard lock(recordMutex);
+        if (seriesWriter)
+            return 0;
     }
-    std::shared_lock lock(dataMutex);
-    value = values.at(dataRefs.at(dataref.getIdx()).start);
-    return true;
+    std::vector<size_t> order;
+    for (size_t i = 0; i < dataRefs.size(); ++i) {
+        if (dataRefs[i].available && dataRefs[i].schema < 0)
+            order.push_back(i);
+    }
+    std::ranges::sort(order, std::ranges::greater{}, [this](const size_t i) { return dataRefs[i].start.load(); });
+    reclaimSpace();
+    size_t moved{0};
+    for (const size_t i : order) {
+        auto &ref = dataRefs[i];
+        const size_t size = static_cast<size_t>(ref.end - ref.start + 1);
+        const size_t lowest = space.allocateLowest(size); // 不与原位置重叠 旧位置的数据包不会落入新位置
+        if (lowest == SlotAllocator::NO_SPACE)
+            continue;
+        const auto start = static_cast<int>(lowest);
+        if (start > ref.start) { // 只剩更高的空闲位置
+            space.release(lowest, size);
+            continue;
+        }
+        const auto previous = static_cast<size_t>(ref.start);
+        queueRequests(ref.requests, true);
+        moveSlots(i, start);
+        releaseSpace(previous, size);
+        for (size_t j = 0; j < size; ++j) {
+            auto packet = ref.requests.at(j);
+            pack(packet, HEADER_LENGTH + 4, int32_t{start + static_cast<int32_t>(j)});
+        }
+        queueRequests(ref.requests, false);
+        ++moved;
+    }
+    flushData();
+    return moved;
 }
 
 /**
- * @brief 修改获取 dataref 的频率
- * @param dataref 标识
- * @param freq 频率
+ * @brief 把 dataref 的值、时间与归属移到新位置 与原位置不重叠
+ *        读者在同一读取区内读取位置与值 只会读到移动前或移动后的整体
+ * @param refIndex dataRefs 下标
+ * @param start 新起点
  */
-void XPlaneUdp::changeDatarefFreq (const DatarefIndex &dataref, const float freq) {
-    auto &ref = dataRefs.at(dataref.getIdx());
+void XPlaneUdp::moveSlots (const size_t refIndex, const int start) {
+    auto &ref = dataRefs[refIndex];
+    const int previous = ref.start;
     const int size = ref.end - ref.start + 1;
-    if (freq == 0) { // 停止接收
-        if (!ref.available)
-            return;
-        ref.available = false;
-        space.set(ref.start, size, false);
-    } else {
-        // 先恢复
-        if (!ref.available) {
-            ref.available = true;
-            const int start = static_cast<int>(findSpace(size));
-            ref.start = start;
-            ref.end = start + size - 1;
-        }
-        // 再发送
-        if (!ref.isArray) {
-            const size_t bufferSize = packSize(0, DATAREF_GET_HEAD, freq, ref.start, ref.name);
-            const auto buffer = BufferPool::getBuffer(bufferSize);
-            pack(*buffer, 0, DATAREF_GET_HEAD, freq, ref.start, ref.name);
-            sendData(buffer, 413);
-        } else {
-            for (size_t i = 0; i < size; ++i) {
-                const size_t bufferSize = packSize(0, DATAREF_GET_HEAD, freq, ref.start,
-                                                   std::format("{}[{}]", ref.name, i));
-                const auto buffer = BufferPool::getBuffer(bufferSize);
-                pack(*buffer, 0, DATAREF_GET_HEAD, freq, ref.start + i, std::format("{}[{}]", ref.name, i));
-                sendData(buffer, 413);
-            }
+    std::lock_guard lock(writeMutex);
+    dataLock.write([&] {
+        for (int i = 0; i < size; ++i) {
+            values.set(static_cast<size_t>(start + i), values.get(static_cast<size_t>(previous + i)));
+            slotTimes[start + i].store(slotTimes[previous + i].load(std::memory_order_relaxed),
+                                       std::memory_order_relaxed);
+            slotTimes[previous + i].store(FREE_STAMP, std::memory_order_relaxed);
+            slotOwner[previous + i] = -1;
+            slotOwner[start + i] = static_cast<int32_t>(refIndex);
         }
-    }
+        ref.start = start;
+        ref.end = start + size - 1;
+        ref.placed = (dataLock.version() + 1) / 2;
+    });
+    bindOwner(refIndex, true);
 }
 
 /**
- * @brief 设置dataref值
- * @param dataref dataref 名称
- * @param value 值
- * @param index 目标为数组时的索引
+ * @return values 位置、名称与预先打包请求的占用
  */
-void XPlaneUdp::setDataref (const std::string &dataref, const float value, int index) {
-    const std::string name = (index == -1) ? dataref : std::format("{}[{}]", dataref, index);
-    const size_t bufferSize = packSize(0, DATAREF_SET_HEAD, value, name, '\x00');
-    const auto buffer = BufferPool::getBuffer(bufferSize);
-    pack(*buffer, 0, DATAREF_SET_HEAD, value, name, '\x00');
-    sendData(buffer, 509);
+XPlaneUdp::SpaceReport XPlaneUdp::getSpaceReport () const {
+    SpaceReport report{};
+    report.capacity = space.capacity();
+    report.used = space.used();
+    report.end = space.end();
+    report.largestFree = space.largestFree();
+    report.freeExtents = space.freeExtents();
+    for (const auto &entry : quarantine)
+        report.quarantined += entry.length;
+    report.refs = dataRefs.size();
+    report.nameBytes = names.bytes();
+    for (size_t i = 0; i < dataRefs.size(); ++i)
+        report.requestBytes += dataRefs[i].requests.bytes.capacity();
+    return report;
 }
 
 /**
- * @brief 开始接收基本信息
- * @param freq 接收频率
+ * @brief 记录 values 中位置所属的 dataref 用于更新通知
+ *        绑定时清零值并标记为 NEVER 新分配的位置尚未收到 不能把之前留下的值当作新值
+ * @param refIndex dataRefs 下标
+ * @param bind 绑定或解绑
  */
-void XPlaneUdp::addPlaneInfo (int freq) {
-    infoFreq = freq;
-    const std::string sentence = std::format("{}{}\x00", BASIC_INFO_HEAD, freq);
-    const size_t bufferSize = packSize(0, sentence);
-    const auto buffer = BufferPool::getBuffer(bufferSize);
-    pack(*buffer, 0, sentence);
-    sendData(buffer, bufferSize);
+void XPlaneUdp::bindSlots (const size_t refIndex, const bool bind) {
+    auto &ref = dataRefs[refIndex];
+    std::lock_guard lock(writeMutex);
+    dataLock.write([&] {
+        for (int i = ref.start; i <= ref.end; ++i) {
+            if (bind)
+                values.set(static_cast<size_t>(i), 0);
+            slotTimes[i].store(bind ? NEVER_STAMP : FREE_STAMP, std::memory_order_relaxed);
+            slotOwner[i] = bind ? static_cast<int32_t>(refIndex) : -1;
+        }
+        ref.available = bind;
+        ref.placed = (dataLock.version() + 1) / 2;
+    });
+    bindOwner(refIndex, bind);
 }
 
 /**
- * @brief 获取基本信息最新值
+ * @brief 位置归属已在写入区内更新后 更新历史记录与共享内存中的位置 调用方持有 writeMutex
+ * @param refIndex dataRefs 下标
+ * @param bind 绑定或解绑
  */
-void XPlaneUdp::getPlaneInfo (PlaneInfo &infoDst) const {
-    std::shared_lock lock(dataMutex);
-    infoDst = info;
+void XPlaneUdp::bindOwner (const size_t refIndex, const bool bind) {
+    const auto &ref = dataRefs[refIndex];
+    if (refStamp.size() < dataRefs.size())
+        refStamp.resize(dataRefs.size(), 0);
+    growHistory();
+    reserveReadCounts(dataRefs.size()); // 新订阅的读取从一开始计入
+    if (HistoryRing *target = history[refIndex].load(std::memory_order_relaxed)) // 恢复订阅后位置可能改变
+        target->rebind(ref.start);
+    if (publisher)
+        publisher->publishRef(refIndex, ref.name, bind ? ref.start.load() : -1, ref.end);
 }
 
 /**
- * @brief 设置xp状态 触发回调
- * @param newState 新状态
+ * @brief 通知本包的更新 回调与等待者 在 io 线程 数据写入后调用
+ * @param infoUpdated 基本信息是否更新
+ * @param arrival 数据包到达时刻 steady ns
  */
-void XPlaneUdp::setState (const bool newState) {
-    if (newState == state)
+void XPlaneUdp::notifyUpdate (const bool infoUpdated, const int64_t arrival) {
+    if (series.writer)
+        recordSeries(infoUpdated, arrival);
+    if (updateCallback)
+        updateCallback(updatedRefs, infoUpdated);
+    if (!updateWaiters.empty())
+        wakeUpdateWaiters(infoUpdated);
+    if (waiters == 0)
         return;
-    if (newState && autoReconnect)
-        reconnect();
-    state = newState;
-    if (callback)
-        callback(newState);
+    {
+        std::lock_guard lock(notifyMutex);
+        for (const auto &ref : updatedRefs) {
+            if (ref.getIdx() < refGeneration.size())
+                ++refGeneration[ref.getIdx()];
+        }
+        if (infoUpdated)
+            ++infoGeneration;
+    }
+    notifyCond.notify_all();
 }
 
 /**
- * @brief 找到一段连续可用的空间
- * @param length 长度
- * @return 起始位置
+ * @brief 本包更新了记录的 dataref 或基本信息时记录一行 在 io 线程调用 值不会被其它线程改写 无需加锁
+ * @param infoUpdated 基本信息是否更新
+ * @param arrival 数据包到达时刻 steady ns 即行时间
  */
-size_t XPlaneUdp::findSpace (const size_t length) {
-    const size_t currentSize = space.size();
-    // 尝试在现有空间中寻找
-    if (currentSize >= length) {
-        size_t i = 0;
-        const size_t searchLimit = currentSize - length;
-        while (i <= searchLimit) {
-            size_t j;
-            for (j = 0; j < length; ++j) {
-                if (space.test(i + j))
-                    break;
-            }
-            if (j == length) {
-                space.set(i, length, true);
-                return i;
-            }
-            i += j + 1;
-        }
+void XPlaneUdp::recordSeries (const bool infoUpdated, const int64_t arrival) {
+    const bool hit = infoUpdated ? series.info : std::ranges::any_of(updatedRefs, [this](const DatarefIndex &ref) {
+        return ref.getIdx() < series.refs.size() && series.refs[ref.getIdx()];
+    });
+    if (!hit)
+        return;
+    SeriesWriter &writer = *series.writer;
+    series.lastTime = std::max(series.lastTime, arrival);
+    writer.begin(series.lastTime);
+    for (const auto &[start, end] : series.slots) {
+        for (size_t i = start; i <= end; ++i)
+            writer.write(values.get(i));
+    }
+    if (series.info) {
+        PlaneInfo plane{};
+        loadInfo(info, plane);
+        writer.write(plane.lon);
+        writer.write(plane.lat);
+        writer.write(plane.alt);
+        for (const float value : {plane.agl, plane.pitch, plane.track, plane.roll, plane.vX, plane.vY, plane.vZ,
+                                  plane.rollRate, plane.pitchRate, plane.yawRate})
+            writer.write(value);
     }
-    // 再次尝试分配一块空间
-    const size_t newStart = currentSize;
-    space.resize(currentSize + length, false);
-    space.set(newStart, length, true);
-    // 预留values
-    std::unique_lock lock(dataMutex);
-    values.resize(space.size());
-    return newStart;
+    writer.end();
 }
 
 /**
  * @brief 监听XPlane是否在线
  */
 void XPlaneUdp::detectBeacon () {
-    asio::co_spawn(io_context, detect(), asio::detached);
+    spawn(detect());
 }
 
 asio::awaitable<void> XPlaneUdp::detect () {
     ip::udp::endpoint senderEndpoint;
-    asio::steady_timer timer(co_await asio::this_coro::executor);
+    armBeaconTimer();
     while (true) {
-        auto buffer = BufferPool::getBuffer(0);
-        timer.expires_after(std::chrono::seconds(2));
-        timer.async_wait([this](const auto &ec) { if (!ec)setState(false); });
-        size_t receiveBytes = co_await multicastSocket.async_receive_from(
-            asio::buffer(*buffer), senderEndpoint, asio::use_awaitable);
-        receiveDataProcess(buffer, receiveBytes, senderEndpoint);
-        timer.cancel();
+        co_await multicastSocket.async_wait(ip::udp::socket::wait_read, asio::use_awaitable);
+        int64_t arrival{0};
+        while (const size_t receiveBytes = receiveStamped(multicastSocket, beaconBuffer, senderEndpoint, arrival))
+            handleBeacon(std::span<const char>(beaconBuffer.data(), receiveBytes), senderEndpoint, arrival);
     }
 }
 
+/**
+ * @brief 转交其它 socket 收到的本 XPlane 信标 用于外部上下文的实例 可在任意线程调用 关闭后不应再调用
+ * @param data 信标
+ * @param sender 发送方
+ */
+void XPlaneUdp::receiveBeacon (const std::span<const char> data, const ip::udp::endpoint &sender) {
+    if (closed)
+        return;
+    tasks.fetch_add(1, std::memory_order_relaxed);
+    asio::post(strand, [this, beacon = std::vector<char>(data.begin(), data.end()), sender,
+                        arrival = steadyNanoseconds()] {
+        if (!closed)
+            handleBeacon(beacon, sender, arrival);
+        tasks.fetch_sub(1, std::memory_order_release);
+    });
+}
+
+/**
+ * @brief 处理一个信标 在 io 线程调用
+ * @param arrival 到达时间 steady ns
+ */
+void XPlaneUdp::handleBeacon (const std::span<const char> beacon, const ip::udp::endpoint &sender,
+                              const int64_t arrival) {
+    if (recording)
+        recording->push(beacon, sender, PacketRecord::BEACON, arrival);
+    if (!replaying) // 回放期间连接状态只由日志中的信标决定
+        receiveDataProcess(beacon, sender, arrival);
+}
+
+/**
+ * @brief 超时未收到下一个主机信标时断开 重新设置会取消上一次等待
+ */
+void XPlaneUdp::armBeaconTimer () {
+    beaconTimer.expires_after(BEACON_TIMEOUT);
+    beaconTimer.async_wait([this](const sys::error_code &ec) {
+        if (!ec && !replaying)
+            setState(false);
+    });
+}
+
+/**
+ * @brief 在 io 线程启动协程 计入 tasks 共享上下文关闭时据此等待
+ */
+void XPlaneUdp::spawn (asio::awaitable<void> task) {
+    tasks.fetch_add(1, std::memory_order_relaxed);
+    asio::co_spawn(strand, std::move(task), [this](const std::exception_ptr &) {
+        tasks.fetch_sub(1, std::memory_order_release);
+    });
+}
+
 /**
  * @brief 向xp发送udp数据
  * @param data 数据
  * @param size
  */
-void XPlaneUdp::sendData (const std::shared_ptr<std::array<char, 1472>> &data, const size_t size) {
-    if (!xpSocket.is_open())
+void XPlaneUdp::sendData (const BufferPool::Buffer &data, const size_t size) {
+    queueData(data, size);
+    flushData();
+}
+
+/**
+ * @brief 加入发送队列 需调用 flushData 才会发送
+ * @param data 数据
+ * @param size 长度
+ */
+void XPlaneUdp::queueData (const BufferPool::Buffer &data, const size_t size) {
+    if (!xpOpen.load(std::memory_order_acquire))
+        return;
+    std::lock_guard lock(sendMutex);
+    sendQueue.emplace_back(data, size);
+    stats.sendQueued.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 发送队列中的全部数据 同一时间只有一个发送者
+ *        发送协程在 io 线程运行 xpEndpoint 与 xpSocket 只在 io 线程访问 已有发送者时由它一并发送
+ */
+void XPlaneUdp::flushData () {
+    if (!xpOpen.load(std::memory_order_acquire))
         return;
-    asio::co_spawn(io_context, send(data, size), asio::detached);
+    if (!sendScheduled.exchange(true))
+        spawn(sendBatch());
+}
+
+/**
+ * @brief 发送 sending 与 sendQueue 中的数据 直到队列为空或发送缓冲区已满
+ * @return true 队列已空 不再是发送者, false 需等待可写后再次调用
+ */
+bool XPlaneUdp::drainSend () {
+    while (true) {
+        if (sendOffset == sending.size()) {
+            stats.sendInFlight.store(0, std::memory_order_relaxed);
+            sending.clear();
+            sendOffset = 0;
+            std::lock_guard lock(sendMutex);
+            if (sendQueue.empty()) {
+                sendScheduled = false;
+                if (flushPending) {
+                    tasks.fetch_add(1, std::memory_order_relaxed);
+                    asio::post(strand, [this] {
+                        wakeFlushWaiters();
+                        tasks.fetch_sub(1, std::memory_order_release);
+                    });
+                }
+                return true;
+            }
+            sending.swap(sendQueue);
+            const auto batch = static_cast<int64_t>(sending.size());
+            stats.sendQueued.fetch_sub(batch, std::memory_order_relaxed);
+            stats.sendInFlight.fetch_add(batch, std::memory_order_relaxed);
+        }
+        const size_t sent = sendMany(sendOffset);
+        if (sent == 0)
+            return false;
+        for (size_t i = sendOffset; i < sendOffset + sent; ++i) {
+            const auto type = packetType(std::span<const char>(*sending[i].data));
+            XPlaneStats::bump(stats.packetsSent[type]);
+            XPlaneStats::bump(stats.bytesSent[type], sending[i].size);
+        }
+        stats.sendInFlight.fetch_sub(static_cast<int64_t>(sent), std::memory_order_relaxed);
+        sendOffset += sent;
+    }
+}
+
+asio::awaitable<void> XPlaneUdp::sendBatch () {
+    sys::error_code ec;
+    while (!drainSend()) {
+        // 发送缓冲区已满 等待可写
+        co_await xpSocket.async_wait(ip::udp::socket::wait_write, asio::redirect_error(asio::use_awaitable, ec));
+        if (ec) // 放弃当前这批
+            sendOffset = sending.size();
+    }
+}
+
+/**
+ * @brief 从 sending[offset] 开始一次系统调用发送多个数据包
+ * @param offset 起始位置
+ * @return 已处理的数据包数量, 0 表示需等待可写
+ */
+size_t XPlaneUdp::sendMany (const size_t offset) {
+#ifdef __linux__
+    std::array<mmsghdr, SEND_BATCH> msgs{};
+    std::array<iovec, SEND_BATCH> iovs{};
+    const size_t count = std::min(SEND_BATCH, sending.size() - offset);
+    for (size_t i = 0; i < count; ++i) {
+        const auto &[data, size] = sending[offset + i];
+        iovs[i].iov_base = data->data();
+        iovs[i].iov_len = size;
+        msgs[i].msg_hdr.msg_name = xpEndpoint.data();
+        msgs[i].msg_hdr.msg_namelen = static_cast<socklen_t>(xpEndpoint.size());
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    const int sent = ::sendmmsg(xpSocket.native_handle(), msgs.data(), static_cast<unsigned>(count), MSG_DONTWAIT);
+    if (sent > 0)
+        return static_cast<size_t>(sent);
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        return 0;
+    return 1; // 首个数据包发送失败 丢弃
+#else
+    sys::error_code ec;
+    const auto &[data, size] = sending[offset];
+    xpSocket.non_blocking(true, ec);
+    xpSocket.send_to(asio::buffer(*data, size), xpEndpoint, 0, ec);
+    return ec == asio::error::would_block ? 0 : 1;
+#endif
+}
+
+/**
+ * @brief 启用忙轮询接收 接收协程取不到数据包时只让出一次 不等待 epoll 唤醒 解码仍在接收处直接进行
+ *        io 线程会占满一个核 其它操作照常在让出时执行; 默认不启用
+ *        绑定核与 SCHED_FIFO 只作用于自有 io 线程 外部执行器的线程由调用者设置
+ *        单核或与发送方共用核时 SCHED_FIFO 的自旋线程会饿死其它线程
+ * @param options 绑定的核 优先级 SO_BUSY_POLL
+ * @return 各项是否生效 权限不足时对应项为 false
+ */
+XPlaneUdp::BusyPollReport XPlaneUdp::enableBusyPoll (const BusyPollOptions &options) {
+    BusyPollReport report{};
+    runInIo([this, &options, &report] {
+        socketBusyPoll = options.socketBusyPoll;
+        report.socketBusyPoll = options.socketBusyPoll > 0 && setSocketBusyPoll(xpSocket, options.socketBusyPoll);
+        if (ownContext) {
+            report.pinned = options.cpu >= 0 && pinCurrentThread(options.cpu);
+            report.realtime = options.fifoPriority > 0 && setCurrentThreadPriority(options.fifoPriority);
+        }
+    });
+    spinning = true;
+    report.spinning = true;
+    return report;
 }
 
-asio::awaitable<void> XPlaneUdp::send (const std::shared_ptr<std::array<char, 1472>> data, const size_t size) {
-    // 协程 多么好的一件美事啊，sendData执行完代码就退出了，留着send慢慢等待调度发送
-    co_await xpSocket.async_send_to(asio::buffer(*data, size), xpEndpoint, asio::use_awaitable);
+/**
+ * @brief 恢复等待可读 自有 io 线程恢复为不绑定核的普通调度
+ */
+void XPlaneUdp::disableBusyPoll () {
+    spinning = false;
+    runInIo([this] {
+        if (socketBusyPoll > 0)
+            setSocketBusyPoll(xpSocket, 0);
+        socketBusyPoll = 0;
+        if (ownContext) {
+            pinCurrentThread(-1);
+            setCurrentThreadPriority(0);
+        }
+    });
+}
+
+/**
+ * @brief 开关内核接收时间戳 (SO_TIMESTAMPNS) 作用于 xpSocket 与 multicastSocket 之后打开的 socket 同样设置
+ *        启用后数据包的到达时间为内核收到的时刻 换算到 steady_clock 后用于历史、基本信息外推、共享内存与记录
+ *        getStats() 的 kernelQueueTime 为在内核中排队的时间 kernelToVisible 为到解码完成值可读的时间
+ * @return 已打开的 socket 是否都设置成功 非 Linux 不支持
+ */
+bool XPlaneUdp::enableKernelTimestamps (const bool enable) {
+    bool result{true};
+    runInIo([this, enable, &result] {
+        kernelTimestamps = enable;
+        for (auto *socket : {&xpSocket, &multicastSocket}) {
+            if (socket->is_open())
+                result = setSocketTimestamps(*socket, enable) && result;
+        }
+    });
+    return result;
 }
 
 /**
  * @brief 接收数据
  */
 void XPlaneUdp::receiveData () {
-    asio::co_spawn(io_context, receive(), asio::detached);
+    spawn(receive());
 }
 
 asio::awaitable<void> XPlaneUdp::receive () {
-    ip::udp::endpoint temp;
+    sys::error_code ec;
     while (xpSocket.is_open()) {
-        auto buffer = BufferPool::getBuffer(0);
-        size_t receiveBytes = co_await xpSocket.async_receive_from(
-            asio::buffer(*buffer), temp, asio::use_awaitable);
-        receiveDataProcess(buffer, receiveBytes, temp);
+        // 先直接读取 取尽全部数据包后才等待就绪
+        const size_t count = receiveMany();
+        if (recording && count != 0) {
+            for (size_t i = 0; i < count; ++i)
+                recording->push(std::span(ring->buffers[i].data(), ring->lengths[i]), ring->senders[i],
+                                PacketRecord::XPLANE, ring->arrivals[i]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            receiveDataProcess(std::span(ring->buffers[i].data(), ring->lengths[i]), ring->senders[i],
+                               ring->arrivals[i]);
+            if (ring->stamped[i] && stats.enabled.load(std::memory_order_relaxed))
+                stats.kernelToVisible.record(static_cast<uint64_t>(std::max<int64_t>(
+                    0, steadyNanoseconds() - ring->arrivals[i])));
+        }
+        if (count != 0)
+            continue;
+        if (spinning.load(std::memory_order_relaxed)) { // 忙轮询 让出一次 队列非空时 epoll 不阻塞
+            co_await asio::post(strand, asio::use_awaitable);
+            continue;
+        }
+        co_await xpSocket.async_wait(ip::udp::socket::wait_read, asio::redirect_error(asio::use_awaitable, ec));
+        if (ec)
+            co_return;
     }
 }
 
-bool compareHead (const std::string &templateHead, const std::array<char, 1472> &data) {
-    return std::ranges::equal(templateHead | std::views::take(4), data | std::views::take(4));
+/**
+ * @brief 一次系统调用读取多个已到达的数据包到接收环
+ * @return 数据包数量
+ */
+size_t XPlaneUdp::receiveMany () {
+#ifdef __linux__
+    for (size_t i = 0; i < RECV_BATCH; ++i) {
+        ring->msgs[i].msg_hdr.msg_name = ring->senders[i].data();
+        ring->msgs[i].msg_hdr.msg_namelen = static_cast<socklen_t>(ring->senders[i].capacity());
+        // 内核会改写 controllen 每次重新设置
+        ring->msgs[i].msg_hdr.msg_control = kernelTimestamps ? ring->controls[i].data() : nullptr;
+        ring->msgs[i].msg_hdr.msg_controllen = kernelTimestamps ? CONTROL_BYTES : 0;
+    }
+    const int count = ::recvmmsg(xpSocket.native_handle(), ring->msgs.data(), RECV_BATCH, MSG_DONTWAIT, nullptr);
+    if (count <= 0)
+        return 0;
+    const int64_t now = steadyNanoseconds();
+    // 内核时间为 CLOCK_REALTIME 每批取一次与 steady 的差换算
+    const int64_t offset = kernelTimestamps ? now - realtimeNanoseconds() : 0;
+    const bool measure = stats.enabled.load(std::memory_order_relaxed);
+    for (int i = 0; i < count; ++i) {
+        ring->senders[i].resize(ring->msgs[i].msg_hdr.msg_namelen);
+        ring->lengths[i] = ring->msgs[i].msg_len;
+        const int64_t kernel = kernelTimestamps ? kernelTime(ring->msgs[i].msg_hdr) : 0;
+        ring->stamped[i] = kernel != 0;
+        ring->arrivals[i] = kernel != 0 ? kernel + offset : now;
+        if (kernel != 0 && measure)
+            stats.kernelQueueTime.record(static_cast<uint64_t>(std::max<int64_t>(0, now - ring->arrivals[i])));
+    }
+    return static_cast<size_t>(count);
+#else
+    size_t count = 0;
+    sys::error_code ec;
+    xpSocket.non_blocking(true, ec);
+    while (count < RECV_BATCH) {
+        ring->lengths[count] = xpSocket.receive_from(asio::buffer(ring->buffers[count]), ring->senders[count], 0, ec);
+        if (ec)
+            break;
+        ring->arrivals[count] = steadyNanoseconds();
+        ring->stamped[count] = false;
+        ++count;
+    }
+    return count;
+#endif
 }
 
-void XPlaneUdp::receiveDataProcess (const std::shared_ptr<std::array<char, 1472>> &data, const size_t size,
-                                    const ip::udp::endpoint &sender) {
-    if (size <= HEADER_LENGTH) // 头部大小
+/**
+ * @brief 解码一个数据包 数据直接读取自接收缓冲
+ * @param data 数据包
+ * @param sender 发送方
+ * @param arrival 到达时间 steady ns 写入历史、基本信息与共享内存的时间
+ */
+void XPlaneUdp::receiveDataProcess (const std::span<const char> data, const ip::udp::endpoint &sender,
+                                    const int64_t arrival) {
+    if (data.size() <= HEADER_LENGTH) { // 头部大小
+        XPlaneStats::bump(stats.malformed);
         return;
-    if (compareHead(DATAREF_GET_HEAD, *data)) { // dataref
-        if ((size - 5) % 8 != 0)
-            return;
-        std::unique_lock lock(dataMutex);
-        for (int i = HEADER_LENGTH; i < size; i += 8) {
-            int index;
-            float value;
-            unpack(*data, i, index, value);
-            if (index < 0)
-                continue;
-            const auto uindex = static_cast<size_t>(index);
-            if (uindex >= values.size())
-                continue;
-            values[uindex] = value;
-        }
-    } else if (compareHead(BASIC_INFO_HEAD, *data)) { // 基本信息
-        std::unique_lock lock(dataMutex);
-        unpack(*data, HEADER_LENGTH, info);
-    } else if (compareHead(BECON_HEAD, *data)) { // 信标
-        if (!xpSocket.is_open()) { // 第一次听见信标
-            uint8_t mainVer, minorVer;
-            int32_t software, xpVer;
-            uint32_t role;
-            uint16_t port;
-            unpack(*data, HEADER_LENGTH, mainVer, minorVer, software, xpVer, role, port);
-            xpEndpoint = ip::udp::endpoint(ip::make_address(sender.address().to_string()), port);
-            const ip::udp::endpoint local(ip::udp::v4(), 0);
-            xpSocket.open(local.protocol());
-            xpSocket.bind(local);
-            receiveData();
-        }
-        setState(true);
-    }
-    // 手动擦除数据
-    std::memset(data->data(), 0x00, size);
+    }
+    const auto type = packetType(data);
+    const bool measure = stats.enabled.load(std::memory_order_relaxed);
+    int64_t begin{0};
+    if (measure) {
+        begin = steadyNanoseconds();
+        XPlaneStats::bump(stats.packetsReceived[type]);
+        XPlaneStats::bump(stats.bytesReceived[type], data.size());
+        if (stats.lastArrival[type] != 0)
+            stats.interArrival[type].record(std::max<int64_t>(0, arrival - stats.lastArrival[type]) / 1000);
+        stats.lastArrival[type] = arrival;
+    }
+    bool valid = true;
+    switch (type) {
+        case XPlaneStats::RREF:
+            valid = processDataref(data, arrival);
+            break;
+        case XPlaneStats::RPOS:
+            valid = processPlaneInfo(data, arrival);
+            break;
+        case XPlaneStats::DATA:
+            valid = processDataGroups(data, arrival);
+            break;
+        case XPlaneStats::BECN:
+            valid = processBeacon(data, sender);
+            break;
+        default:
+            break;
+    }
+    if (!valid)
+        XPlaneStats::bump(stats.malformed);
+    if (measure)
+        stats.decodeTime.record(steadyNanoseconds() - begin);
+}
+
+/**
+ * @brief 解码 RREF 写入 values 并通知
+ * @param arrival 到达时间 steady ns
+ * @return 数据包是否合法
+ */
+bool XPlaneUdp::processDataref (const std::span<const char> data, const int64_t arrival) {
+    const size_t size = data.size();
+    if ((size - HEADER_LENGTH) % 8 != 0)
+        return false;
+    updatedRefs.clear();
+    const size_t pairs = std::min((size - HEADER_LENGTH) / 8, RrefDecoder::MAX_PAIRS);
+    size_t outOfRange{0};
+    {
+        std::lock_guard lock(writeMutex);
+        // 先拆分并校验 写入区内只剩写入与去重
+        const size_t count = decodeKernel(data.data() + HEADER_LENGTH, pairs, static_cast<uint32_t>(values.size()),
+                                          ring->indices.data(), ring->decoded.data());
+        outOfRange = pairs - count;
+        const uint64_t stamp = ++packetCount;
+        const uint32_t received = toStamp(arrival);
+        dataLock.write([&] {
+            for (size_t i = 0; i < count; ++i) {
+                const auto index = static_cast<size_t>(ring->indices[i]);
+                values.set(index, ring->decoded[i]);
+                const int32_t owner = slotOwner[index];
+                if (owner < 0) // 停止接收后 xp 仍可能发来 空闲位置不记录时间
+                    continue;
+                slotTimes[index].store(received, std::memory_order_relaxed);
+                // 同一数据包内每个 dataref 只记录一次
+                if (refStamp[owner] != stamp) {
+                    refStamp[owner] = stamp;
+                    updatedRefs.emplace_back(static_cast<size_t>(owner));
+                }
+            }
+            if (historyRefs != 0) {
+                for (const auto &ref : updatedRefs) {
+                    if (HistoryRing *target = history[ref.getIdx()].load(std::memory_order_relaxed))
+                        target->push(arrival, values);
+                }
+            }
+        });
+        if (publisher)
+            publisher->publishValues(std::span(ring->indices.data(), count), std::span(ring->decoded.data(), count),
+                                     arrival);
+    }
+    if (outOfRange != 0)
+        XPlaneStats::bump(stats.outOfRange, outOfRange);
+    if (resubscribePending != 0)
+        trackResubscribe(false);
+    notifyUpdate(false, arrival);
+    return true;
+}
+
+/**
+ * @brief 解码 RPOS 写入基本信息并通知
+ * @param arrival 到达时间 steady ns
+ * @return 数据包是否合法
+ */
+bool XPlaneUdp::processPlaneInfo (const std::span<const char> data, const int64_t arrival) {
+    if (data.size() < HEADER_LENGTH + sizeof(PlaneInfo))
+        return false;
+    PlaneInfo newInfo{};
+    unpack(data, HEADER_LENGTH, newInfo);
+    const int64_t now = arrival;
+    // 仅 io 线程写入 无需在读取区内读取
+    PlaneInfo last{}, previous{};
+    loadInfo(info, last);
+    loadInfo(previousInfo, previous);
+    const int64_t lastTime = infoTime.load(std::memory_order_relaxed);
+    const int64_t previousTime = previousInfoTime.load(std::memory_order_relaxed);
+    if (lastTime != 0 && now - lastTime <= PREDICT_LIMIT && stats.enabled.load(std::memory_order_relaxed)) {
+        // 上一次外推到本包到达时刻 与本包比较
+        const PlaneInfo predicted = extrapolate(last, previous, lastTime - previousTime, now - lastTime);
+        stats.predictError.record(static_cast<uint64_t>(positionError(predicted, newInfo) * 1000));
+        stats.holdError.record(static_cast<uint64_t>(positionError(last, newInfo) * 1000));
+        stats.attitudeError.record(static_cast<uint64_t>(attitudeError(predicted, newInfo) * 1000));
+    }
+    {
+        std::lock_guard lock(writeMutex);
+        dataLock.write([&] {
+            storeInfo(last, previousInfo);
+            previousInfoTime.store(lastTime, std::memory_order_relaxed);
+            storeInfo(newInfo, info);
+            infoTime.store(now, std::memory_order_relaxed);
+        });
+        if (publisher)
+            publisher->publishInfo(newInfo, now);
+    }
+    updatedRefs.clear();
+    if (resubscribePending != 0)
+        trackResubscribe(true);
+    notifyUpdate(true, now);
+    return true;
+}
+
+/**
+ * @brief 解码 DATA 每组 36 字节 不经中间缓冲直接写入 groupValues 并通知
+ * @param arrival 到达时间 steady ns
+ * @return 数据包是否合法
+ */
+bool XPlaneUdp::processDataGroups (const std::span<const char> data, const int64_t arrival) {
+    const size_t size = data.size();
+    if ((size - HEADER_LENGTH) % GROUP_RECORD != 0)
+        return false;
+    updatedGroups.clear();
+    size_t outOfRange{0};
+    {
+        std::lock_guard lock(writeMutex);
+        dataLock.write([&] {
+            for (size_t offset = HEADER_LENGTH; offset < size; offset += GROUP_RECORD) {
+                int32_t group;
+                DataGroup row;
+                unpack(data, offset, group, row);
+                if (group < 0 || static_cast<size_t>(group) >= DATA_GROUPS) {
+                    ++outOfRange;
+                    continue;
+                }
+                const size_t start = static_cast<size_t>(group) * GROUP_WIDTH;
+                for (size_t i = 0; i < GROUP_WIDTH; ++i)
+                    groupValues.set(start + i, row[i]);
+                groupTime[group].store(arrival, std::memory_order_relaxed);
+                updatedGroups.push_back(group);
+            }
+        });
+    }
+    if (outOfRange != 0)
+        XPlaneStats::bump(stats.outOfRange, outOfRange);
+    if (groupCallback)
+        groupCallback(updatedGroups);
+    return true;
+}
+
+/**
+ * @brief 处理信标 第一次听见主机信标时建立与 xp 的连接 之后只有所连接主机的信标维持连接
+ *        外部视景、教员台与其它主机的信标合法 但不影响连接状态
+ * @return 数据包是否合法
+ */
+bool XPlaneUdp::processBeacon (const std::span<const char> data, const ip::udp::endpoint &sender) {
+    uint16_t port;
+    const BeaconRole role = parseBeacon(data, port);
+    if (role == BeaconRole::INVALID)
+        return false;
+    const ip::udp::endpoint endpoint(sender.address(), port);
+    if (role != BeaconRole::MASTER || (xpSocket.is_open() && endpoint != xpEndpoint))
+        return true;
+    if (!xpSocket.is_open() && !replaying) // 第一次听见信标 回放时不建立连接
+        openSocket(endpoint);
+    armBeaconTimer();
+    setState(true);
+    return true;
+}
+
+/**
+ * @brief 打开与 xp 通信的 socket 并开始接收
+ * @param endpoint xp 接收地址
+ */
+void XPlaneUdp::openSocket (const ip::udp::endpoint &endpoint) {
+    xpEndpoint = endpoint;
+    const ip::udp::endpoint local(ip::udp::v4(), 0);
+    xpSocket.open(local.protocol());
+    xpSocket.bind(local);
+    xpSocket.set_option(asio::socket_base::receive_buffer_size(RECV_BUFFER));
+    if (socketBusyPoll > 0)
+        setSocketBusyPoll(xpSocket, socketBusyPoll);
+    if (kernelTimestamps)
+        setSocketTimestamps(xpSocket, true);
+    xpOpen.store(true, std::memory_order_release);
+    receiveData();
 }
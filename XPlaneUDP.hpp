@@ -3,15 +3,31 @@
 
 #include <boost/system.hpp>
 #include <boost/asio.hpp>
-#include <boost/dynamic_bitset.hpp>
 #include <format>
 #include <iostream>
 #include <ranges>
 #include <memory>
 #include <array>
-#include <shared_mutex>
+#include <span>
+#include <mutex>
+#include <condition_variable>
 #include <atomic>
-#include <boost/pool/pool_alloc.hpp>
+#include <thread>
+#include <utility>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <map>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include "XPlaneStats.hpp"
+#include "XPlaneSchema.hpp"
+#include "XPlaneDecode.hpp"
+#include "XPlaneRecorder.hpp"
+#include "XPlaneSeries.hpp"
 
 
 template <typename T>
@@ -32,6 +48,9 @@ const static std::string DATAREF_GET_HEAD{'R', 'R', 'E', 'F', '\x00'};
 const static std::string DATAREF_SET_HEAD{'D', 'R', 'E', 'F', '\x00'};
 const static std::string BASIC_INFO_HEAD{'R', 'P', 'O', 'S', '\x00'};
 const static std::string BECON_HEAD{'B', 'E', 'C', 'N', '\x00'};
+const static std::string DATA_HEAD{'D', 'A', 'T', 'A', '\x00'}; // 第 5 字节各版本不同 只比较前 4 字节
+const static std::string DATA_SELECT_HEAD{'D', 'S', 'E', 'L', '\x00'};
+const static std::string DATA_UNSELECT_HEAD{'U', 'S', 'E', 'L', '\x00'};
 
 namespace sys = boost::system;
 namespace asio = boost::asio;
@@ -39,6 +58,10 @@ namespace ip = asio::ip;
 
 class XPlaneUdp;
 class BufferPool;
+class SeqLock;
+class ValueStore;
+class HistoryRing;
+class SharedPublisher;
 
 template <typename T, typename... Rests>
     requires (std::same_as<std::string, T> || std::is_fundamental_v<T>)
@@ -48,19 +71,318 @@ template <CharArray T1, typename T2, typename... Rests>
 size_t pack (T1 &container, size_t offset, const T2 &first, const Rests &... rest);
 template <CharArray CharList, typename First, typename... Rests>
 void unpack (const CharList &container, size_t offset, First &first, Rests &... rest);
+/**
+ * @brief BECN 信标的发送方
+ */
+enum class BeaconRole {
+    INVALID, // 长度或头部不合法
+    MASTER, // 主机 (role 1) 接受订阅
+    OTHER, // 外部视景、教员台等 不接受订阅 也不表示主机在线
+};
+/**
+ * @brief 解析 BECN 信标
+ * @param port xp 接收端口
+ * @return 发送方 不合法时为 INVALID
+ */
+BeaconRole parseBeacon (std::span<const char> data, uint16_t &port);
 
 
+/**
+ * @brief 1472 字节定长块内存池 每个 XPlaneUdp 独立持有
+ *        空闲链表无锁 引用计数在块内 获取与归还不分配堆内存 也不清零整个块
+ */
 class BufferPool {
-    struct BufferPro {
-        std::array<char, 1472> data{};
-        size_t length;
-        BufferPro () : length(0) { std::memset(data.data(), 0x00, data.size()); }
-    };
+    struct Block;
+    public:
+        static constexpr size_t BLOCK_SIZE{1472};
+        static constexpr size_t CHUNK_BLOCKS{64}; // 每次扩容的块数
+        static constexpr size_t MAX_CHUNKS{1024}; // 超出后直接从堆分配
+        struct Report {
+            size_t capacity{0}; // 池内块数
+            size_t inUse{0}; // 正在使用
+            size_t highWater{0}; // 同时使用的最大值
+            uint64_t acquired{0}; // 累计获取次数
+            uint64_t overflow{0}; // 池已满 从堆分配的次数
+        };
+        /**
+         * @brief 块的引用 可复制 最后一个引用析构时归还
+         */
+        class Buffer {
+            public:
+                Buffer () = default;
+                Buffer (const Buffer &other) : block(other.block) {
+                    if (block)
+                        block->refs.fetch_add(1, std::memory_order_relaxed);
+                }
+                Buffer (Buffer &&other) noexcept : block(std::exchange(other.block, nullptr)) {}
+                Buffer& operator= (Buffer other) noexcept {
+                    std::swap(block, other.block);
+                    return *this;
+                }
+                ~Buffer () { reset(); }
+                void reset ();
+                std::array<char, BLOCK_SIZE>& operator* () const { return block->data; }
+                std::array<char, BLOCK_SIZE>* operator-> () const { return &block->data; }
+                explicit operator bool () const { return block != nullptr; }
+            private:
+                friend class BufferPool;
+                explicit Buffer (Block *target) : block(target) {}
+                Block *block{nullptr};
+        };
+
+        BufferPool () = default;
+        ~BufferPool ();
+        BufferPool (const BufferPool &) = delete;
+        BufferPool& operator= (const BufferPool &) = delete;
+
+        Buffer getBuffer (size_t length, size_t padTo = 0);
+        [[nodiscard]] Report report () const;
+    private:
+        static constexpr uint32_t NO_BLOCK{UINT32_MAX};
+        struct Block {
+            std::array<char, BLOCK_SIZE> data; // 不初始化
+            std::atomic<uint32_t> refs{0};
+            std::atomic<uint32_t> next{NO_BLOCK}; // 空闲链表中的下一块
+            uint32_t index{NO_BLOCK}; // 池内编号 NO_BLOCK 表示堆分配
+            BufferPool *owner{nullptr};
+        };
+
+        [[nodiscard]] Block* blockAt (const uint32_t index) const {
+            return chunks[index / CHUNK_BLOCKS].load(std::memory_order_acquire) + index % CHUNK_BLOCKS;
+        }
+        Block* pop ();
+        void push (Block *first, Block *last);
+        Block* grow ();
+        void release (Block *block);
+
+        std::atomic<uint64_t> freeHead{NO_BLOCK}; // 低 32 位为块编号 高 32 位为版本号 防止 ABA
+        std::array<std::atomic<Block*>, MAX_CHUNKS> chunks{};
+        std::atomic<size_t> chunkCount{0};
+        std::mutex growMutex; // 扩容互斥
+        std::atomic<size_t> inUse{0}, highWater{0};
+        std::atomic<uint64_t> acquired{0}, overflow{0};
+};
+
+inline void BufferPool::Buffer::reset () {
+    if (block && block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        block->owner->release(block);
+    block = nullptr;
+}
+
+/**
+ * @brief 单写多读顺序锁 读者不加锁 不写共享内存 写者不会被读者拖慢
+ *        多个写者需在外部互斥
+ */
+class SeqLock {
+    public:
+        template <typename Func>
+        void write (Func &&func);
+        template <typename Func>
+        uint64_t read (Func &&func) const;
+        template <typename Func>
+        bool tryRead (Func &&func, std::chrono::nanoseconds timeout) const;
+        [[nodiscard]] uint64_t version () const { return sequence.load(std::memory_order_acquire); }
+    private:
+        alignas(64) std::atomic<uint64_t> sequence{0}; // 奇数表示正在写
+};
+
+/**
+ * @brief 可复制的 relaxed 原子量 写者在 SeqLock 写入区内修改 读者在读取区内读取 由顺序锁保证一致
+ */
+template <typename T>
+class RelaxedAtomic {
+    public:
+        RelaxedAtomic (const T initial = T{}) : value(initial) {}
+        RelaxedAtomic (const RelaxedAtomic &other) : value(other.load()) {}
+        RelaxedAtomic& operator= (const RelaxedAtomic &other) { return *this = other.load(); }
+        RelaxedAtomic& operator= (const T newValue) {
+            value.store(newValue, std::memory_order_relaxed);
+            return *this;
+        }
+        operator T () const { return load(); }
+        [[nodiscard]] T load () const { return value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<T> value;
+};
+
+/**
+ * @brief 只在末尾追加的分块数组 元素地址不变 单个写者追加 读者在任意线程按已发布的大小访问
+ *        追加时先构造元素再以 release 发布大小 读者以 acquire 读取大小 不会读到未构造的元素
+ */
+template <typename T, size_t CHUNK = 1024, size_t MAX_CHUNKS = 4096>
+class StableVector {
+    public:
+        StableVector () = default;
+        StableVector (const StableVector &) = delete;
+        StableVector& operator= (const StableVector &) = delete;
+        ~StableVector () {
+            for (size_t i = 0; i < count.load(std::memory_order_relaxed); ++i)
+                (*this)[i].~T();
+        }
+        [[nodiscard]] size_t size () const { return count.load(std::memory_order_acquire); }
+        T& operator[] (const size_t i) { return *slot(i); }
+        const T& operator[] (const size_t i) const { return *slot(i); }
+        T& at (const size_t i) { return i < size() ? *slot(i) : throw std::out_of_range("StableVector index"); }
+        const T& at (const size_t i) const {
+            return i < size() ? *slot(i) : throw std::out_of_range("StableVector index");
+        }
+        /**
+         * @throw std::length_error 超过 CHUNK * MAX_CHUNKS 个元素
+         */
+        template <typename... Args>
+        T& emplace_back (Args&&... args) {
+            const size_t n = count.load(std::memory_order_relaxed);
+            if (n == CHUNK * MAX_CHUNKS)
+                throw std::length_error("StableVector is full");
+            auto &chunk = chunks[n / CHUNK];
+            if (!chunk)
+                chunk = std::make_unique<Storage[]>(CHUNK);
+            T *item = ::new (chunk[n % CHUNK].bytes) T(std::forward<Args>(args)...);
+            count.store(n + 1, std::memory_order_release);
+            return *item;
+        }
+    private:
+        struct Storage {
+            alignas(T) std::byte bytes[sizeof(T)];
+        };
+        std::array<std::unique_ptr<Storage[]>, MAX_CHUNKS> chunks{}; // 只由写者创建 读者经 count 的 acquire 看到
+        std::atomic<size_t> count{0};
+
+        T* slot (const size_t i) const {
+            return std::launder(reinterpret_cast<T*>(chunks[i / CHUNK][i % CHUNK].bytes));
+        }
+};
+
+/**
+ * @brief dataref 值存储 容量在构造时固定 之后不再分配 读者无需加锁即可安全访问
+ */
+class ValueStore {
+    public:
+        static constexpr size_t DEFAULT_CAPACITY{1 << 16}; // 256 KB
+        explicit ValueStore (const size_t capacity = DEFAULT_CAPACITY)
+            : total(capacity), data(new std::atomic<float>[capacity]{}) {}
+        /**
+         * @return 使用过的最高位置 + 1 只增不减
+         */
+        [[nodiscard]] size_t size () const { return count.load(std::memory_order_acquire); }
+        [[nodiscard]] size_t capacity () const { return total; }
+        void resize (size_t length);
+        void set (const size_t index, const float value) { data[index].store(value, std::memory_order_relaxed); }
+        [[nodiscard]] float get (const size_t index) const {
+            return index < total ? data[index].load(std::memory_order_relaxed) : 0;
+        }
+        template <typename OutIt>
+        void copy (size_t start, size_t length, OutIt out) const;
+    private:
+        size_t total;
+        std::unique_ptr<std::atomic<float>[]> data;
+        std::atomic<size_t> count{0};
+};
+
+/**
+ * @brief values 中位置的分配 空闲区间按起点与 (长度, 起点) 各建一个索引
+ *        分配为最佳适配 分配与释放均为 O(log n) 释放时与相邻的空闲区间合并
+ */
+class SlotAllocator {
+    public:
+        static constexpr size_t NO_SPACE{SIZE_MAX};
+        explicit SlotAllocator (size_t capacity);
+        size_t allocate (size_t length);
+        size_t allocateLowest (size_t length);
+        void release (size_t start, size_t length);
+        [[nodiscard]] size_t capacity () const { return total; }
+        [[nodiscard]] size_t used () const { return usedCount; }
+        [[nodiscard]] size_t end () const;
+        [[nodiscard]] size_t largestFree () const { return byLength.empty() ? 0 : byLength.rbegin()->first; }
+        [[nodiscard]] size_t freeExtents () const { return byStart.size(); }
+    private:
+        std::map<size_t, size_t> byStart; // 起点 -> 长度
+        std::set<std::pair<size_t, size_t>> byLength; // (长度, 起点)
+        size_t total;
+        size_t usedCount{0};
+
+        void take (std::map<size_t, size_t>::iterator extent, size_t length);
+};
+
+/**
+ * @brief dataref 名称登记 名称只复制一次到分块的内存区 地址不变 其它地方以 string_view 引用
+ */
+class NameRegistry {
+    public:
+        static constexpr size_t CHUNK_BYTES{64 * 1024};
+        static constexpr size_t NOT_FOUND{SIZE_MAX};
+        std::pair<std::string_view, bool> insert (std::string_view name, size_t value);
+        [[nodiscard]] size_t find (std::string_view name) const;
+        [[nodiscard]] size_t size () const { return index.size(); }
+        [[nodiscard]] size_t bytes () const;
+    private:
+        std::vector<std::unique_ptr<char[]>> chunks;
+        size_t chunkUsed{CHUNK_BYTES}; // 最后一块已使用 初始为满 首次登记时分配
+        std::unordered_map<std::string_view, size_t> index; // 名称 -> dataRefs 下标
+};
+
+/**
+ * @brief 挂起的协程 保存其完成处理器 在 strand 上等待条件满足后完成
+ *        完成时投递到协程自身的执行器 协程与 XPlaneUdp 在同一 strand 时不切换线程
+ */
+class AsyncWaiter {
+    public:
+        virtual ~AsyncWaiter () = default;
+        virtual void complete (bool result) = 0;
+};
+
+/**
+ * @brief 单个 dataref 的历史 固定深度的环 每个样本为接收时间与该 dataref 的全部值
+ *        io 线程在 dataLock 写入区内追加 不分配内存 读者在 dataLock 读取区内访问
+ */
+class HistoryRing {
     public:
-        static std::shared_ptr<std::array<char, 1472>> getBuffer (size_t length);
+        using Clock = std::chrono::steady_clock;
+        enum Interpolation {
+            HOLD, // 不晚于该时刻的最后一个样本
+            LINEAR, // 前后两个样本线性插值
+        };
+
+        /**
+         * @param length 样本数
+         * @param valueCount 每个样本的值个数 即 dataref 长度
+         * @param first values 中起点
+         */
+        HistoryRing (size_t length, size_t valueCount, size_t first);
+
+        [[nodiscard]] size_t depth () const { return capacity; }
+        [[nodiscard]] size_t width () const { return columns; }
+        [[nodiscard]] size_t size () const {
+            return std::min<uint64_t>(head.load(std::memory_order_acquire), capacity);
+        }
+        void push (int64_t time, const ValueStore &values);
+        void rebind (const size_t first) { start = first; }
+        template <typename OutIt>
+        bool at (Clock::time_point time, Interpolation mode, size_t count, OutIt out) const;
+        size_t copy (Clock::time_point from, Clock::time_point to, std::vector<Clock::time_point> &times,
+                     std::vector<float> &dst) const;
+        size_t copyLast (size_t count, std::vector<Clock::time_point> &times, std::vector<float> &dst) const;
+
+        [[nodiscard]] static int64_t toNanoseconds (const Clock::time_point time) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        }
     private:
-        boost::pool_allocator<BufferPro> allocator;
-        static void recycleBuffer (BufferPro *buffer);
+        size_t capacity;
+        size_t columns;
+        size_t start; // values 中起点 仅在 writeMutex 内访问
+        std::unique_ptr<std::atomic<int64_t>[]> stamps; // 接收时间 ns
+        std::unique_ptr<std::atomic<float>[]> data; // 按样本存放 capacity * columns
+        std::atomic<uint64_t> head{0}; // 已追加的样本数 第 n 个样本位于 n % capacity
+
+        [[nodiscard]] int64_t timeOf (const uint64_t n) const {
+            return stamps[n % capacity].load(std::memory_order_relaxed);
+        }
+        [[nodiscard]] const std::atomic<float>* row (const uint64_t n) const {
+            return data.get() + n % capacity * columns;
+        }
+        [[nodiscard]] uint64_t upperBound (int64_t time, uint64_t first, uint64_t end) const;
+        void copyRange (uint64_t first, uint64_t last, std::vector<Clock::time_point> &times,
+                        std::vector<float> &dst) const;
 };
 
 class XPlaneUdp {
@@ -79,10 +401,85 @@ class XPlaneUdp {
         struct PlaneInfo {
             double lon, lat, alt; // 经纬度 高度
             float agl, pitch, track, roll; // 离地高 / 俯仰 真航向 滚转
-            float vX, vY, vZ, rollRate, pitchRate, yawRate; // 三轴速度 / 横滚 俯仰 偏航
+            float vX, vY, vZ, rollRate, pitchRate, yawRate; // 三轴速度 东 上 南 m/s / 机体横滚 俯仰 偏航角速度 rad/s
+        };
+        static constexpr int64_t PREDICT_LIMIT{500'000'000}; // predictPlaneInfo 最长外推 ns
+        static constexpr size_t SHARED_VALUES{1 << 16}; // 共享内存默认容量 256 KB 的值
+        static constexpr size_t SHARED_REFS{4096};
+        static constexpr size_t VALUE_CAPACITY{ValueStore::DEFAULT_CAPACITY}; // 默认最多订阅的值 数组每个元素一个
+        // 停止或移动后释放的位置在此之后才重新分配 期间到达的旧位置数据包无所属 直接丢弃 不少于一个信标周期
+        static constexpr std::chrono::milliseconds SLOT_QUARANTINE{1000};
+        static constexpr size_t DATA_GROUPS{256}; // DATA 组序号上限
+        static constexpr size_t GROUP_WIDTH{8}; // 每组的值
+        static constexpr size_t GROUP_RECORD{4 + GROUP_WIDTH * 4}; // DATA 中每组 36 字节 int32 序号 + 8 个 float
+        using DataGroup = std::array<float, GROUP_WIDTH>;
+        struct SpaceReport {
+            size_t capacity; // values 容量
+            size_t used; // 已分配
+            size_t end; // 最后一个已分配位置 + 1
+            size_t largestFree; // 最大的连续空闲
+            size_t freeExtents; // 空闲区间数 越多越零碎
+            size_t quarantined; // 已释放 隔离期内暂不分配 计入 used
+            size_t refs; // 登记的 dataref
+            size_t nameBytes; // 名称登记约占内存
+            size_t requestBytes; // 预先打包的 RREF 请求
+        };
+        struct BusyPollOptions {
+            int cpu{-1}; // 自有 io 线程绑定的核 -1 不绑定
+            int fifoPriority{0}; // 自有 io 线程的 SCHED_FIFO 优先级 1-99 0 不修改
+            int socketBusyPoll{50}; // SO_BUSY_POLL 微秒 内核接收时轮询网卡队列 0 不设置
+        };
+        struct BusyPollReport {
+            bool spinning; // 接收自旋
+            bool socketBusyPoll; // SO_BUSY_POLL 已设置
+            bool pinned; // 已绑定核
+            bool realtime; // 已设置 SCHED_FIFO
+        };
+        enum class Freshness {
+            FRESH, // maxAge 内收到过
+            STALE, // 收到过 但已超过 maxAge
+            NEVER, // 订阅 (或恢复、重新分配位置) 后尚未收到 未订阅时也为此
+        };
+        struct AdaptiveOptions {
+            int32_t minFreq{1}; // 频率下限
+            int32_t maxFreq{120}; // 频率上限
+            double headroom{2}; // 目标频率为读取频率的倍数
+            double hysteresis{0.25}; // 目标与当前频率相差不超过当前的该比例时不修改
+            bool allowRaise{false}; // 允许高于订阅时的频率 默认只降低
+        };
+        struct AdaptiveReport {
+            size_t refs; // 受控的 dataref
+            uint64_t changes; // 累计修改频率的次数 每个 dataref 每次一次
+            uint64_t requestBytes; // 累计发送的修改请求字节
+            double requestedValues; // 按订阅时的频率 每秒接收的值
+            double currentValues; // 按当前频率 每秒接收的值
+            double savedBytes; // 每秒少接收的 RREF 字节 每个值 8 字节
+        };
+        struct PublishReport {
+            uint64_t published; // 已发布的数据包
+            uint64_t overflow; // 超出容量未发布的值与 dataref
+            size_t bytes; // 共享内存段大小
         };
+        struct Snapshot {
+            std::vector<float> values; // 全部 dataref 值 按 values 中索引
+            PlaneInfo info{};
+            uint64_t sequence{0}; // 更新序号 每收到一个数据包递增
+        };
+        template <typename Schema>
+        struct SchemaIndex {
+            Schema schema;
+            size_t start; // values 中起点 字段连续排列
+            size_t firstRef; // 第一个字段的 dataRefs 下标 其余字段依次递增
+            [[nodiscard]] DatarefIndex field (const size_t i) const { return DatarefIndex{firstRef + i}; }
+        };
+
+        using Executor = asio::strand<asio::any_io_executor>;
 
-        explicit XPlaneUdp (bool autoReConnect = true);
+        explicit XPlaneUdp (bool autoReConnect = true, size_t valueCapacity = VALUE_CAPACITY);
+        explicit XPlaneUdp (const asio::any_io_executor &executor, bool autoReConnect = true,
+                            size_t valueCapacity = VALUE_CAPACITY);
+        XPlaneUdp (const asio::any_io_executor &executor, const ip::udp::endpoint &endpoint, bool autoReConnect = true,
+                   size_t valueCapacity = VALUE_CAPACITY);
         ~XPlaneUdp ();
         XPlaneUdp (const XPlaneUdp &) = delete;
         XPlaneUdp& operator= (const XPlaneUdp &) = delete;
@@ -90,63 +487,371 @@ class XPlaneUdp {
         XPlaneUdp& operator= (XPlaneUdp &&) = delete;
 
         void setCallback (const std::function<void  (bool)> &callbackFunc);
+        void setUpdateCallback (const std::function<void  (std::span<const DatarefIndex>, bool)> &callbackFunc);
+        void setGroupCallback (const std::function<void  (std::span<const int32_t>)> &callbackFunc);
+        bool waitUpdate (const DatarefIndex &dataref, std::chrono::milliseconds timeout);
+        bool waitPlaneInfo (std::chrono::milliseconds timeout);
+        [[nodiscard]] const Executor& getExecutor () const { return strand; }
+        asio::awaitable<bool> nextUpdate (DatarefIndex dataref);
+        asio::awaitable<bool> nextPlaneInfo ();
+        asio::awaitable<bool> waitConnected ();
+        [[nodiscard]] XPlaneStats::Report getStats () const;
+        void enableStats (bool enable);
+        [[nodiscard]] BufferPool::Report getPoolReport () const { return pool.report(); }
         void reconnect (bool del = false);
         void stop ();
         void close ();
+        void receiveBeacon (std::span<const char> data, const ip::udp::endpoint &sender);
+        static void openBeaconSocket (ip::udp::socket &socket);
+        [[nodiscard]] ip::udp::endpoint getEndpoint () const { // 打开 xpSocket 后不再修改
+            return xpOpen.load(std::memory_order_acquire) ? xpEndpoint : ip::udp::endpoint{};
+        }
+
+        bool startRecording (const std::string &path, size_t ringBytes = PacketRecorder::DEFAULT_RING);
+        PacketRecorder::Report stopRecording ();
+        [[nodiscard]] PacketRecorder::Report getRecordingReport () const;
+        size_t replay (const std::string &path, double speed = 1.0);
+        bool startSeries (const std::string &path, std::span<const DatarefIndex> refs, bool planeInfo = true,
+                          size_t blockRows = SeriesWriter::DEFAULT_BLOCK_ROWS);
+        template <typename Schema>
+        bool startSeries (const std::string &path, const SchemaIndex<Schema> &index, bool planeInfo = true);
+        SeriesWriter::Report stopSeries ();
+        [[nodiscard]] SeriesWriter::Report getSeriesReport () const;
+        bool startPublishing (const std::string &name, size_t valueCapacity = SHARED_VALUES,
+                              size_t refCapacity = SHARED_REFS);
+        PublishReport stopPublishing ();
+        [[nodiscard]] PublishReport getPublishingReport () const;
 
         DatarefIndex addDataref (const std::string &dataref, int32_t freq = 1, int index = -1);
         DatarefIndex addDatarefArray (const std::string &dataref, int length, int32_t freq = 1);
         bool getDataref (const DatarefIndex &dataref, float &value, float defaultValue = 0) const;
         template <Container T>
         bool getDataref (const DatarefIndex &dataref, T &container, float defaultValue = 0);
+        Freshness getDataref (const DatarefIndex &dataref, float &value, std::chrono::milliseconds maxAge) const;
+        template <Container T>
+        Freshness getDataref (const DatarefIndex &dataref, T &container, std::chrono::milliseconds maxAge);
+        size_t findStale (std::chrono::milliseconds maxAge, std::vector<DatarefIndex> &dst) const;
         void changeDatarefFreq (const DatarefIndex &dataref, float freq);
+        void setDatarefPriority (const DatarefIndex &dataref, int32_t priority);
+        size_t compactSpace ();
+        [[nodiscard]] SpaceReport getSpaceReport () const;
+        void enableAdaptiveFreq (const AdaptiveOptions &options);
+        void disableAdaptiveFreq ();
+        size_t adaptFreq ();
+        [[nodiscard]] AdaptiveReport getAdaptiveReport () const;
+        bool setHistory (const DatarefIndex &dataref, size_t depth);
+        bool getDatarefAt (const DatarefIndex &dataref, HistoryRing::Clock::time_point time, float &value,
+                           HistoryRing::Interpolation mode = HistoryRing::LINEAR) const;
+        template <Container T>
+        bool getDatarefAt (const DatarefIndex &dataref, HistoryRing::Clock::time_point time, T &container,
+                           HistoryRing::Interpolation mode = HistoryRing::LINEAR) const;
+        size_t copyHistory (const DatarefIndex &dataref, HistoryRing::Clock::time_point from,
+                            HistoryRing::Clock::time_point to, std::vector<HistoryRing::Clock::time_point> &times,
+                            std::vector<float> &dst) const;
+        size_t copyHistory (const DatarefIndex &dataref, size_t last,
+                            std::vector<HistoryRing::Clock::time_point> &times, std::vector<float> &dst) const;
         void setDataref (const std::string &dataref, float value, int index = -1);
         template <Container T>
         void setDataref (const std::string &dataref, const T &value);
+        void enableWriteBuffer (std::chrono::microseconds tick = std::chrono::microseconds(0), float epsilon = 0);
+        void disableWriteBuffer ();
+        size_t flushWrites ();
+        asio::awaitable<size_t> flushWrites (asio::use_awaitable_t<>);
+        BusyPollReport enableBusyPoll (const BusyPollOptions &options);
+        void disableBusyPoll ();
+        bool enableKernelTimestamps (bool enable);
+
+        bool addDataGroup (int group);
+        void removeDataGroup (int group);
+        bool getDataGroup (int group, DataGroup &dst) const;
+        template <typename T>
+            requires (std::is_trivially_copyable_v<T> && sizeof(T) == sizeof(DataGroup))
+        bool getDataGroup (int group, T &dst) const;
+        uint64_t getDataGroups (std::span<const int> groups, std::span<DataGroup> dst) const;
 
         void addPlaneInfo (int freq = 1);
         void getPlaneInfo (PlaneInfo &infoDst) const;
+        bool predictPlaneInfo (std::chrono::steady_clock::time_point time, PlaneInfo &infoDst) const;
+
+        template <typename S, typename... Fields>
+        SchemaIndex<DatarefSchema<S, Fields...>> addSchema (const DatarefSchema<S, Fields...> &schema);
+        template <typename Schema>
+        uint64_t getSchema (const SchemaIndex<Schema> &index, typename Schema::Struct &dst) const;
+
+        uint64_t snapshot (Snapshot &dst) const;
+        std::span<const float> view (const Snapshot &snap, const DatarefIndex &dataref) const;
     private:
+        /**
+         * @brief 预先打包的 RREF 请求 每个元素占 stride 字节 只保存到名称结尾 发送时补零到 413 字节
+         */
+        struct RrefRequests {
+            static constexpr size_t PACKET_SIZE{413};
+            size_t stride{0};
+            std::vector<char> bytes{};
+            [[nodiscard]] size_t size () const { return stride == 0 ? 0 : bytes.size() / stride; }
+            [[nodiscard]] std::span<char> at (const size_t i) { return {bytes.data() + i * stride, stride}; }
+            [[nodiscard]] std::span<const char> at (const size_t i) const { return {bytes.data() + i * stride, stride}; }
+        };
         struct DatarefInfo {
-            std::string name; // dataref 长度
-            int start, end; // values中索引,[start,end]
+            std::string_view name; // dataref 名称 位于 names 的内存区
+            RelaxedAtomic<int> start, end; // values中索引,[start,end] 以下三项在 dataLock 写入区内修改 读者在读取区内读取
             int32_t freq; // 频率
-            bool available; // 是否可用
+            RelaxedAtomic<bool> available; // 是否可用
             bool isArray; // 是否是数组
+            int32_t schema{-1}; // 所属 schema 序号 -1 为单独订阅 schema 字段位置固定
+            int32_t priority{0}; // 重新订阅时从高到低发送
+            RrefRequests requests{}; // 每个元素一个
+            RelaxedAtomic<uint64_t> placed{0}; // 位置最后改变时的更新序号 晚于快照时 view 不使用该快照
+        };
+        struct Placement {
+            int start{-1}, end{-1};
+            bool available{false};
+        };
+        struct Quarantined {
+            size_t start, length;
+            std::chrono::steady_clock::time_point until; // 到期后才重新分配
         };
 
         // 数据
-        std::vector<DatarefInfo> dataRefs;
-        std::vector<float> values;
-        boost::dynamic_bitset<> space;
-        std::unordered_map<std::string, size_t> exist;
-        PlaneInfo info{.track = -999};
+        static constexpr size_t INFO_WORDS{(sizeof(PlaneInfo) + 3) / 4};
+        StableVector<DatarefInfo> dataRefs; // 订阅线程追加 元素地址不变 读者与 io 线程按已发布的数量访问
+        ValueStore values;
+        SlotAllocator space; // values 中的位置 仅订阅线程访问
+        std::deque<Quarantined> quarantine; // 释放后暂不分配的位置 按到期时间排列 仅订阅线程访问
+        NameRegistry names; // 名称 -> dataRefs 下标 仅订阅线程访问
+        int32_t schemaCount{0};
+        using InfoWords = std::array<std::atomic<uint32_t>, INFO_WORDS>;
+        InfoWords info{}; // PlaneInfo 按字存储
+        InfoWords previousInfo{}; // 上一个 RPOS 用于外推
+        std::atomic<int64_t> infoTime{0}, previousInfoTime{0}; // 接收时间 steady ns 0 为未收到
+        ValueStore groupValues{DATA_GROUPS * GROUP_WIDTH}; // DATA 组 按序号连续存放 每组 GROUP_WIDTH 个值
+        std::array<std::atomic<int64_t>, DATA_GROUPS> groupTime{}; // 各组接收时间 steady ns 0 为未收到
+        std::vector<int32_t> dataGroups; // 已 DSEL 的组 受 writeMutex 保护
         BufferPool pool{};
-        mutable std::shared_mutex dataMutex;
+        SeqLock dataLock; // 读者无锁
+        mutable std::mutex writeMutex; // 写者之间互斥 (io 线程 / 订阅线程)
         std::atomic<bool> closed{false};
+        XPlaneStats stats; // 运行统计
         // 网络
         bool autoReconnect; // 自动重连
-        asio::io_context io_context{}; // 上下文
-        asio::executor_work_guard<asio::io_context::executor_type> workGuard;
-        ip::udp::socket multicastSocket{io_context}; // 监听多播
-        ip::udp::socket xpSocket{io_context}; // xp通信
-        ip::udp::endpoint xpEndpoint; // xp端口
-        std::thread worker; // io_content驱动
+        std::unique_ptr<asio::io_context> ownContext; // 自有上下文 使用外部执行器时为空
+        Executor strand; // 全部 io 操作在此串行执行 外部执行器可由多个线程运行 "io 线程" 指当前运行 strand 的线程
+        asio::executor_work_guard<asio::any_io_executor> workGuard;
+        ip::udp::socket multicastSocket{strand}; // 监听多播 转交信标的实例不打开
+        ip::udp::socket xpSocket{strand}; // xp通信
+        ip::udp::endpoint xpEndpoint; // xp端口 仅 io 线程访问
+        std::atomic<bool> xpOpen{false}; // xpSocket 已打开 供其它线程判断是否连接
+        asio::steady_timer beaconTimer{strand}; // 超时未收到信标时断开
+        std::atomic<int> tasks{0}; // 进行中的协程与投递 外部执行器关闭时等待归零
+        std::thread worker; // io_content驱动 使用外部执行器时不启动
         int infoFreq{}; // 基本信息频率
+        // 批量发送
+        struct PendingSend {
+            BufferPool::Buffer data;
+            size_t size;
+        };
+        std::vector<PendingSend> sendQueue; // 待发送
+        std::vector<PendingSend> sending; // 发送中 仅发送协程访问
+        size_t sendOffset{0}; // sending 中已发送的数量
+        std::mutex sendMutex; // 保护 sendQueue
+        std::atomic<bool> sendScheduled{false}; // 已有发送者
+        // 接收
+        struct ReceiveRing; // 预分配的接收缓冲 定义见 cpp
+        std::unique_ptr<ReceiveRing> ring;
+        RrefDecoder::Kernel decodeKernel{RrefDecoder::best()}; // 按 CPU 选择的 RREF 解码
+        std::array<char, 1472> beaconBuffer{}; // 信标接收缓冲 仅 io 线程访问
+        std::vector<int32_t> updatedGroups; // 当前数据包更新的 DATA 组 仅 io 线程访问
+        std::function<void  (std::span<const int32_t>)> groupCallback{nullptr}; // 每个 DATA 数据包调用一次
+        std::atomic<bool> spinning{false}; // 忙轮询 接收协程不等待可读
+        int socketBusyPoll{0}; // 打开 xpSocket 时设置的 SO_BUSY_POLL 仅 io 线程访问
+        bool kernelTimestamps{false}; // 打开 xpSocket 时设置 SO_TIMESTAMPNS 接收时读取内核时间 仅 io 线程访问
+        // 记录与回放
+        std::unique_ptr<PacketRecorder> recorder; // 受 recordMutex 保护
+        mutable std::mutex recordMutex;
+        PacketRecorder *recording{nullptr}; // 当前记录器 仅 io 线程访问
+        std::atomic<bool> replaying{false}; // 回放中 忽略实时信标 不建立连接
+        struct SeriesTarget {
+            SeriesWriter *writer{nullptr};
+            std::vector<std::pair<size_t, size_t>> slots; // 各 dataref 在 values 中的 [start, end]
+            std::vector<bool> refs; // 按 dataRefs 下标 是否记录
+            bool info{false};
+            int64_t lastTime{INT64_MIN}; // 上一行时间 行时间不减 内核时间戳换算后可能略早于上一包
+        };
+        std::unique_ptr<SeriesWriter> seriesWriter; // 受 recordMutex 保护
+        SeriesTarget series; // 时间序列记录目标 仅 io 线程访问
         // 回调
         bool state{false}; // xp状态
         std::function<void  (bool)> callback{nullptr}; // 回调
+        // 更新通知
+        std::function<void  (std::span<const DatarefIndex>, bool)> updateCallback{nullptr}; // 每个数据包调用一次
+        std::vector<RelaxedAtomic<int32_t>> slotOwner; // values 中每个位置所属 dataRefs 下标 -1 为空闲 在 dataLock 写入区内修改
+        // values 中每个位置最后收到的时刻 为构造以来的毫秒 + 1 模 2^32 约 49.7 天回绕 跳过以下三个值
+        // 在 dataLock 写入区内写入 时间差按模 2^32 计算 超过半圈的时间戳由 stampTimer 改为 ANCIENT_STAMP 不会回绕成新鲜
+        static constexpr uint32_t NEVER_STAMP{StaleScan::NEVER}; // 已分配 尚未收到
+        static constexpr uint32_t ANCIENT_STAMP{StaleScan::ANCIENT}; // 超过 STAMP_ANCIENT 未收到 总是过期
+        static constexpr uint32_t FREE_STAMP{StaleScan::FREE}; // 未分配 扫描时不会过期
+        static constexpr uint32_t STAMP_LEAD{1000}; // 晚于读取时刻不超过该毫秒数的时间戳为读取后刚写入 视为新鲜
+        static constexpr uint32_t STAMP_ANCIENT{UINT32_C(1) << 31}; // 年龄超过该毫秒数的时间戳改为 ANCIENT_STAMP
+        static constexpr std::chrono::hours STAMP_SWEEP{1}; // 检查间隔 远小于 2^32 - STAMP_ANCIENT 毫秒
+        std::unique_ptr<std::atomic<uint32_t>[]> slotTimes;
+        std::atomic<int64_t> stampEpoch; // 构造时刻 steady ns
+        asio::steady_timer stampTimer{strand}; // 定时 ageStamps 仅 io 线程访问
+        StaleScan::Kernel staleKernel{StaleScan::best()};
+        std::vector<uint64_t> refStamp; // dataref 最后出现的数据包序号 受 writeMutex 保护
+        uint64_t packetCount{0}; // 已处理 RREF 数据包 受 writeMutex 保护
+        std::vector<DatarefIndex> updatedRefs; // 当前数据包更新的 dataref 仅 io 线程访问
+        // 重新订阅耗时 仅 io 线程访问
+        std::vector<bool> resubscribeWaiting; // 按 dataRefs 下标 重新订阅后尚未收到
+        bool resubscribeInfo{false}; // 尚未收到 RPOS
+        size_t resubscribePending{0}; // 尚未收到的 dataref 与 RPOS 为 0 时不统计
+        int64_t resubscribeStart{0}; // 听见信标并重新订阅的时刻 steady ns
+        std::mutex notifyMutex;
+        std::condition_variable notifyCond;
+        std::vector<uint64_t> refGeneration; // dataref 更新次数 受 notifyMutex 保护
+        uint64_t infoGeneration{0}; // 基本信息更新次数 受 notifyMutex 保护
+        std::atomic<int> waiters{0}; // 等待中的线程 为0时不唤醒
+        // 挂起的协程 仅 io 线程访问
+        static constexpr size_t INFO_WAITER{SIZE_MAX}; // 等待基本信息
+        std::vector<std::pair<size_t, std::unique_ptr<AsyncWaiter>>> updateWaiters; // dataRefs 下标或 INFO_WAITER
+        std::vector<std::unique_ptr<AsyncWaiter>> connectWaiters;
+        std::vector<std::unique_ptr<AsyncWaiter>> flushWaiters; // 等待当前发送者发完
+        std::atomic<bool> flushPending{false}; // flushWaiters 非空 发送者发完时唤醒
+        // 历史
+        std::vector<std::unique_ptr<HistoryRing>> historyRings; // 全部创建过的历史 保留到析构 仅订阅线程访问
+        // 按 dataRefs 下标 未启用为空 在 writeMutex 内追加与 release 写入 读者 acquire 读取 元素地址不变
+        StableVector<std::atomic<HistoryRing*>> history;
+        size_t historyRefs{0}; // 启用历史的 dataref 数 受 writeMutex 保护
+        // 共享内存发布
+        std::unique_ptr<SharedPublisher> publisher; // 受 writeMutex 保护
+        // 自适应频率 仅订阅线程访问 读取计数除外
+        /**
+         * @brief 按 dataRefs 下标的读取计数 每个读者线程递增自己的一行 行按缓存行对齐 读者之间不争用同一缓存行
+         *        线程多于 STRIPES 时按序共用 adaptFreq 读取时合计各行
+         */
+        struct ReadCounts {
+            static constexpr size_t STRIPES{16};
+            struct alignas(64) Line {
+                std::atomic<uint32_t> counts[16]{};
+            };
+            explicit ReadCounts (const size_t size)
+                : size(size), lines((size + 15) / 16), data(new Line[STRIPES * lines]) {}
+            [[nodiscard]] std::atomic<uint32_t>& at (const size_t stripe, const size_t ref) const {
+                return data[stripe * lines + ref / 16].counts[ref % 16];
+            }
+            /**
+             * @brief 取出并清零一个 dataref 各行的计数
+             */
+            uint32_t take (const size_t ref) const {
+                uint32_t total{0};
+                for (size_t stripe = 0; stripe < STRIPES; ++stripe)
+                    total += at(stripe, ref).exchange(0, std::memory_order_relaxed);
+                return total;
+            }
+            /**
+             * @brief 当前线程的行 第一次调用时按序分配
+             */
+            static size_t stripe () {
+                static std::atomic<size_t> next{0};
+                thread_local const size_t mine = next.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+                return mine;
+            }
+            size_t size;
+            size_t lines; // 每行的缓存行数
+            std::unique_ptr<Line[]> data;
+        };
+        std::vector<std::unique_ptr<ReadCounts>> readCountStores; // 全部分配过的计数 读者可能仍在旧的上递增 保留到析构
+        std::atomic<ReadCounts*> readCounts{nullptr}; // 读者递增 未启用为空
+        AdaptiveOptions adaptiveOptions;
+        std::vector<int32_t> requestedFreq; // 按 dataRefs 下标 订阅或 changeDatarefFreq 设置的频率 -1 为尚未受控
+        std::chrono::steady_clock::time_point adaptTime; // 上次 adaptFreq
+        uint64_t adaptChanges{0}, adaptRequestBytes{0};
+        // 写入缓冲
+        struct WriteSlot {
+            float pending{0}; // 待发送
+            float sent{0}; // 上次发送
+            bool dirty{false}; // 有待发送的值
+            bool queued{false}; // 已在 dirtyWrites 中 每个周期最多一次
+            bool hasSent{false}; // sent 有效 重新连接后失效
+        };
+        using WriteTarget = std::pair<const std::string, std::vector<WriteSlot>>;
+        std::unordered_map<std::string, std::vector<WriteSlot>> writeSlots; // 按名称 第 0 个为整体 第 i + 1 个为元素 i
+        std::vector<std::pair<WriteTarget*, int>> dirtyWrites; // 待发送的名称与下标 元素地址在 rehash 后不变
+        float writeEpsilon{0}; // 与上次发送相差不超过时不发送
+        bool writeBuffered{false}; // 以上受 writeBufferMutex 保护
+        std::mutex writeBufferMutex;
+        asio::steady_timer writeTimer{strand}; // 定时 flushWrites 仅 io 线程访问
 
+        /**
+         * @brief 启用自适应频率时记录一次读取 未启用时只有一次原子读
+         *        启用时为一次 thread_local 读取与当前线程所在行上的原子加 通常不与其它读者争用
+         */
+        void noteRead (const size_t refIndex) const {
+            if (ReadCounts *reads = readCounts.load(std::memory_order_acquire); reads && refIndex < reads->size)
+                reads->at(ReadCounts::stripe(), refIndex).fetch_add(1, std::memory_order_relaxed);
+        }
+        void reserveReadCounts (size_t refs);
         void setState (bool newState);
+        static void storeInfo (const PlaneInfo &src, InfoWords &dst);
+        static void loadInfo (const InfoWords &src, PlaneInfo &dst);
         size_t findSpace (size_t length);
+        void releaseSpace (size_t start, size_t length);
+        void reclaimSpace ();
+        bool takeQuarantined (size_t start, size_t length);
+        [[nodiscard]] Placement placement (const DatarefInfo &ref) const;
+        void bindSlots (size_t refIndex, bool bind);
+        void bindOwner (size_t refIndex, bool bind);
+        [[nodiscard]] uint32_t toStamp (int64_t nanoseconds) const;
+        [[nodiscard]] uint32_t nowStamp () const;
+        [[nodiscard]] static uint32_t stampAge (uint32_t now, uint32_t stamp);
+        [[nodiscard]] uint32_t oldestStamp (size_t start, size_t length, uint32_t now) const;
+        [[nodiscard]] static Freshness freshness (uint32_t stamp, uint32_t now, std::chrono::milliseconds maxAge);
+        size_t ageStamps ();
+        asio::awaitable<void> ageLoop ();
+#ifdef XPLANEUDP_TEST_ACCESS
+        friend struct StampClockProbe; // 只在测试目标中声明 见 benchmark/staleness.cpp
+#endif
+        void notifyUpdate (bool infoUpdated, int64_t arrival);
+        asio::awaitable<bool> suspend (std::function<void  (std::unique_ptr<AsyncWaiter>)> enqueue);
+        void wakeUpdateWaiters (bool infoUpdated);
+        static void wakeAll (std::vector<std::unique_ptr<AsyncWaiter>> &list, bool result);
+        void wakeFlushWaiters ();
+        void cancelWaiters ();
+        [[nodiscard]] const HistoryRing* historyOf (const DatarefIndex &dataref) const;
+        void growHistory ();
         void detectBeacon ();
         asio::awaitable<void> detect ();
-        void sendData (const std::shared_ptr<std::array<char, 1472>> &data, size_t size);
-        asio::awaitable<void> send (std::shared_ptr<std::array<char, 1472>> data, size_t size);
+        void handleBeacon (std::span<const char> data, const ip::udp::endpoint &sender, int64_t arrival);
+        void armBeaconTimer ();
+        void spawn (asio::awaitable<void> task);
+        void openSocket (const ip::udp::endpoint &endpoint);
+        void sendData (const BufferPool::Buffer &data, size_t size);
+        void queueData (const BufferPool::Buffer &data, size_t size);
+        void flushData ();
+        asio::awaitable<void> sendBatch ();
+        bool drainSend ();
+        size_t sendMany (size_t offset);
         void receiveData ();
         asio::awaitable<void> receive ();
-        void receiveDataProcess (const std::shared_ptr<std::array<char, 1472>> &data, size_t size,
-                                 const ip::udp::endpoint &sender);
+        size_t receiveMany ();
+        void receiveDataProcess (std::span<const char> data, const ip::udp::endpoint &sender, int64_t arrival);
+        bool processDataref (std::span<const char> data, int64_t arrival);
+        bool processPlaneInfo (std::span<const char> data, int64_t arrival);
+        bool processDataGroups (std::span<const char> data, int64_t arrival);
+        bool processBeacon (std::span<const char> data, const ip::udp::endpoint &sender);
+        void runInIo (const std::function<void  ()> &func);
+        void recordSeries (bool infoUpdated, int64_t arrival);
+        asio::awaitable<size_t> replayLog (PacketLog log, double speed);
+        std::pair<size_t, size_t> addSchemaLayout (std::span<const SchemaLayout> layout, int length);
+        static RrefRequests packRequests (std::string_view name, int length, int32_t freq, int32_t start, bool isArray);
+        void queueRequests (const RrefRequests &requests, bool del);
+        void queueGroupSelect (std::span<const int32_t> groups, bool del);
+        void patchFreq (DatarefInfo &ref, int32_t freq);
+        void moveSlots (size_t refIndex, int start);
+        void startResubscribe ();
+        void trackResubscribe (bool infoUpdated);
+        BufferPool::Buffer packWrite (const std::string &dataref, float value, int index);
+        bool bufferWrite (const std::string &dataref, float value, int index);
+        asio::awaitable<void> flushLoop (std::chrono::microseconds tick);
 };
 
 /**
@@ -212,6 +917,115 @@ size_t pack (T1 &container, const size_t offset, const T2 &first, const Rests &.
     }
 }
 
+/**
+ * @brief 写入 func 中修改的数据 读者会看到完整的修改
+ */
+template <typename Func>
+void SeqLock::write (Func &&func) {
+    const uint64_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    func();
+    sequence.store(seq + 2, std::memory_order_release);
+}
+
+/**
+ * @brief 读取数据 期间发生写入则重试 func 可能被调用多次
+ * @return 读到的版本号
+ */
+template <typename Func>
+uint64_t SeqLock::read (Func &&func) const {
+    while (true) {
+        const uint64_t seq = sequence.load(std::memory_order_acquire);
+        if (seq & 1) { // 写者被调度走时让出时间片
+            std::this_thread::yield();
+            continue;
+        }
+        func();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == seq)
+            return seq;
+    }
+}
+
+/**
+ * @brief 与 read 相同 但写入区持续 timeout 仍未结束时放弃 用于写者可能在写入区内退出的跨进程读取
+ * @return 是否读到一致的数据
+ */
+template <typename Func>
+bool SeqLock::tryRead (Func &&func, const std::chrono::nanoseconds timeout) const {
+    std::chrono::steady_clock::time_point since{};
+    while (true) {
+        const uint64_t seq = sequence.load(std::memory_order_acquire);
+        if (seq & 1) {
+            const auto now = std::chrono::steady_clock::now();
+            if (since == std::chrono::steady_clock::time_point{})
+                since = now;
+            else if (now - since > timeout)
+                return false;
+            std::this_thread::yield();
+            continue;
+        }
+        since = {};
+        func();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == seq)
+            return true;
+    }
+}
+
+/**
+ * @brief 复制一段连续的值 超出当前内存的部分填0
+ * @param start 起始位置
+ * @param length 长度
+ * @param out 输出
+ */
+template <typename OutIt>
+void ValueStore::copy (const size_t start, const size_t length, OutIt out) const {
+    const size_t end = std::min(start + length, std::max(start, total));
+    for (size_t i = start; i < end; ++i, ++out)
+        *out = data[i].load(std::memory_order_relaxed);
+    for (size_t i = end; i < start + length; ++i, ++out)
+        *out = 0;
+}
+
+/**
+ * @brief 某时刻的值 需在 dataLock 读取区内调用
+ * @param time 时刻 晚于最新样本时为最新值
+ * @param mode 插值方式
+ * @param count 输出的值个数 不超过 width
+ * @param out 输出
+ * @return false 没有不晚于该时刻的样本
+ */
+template <typename OutIt>
+bool HistoryRing::at (const Clock::time_point time, const Interpolation mode, const size_t count, OutIt out) const {
+    const int64_t target = toNanoseconds(time);
+    const uint64_t end = head.load(std::memory_order_acquire);
+    const uint64_t first = end > capacity ? end - capacity : 0;
+    const uint64_t next = upperBound(target, first, end);
+    if (next == first) // 没有样本或早于最旧样本
+        return false;
+    const uint64_t before = next - 1;
+    const size_t n = std::min(count, columns);
+    const std::atomic<float> *a = row(before);
+    if (mode == HOLD || next == end) {
+        for (size_t i = 0; i < n; ++i, ++out)
+            *out = a[i].load(std::memory_order_relaxed);
+        return true;
+    }
+    const std::atomic<float> *b = row(next);
+    const int64_t t0 = timeOf(before);
+    const int64_t t1 = timeOf(next);
+    const float ratio = t1 > t0
+                            ? static_cast<float>(static_cast<double>(target - t0) / static_cast<double>(t1 - t0))
+                            : 0;
+    for (size_t i = 0; i < n; ++i, ++out) {
+        const float value = a[i].load(std::memory_order_relaxed);
+        *out = value + (b[i].load(std::memory_order_relaxed) - value) * ratio;
+    }
+    return true;
+}
+
 /**
  * @brief 获取 dataref 最新值
  * @param dataref 标识
@@ -221,9 +1035,9 @@ size_t pack (T1 &container, const size_t offset, const T2 &first, const Rests &.
  */
 template <Container T>
 bool XPlaneUdp::getDataref (const DatarefIndex &dataref, T &container, float defaultValue) {
-    std::shared_lock lock(dataMutex);
     const auto &ref = dataRefs.at(dataref.getIdx());
-    const size_t datarefSize = static_cast<size_t>(ref.end - ref.start + 1);
+    const Placement place = placement(ref); // 长度不随移动改变 位置在复制时重新读取
+    const size_t datarefSize = static_cast<size_t>(place.end - place.start + 1);
 
     if constexpr (requires { container.resize(datarefSize); }) { // vector等
         if (container.size() < datarefSize)
@@ -231,29 +1045,151 @@ bool XPlaneUdp::getDataref (const DatarefIndex &dataref, T &container, float def
     }
 
     const size_t copyCount = std::min(datarefSize, container.size());
-    if (!ref.available) {
+    bool available{false};
+    dataLock.read([&] {
+        available = ref.available;
+        if (available)
+            values.copy(ref.start, copyCount, container.begin());
+    });
+    if (!available) {
         std::ranges::fill(container | std::views::take(copyCount), defaultValue);
         return false;
     }
+    noteRead(dataref.getIdx());
+    return true;
+}
+
+/**
+ * @brief 获取 dataref 最新值及其是否在 maxAge 内收到 数组按最久未更新的元素
+ * @param dataref 标识
+ * @param container 容器 未订阅时不变 返回 NEVER 时其值无意义
+ * @param maxAge 最长允许的时间
+ * @return 值与时间来自同一时刻
+ */
+template <Container T>
+XPlaneUdp::Freshness XPlaneUdp::getDataref (const DatarefIndex &dataref, T &container,
+                                            const std::chrono::milliseconds maxAge) {
+    const auto &ref = dataRefs.at(dataref.getIdx());
+    const Placement place = placement(ref);
+    const size_t datarefSize = static_cast<size_t>(place.end - place.start + 1);
+    if (!place.available)
+        return Freshness::NEVER;
+    if constexpr (requires { container.resize(datarefSize); }) { // vector等
+        if (container.size() < datarefSize)
+            container.resize(datarefSize);
+    }
+    const size_t copyCount = std::min(datarefSize, static_cast<size_t>(container.size()));
+    const uint32_t now = nowStamp(); // 之后写入的时间戳晚于 now 见 stampAge
+    uint32_t stamp{NEVER_STAMP};
+    bool available{false};
+    dataLock.read([&] {
+        available = ref.available;
+        if (available) {
+            values.copy(ref.start, copyCount, container.begin());
+            stamp = oldestStamp(ref.start, datarefSize, now);
+        }
+    });
+    if (!available)
+        return Freshness::NEVER;
+    noteRead(dataref.getIdx());
+    return freshness(stamp, now, maxAge);
+}
+
+/**
+ * @brief 从历史获取 dataref 某时刻的值 需先 setHistory
+ * @param dataref 标识
+ * @param time 时刻 晚于最新样本时为最新值
+ * @param container 容器 各元素按同一对样本插值
+ * @param mode 插值方式
+ * @return false 未启用历史或没有不晚于该时刻的样本 container 不变
+ */
+template <Container T>
+bool XPlaneUdp::getDatarefAt (const DatarefIndex &dataref, const HistoryRing::Clock::time_point time, T &container,
+                              const HistoryRing::Interpolation mode) const {
+    const HistoryRing *target = historyOf(dataref);
+    if (target == nullptr)
+        return false;
+    if constexpr (requires { container.resize(target->width()); }) { // vector等
+        if (container.size() < target->width())
+            container.resize(target->width());
+    }
+    noteRead(dataref.getIdx());
+    const size_t count = std::min(target->width(), static_cast<size_t>(container.size()));
+    bool found{false};
+    dataLock.read([&] { found = target->at(time, mode, count, container.begin()); });
+    return found;
+}
 
-    auto source = values | std::views::drop(ref.start) | std::views::take(copyCount);
-    std::ranges::copy(source, container.begin());
+/**
+ * @brief 以结构体读取 DATA 组 结构体为 8 个 float 按 XPlane 数据输出界面中该组的列顺序
+ * @param group 组序号
+ * @param dst 目标
+ * @return 是否收到过 未收到时 dst 不变
+ */
+template <typename T>
+    requires (std::is_trivially_copyable_v<T> && sizeof(T) == sizeof(XPlaneUdp::DataGroup))
+bool XPlaneUdp::getDataGroup (const int group, T &dst) const {
+    DataGroup raw;
+    if (!getDataGroup(group, raw))
+        return false;
+    memcpy(&dst, raw.data(), sizeof(T));
     return true;
 }
 
 /**
- * @brief 设置某组 dataref 值
+ * @brief 按 schema 订阅 全部字段占用一段连续位置 RREF 只打包一次
+ * @param schema 编译期描述
+ * @return 用于 getSchema 的标识
+ */
+template <typename S, typename... Fields>
+XPlaneUdp::SchemaIndex<DatarefSchema<S, Fields...>> XPlaneUdp::addSchema (const DatarefSchema<S, Fields...> &schema) {
+    const auto layout = schema.layout();
+    const auto [start, firstRef] = addSchemaLayout(layout, DatarefSchema<S, Fields...>::LENGTH);
+    return {schema, start, firstRef};
+}
+
+/**
+ * @brief 一次读取 schema 的全部字段到结构体
+ * @param index addSchema 的返回值
+ * @param dst 目标结构体
+ * @return 更新序号 同 snapshot
+ */
+template <typename Schema>
+uint64_t XPlaneUdp::getSchema (const SchemaIndex<Schema> &index, typename Schema::Struct &dst) const {
+    std::array<float, Schema::LENGTH> raw;
+    const uint64_t version = dataLock.read([&] { values.copy(index.start, raw.size(), raw.begin()); });
+    index.schema.fill(dst, [&raw](const int offset) { return raw[offset]; });
+    return version / 2;
+}
+
+/**
+ * @brief 记录 schema 的全部字段
+ * @param path 文件 已存在时覆盖
+ * @param index addSchema 的返回值
+ * @param planeInfo 是否同时记录基本信息
+ * @return 是否成功创建文件
+ */
+template <typename Schema>
+bool XPlaneUdp::startSeries (const std::string &path, const SchemaIndex<Schema> &index, const bool planeInfo) {
+    std::vector<DatarefIndex> refs;
+    refs.reserve(Schema::FIELD_COUNT);
+    for (size_t i = 0; i < Schema::FIELD_COUNT; ++i)
+        refs.push_back(index.field(i));
+    return startSeries(path, refs, planeInfo);
+}
+
+/**
+ * @brief 设置某组 dataref 值 每个元素一个 DREF 一次批量发送 启用写入缓冲时逐个元素进入缓冲
  * @param dataref dataref 名称
  * @param value 容器
  */
 template <Container T>
 void XPlaneUdp::setDataref (const std::string &dataref, const T &value) {
-    for (int i = 0; i < value.size(); ++i) {
-        const size_t bufferSize = packSize(0, DATAREF_SET_HEAD, value[i], std::format("{}[{}]", dataref, i), '\x00');
-        const auto buffer = BufferPool::getBuffer(bufferSize);
-        pack(*buffer, 0, DATAREF_SET_HEAD, value[i], std::format("{}[{}]", dataref, i), '\x00');
-        sendData(buffer, 509);
+    for (size_t i = 0; i < static_cast<size_t>(value.size()); ++i) {
+        if (!bufferWrite(dataref, value[i], static_cast<int>(i)))
+            queueData(packWrite(dataref, value[i], static_cast<int>(i)), 509);
     }
+    flushData();
 }
 
 #endif
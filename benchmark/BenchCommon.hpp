@@ -0,0 +1,258 @@
+#ifndef XPLANEUDP_BENCH_COMMON_HPP
+#define XPLANEUDP_BENCH_COMMON_HPP
+
+#include "../XPlaneUDP.hpp"
+#include <boost/pool/pool_alloc.hpp>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// 基准测试公用工具: 在本机模拟 XPlane 的信标与接收端
+
+namespace bench {
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 本机 udp 接收端 统计收到的数据包 并记录发送方地址
+     */
+    class UdpSink {
+        public:
+            UdpSink () : socket(context, ip::udp::endpoint(ip::udp::v4(), 0)) {
+                socket.set_option(asio::socket_base::receive_buffer_size(16 << 20));
+                worker = std::thread([this] () { run(); });
+            }
+            ~UdpSink () {
+                running = false;
+                sys::error_code ec;
+                const ip::udp::endpoint self(ip::make_address("127.0.0.1"), port());
+                socket.send_to(asio::buffer(&ec, 0), self, 0, ec); // 唤醒阻塞的接收
+                worker.join();
+            }
+            UdpSink (const UdpSink &) = delete;
+            UdpSink& operator= (const UdpSink &) = delete;
+
+            [[nodiscard]] unsigned short port () const { return socket.local_endpoint().port(); }
+            [[nodiscard]] size_t count () const { return received.load(std::memory_order_acquire); }
+            void reset () { received.store(0, std::memory_order_release); }
+            [[nodiscard]] ip::udp::endpoint peer () const {
+                std::lock_guard lock(peerMutex);
+                return lastPeer;
+            }
+            /**
+             * @brief 等待收到指定数量的数据包
+             * @return 是否在超时前收到
+             */
+            bool waitFor (const size_t n, const std::chrono::milliseconds timeout) const {
+                const auto deadline = Clock::now() + timeout;
+                while (count() < n) {
+                    if (Clock::now() > deadline)
+                        return false;
+                    std::this_thread::yield();
+                }
+                return true;
+            }
+        private:
+            asio::io_context context;
+            ip::udp::socket socket;
+            std::thread worker;
+            std::atomic<bool> running{true};
+            std::atomic<size_t> received{0};
+            mutable std::mutex peerMutex;
+            ip::udp::endpoint lastPeer;
+
+            void run () {
+                std::array<char, 1472> buffer{};
+                ip::udp::endpoint sender;
+                while (running) {
+                    sys::error_code ec;
+                    const size_t n = socket.receive_from(asio::buffer(buffer), sender, 0, ec);
+                    if (ec || n == 0)
+                        continue;
+                    {
+                        std::lock_guard lock(peerMutex);
+                        lastPeer = sender;
+                    }
+                    received.fetch_add(1, std::memory_order_acq_rel);
+                }
+            }
+    };
+
+    /**
+     * @brief 周期性发送 BECN 信标, 让 XPlaneUdp 连接到指定端口
+     */
+    class FakeBeacon {
+        public:
+            explicit FakeBeacon (const unsigned short port) : socket(context, ip::udp::v4()) {
+                socket.set_option(ip::multicast::enable_loopback(true));
+                const std::string name{"bench"};
+                size = pack(packet, 0, BECON_HEAD, uint8_t{1}, uint8_t{2}, int32_t{1}, int32_t{120000}, uint32_t{1},
+                            port, name, '\x00');
+                worker = std::thread([this] () { run(); });
+            }
+            ~FakeBeacon () {
+                running = false;
+                worker.join();
+            }
+            FakeBeacon (const FakeBeacon &) = delete;
+            FakeBeacon& operator= (const FakeBeacon &) = delete;
+        private:
+            asio::io_context context;
+            ip::udp::socket socket;
+            std::array<char, 64> packet{};
+            size_t size;
+            std::thread worker;
+            std::atomic<bool> running{true};
+
+            void run () {
+                const ip::udp::endpoint group(ip::make_address("239.255.1.1"), 49707);
+                while (running) {
+                    sys::error_code ec;
+                    socket.send_to(asio::buffer(packet, size), group, 0, ec);
+                    for (int i = 0; i < 10 && running; ++i)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                }
+            }
+    };
+
+    /**
+     * @brief 旧的缓冲池 全局 pool_allocator + 每个缓冲一个 shared_ptr 控制块 获取与归还时清零
+     *        仅用于与 BufferPool 对比
+     */
+    class LegacyBufferPool {
+        struct BufferPro {
+            std::array<char, 1472> data{};
+            size_t length;
+            BufferPro () : length(0) { std::memset(data.data(), 0x00, data.size()); }
+        };
+        public:
+            static std::shared_ptr<std::array<char, 1472>> getBuffer (const size_t length) {
+                BufferPro *buffer = boost::pool_allocator<BufferPro>::allocate(1);
+                new(buffer) BufferPro();
+                buffer->length = length;
+                std::memset(buffer->data.data(), 0x00, buffer->data.size());
+                auto deleter = [](std::array<char, 1472> *ptr) {
+                    auto *buffer_ = reinterpret_cast<BufferPro*>(ptr);
+                    std::memset(buffer_->data.data(), 0x00, buffer_->length);
+                    buffer_->~BufferPro();
+                    boost::pool_allocator<BufferPro>::deallocate(buffer_, 1);
+                };
+                return {&buffer->data, deleter};
+            }
+    };
+
+    /**
+     * @brief 旧的 CSV 写入 (原 test.cpp 中的 FastFileWriter) 每个值 to_chars 后逐字节复制
+     *        仅用于与 SeriesWriter 对比
+     */
+    class LegacyCsvWriter {
+        public:
+            explicit LegacyCsvWriter (const std::string &filename, const std::size_t bufferSize = 1 << 16)
+                : bufferSize_(bufferSize), buffer_(new char[bufferSize]), pos_(0) {
+                file_ = std::fopen(filename.c_str(), "wb");
+                if (!file_) {
+                    throw std::runtime_error("Failed to open file: " + filename);
+                }
+            }
+            void write (float v) {
+                char buf[32];
+                auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed, 3);
+                writeRaw(buf, static_cast<std::size_t>(ptr - buf));
+                writeRaw(',');
+            }
+            void write (std::span<const float> v) {
+                for (float x : v)
+                    write(x);
+            }
+            void newline () {
+                writeRaw('\n');
+            }
+            void flush () {
+                if (pos_ > 0) {
+                    std::fwrite(buffer_, 1, pos_, file_);
+                    pos_ = 0;
+                }
+            }
+            ~LegacyCsvWriter () {
+                if (file_) {
+                    flush();
+                    std::fclose(file_);
+                }
+                delete[] buffer_;
+            }
+        private:
+            void writeRaw (char c) {
+                buffer_[pos_++] = c;
+                if (pos_ == bufferSize_) {
+                    flush();
+                }
+            }
+            void writeRaw (const char *data, std::size_t len) {
+                for (std::size_t i = 0; i < len; ++i) {
+                    writeRaw(data[i]);
+                }
+            }
+            std::FILE *file_{nullptr};
+            std::size_t bufferSize_;
+            char *buffer_;
+            std::size_t pos_;
+    };
+
+    /**
+     * @brief 等待 XPlaneUdp 收到信标
+     */
+    inline bool waitConnected (const std::atomic<bool> &connected, const std::chrono::milliseconds timeout) {
+        const auto deadline = Clock::now() + timeout;
+        while (!connected) {
+            if (Clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+    /**
+     * @brief 设置连接回调
+     * @return 由回调更新的连接状态
+     */
+    inline std::shared_ptr<std::atomic<bool>> watchConnection (XPlaneUdp &xp) {
+        auto connected = std::make_shared<std::atomic<bool>>(false);
+        xp.setCallback([connected](const bool state) { *connected = state; });
+        return connected;
+    }
+
+    /**
+     * @brief 等待 XPlaneUdp 收到信标 超时则打印提示
+     */
+    inline bool waitBeacon (const std::atomic<bool> &connected) {
+        if (waitConnected(connected, std::chrono::seconds(5)))
+            return true;
+        fprintf(stderr, "no beacon received, is multicast loopback available?\n");
+        return false;
+    }
+
+    /**
+     * @brief 设置连接回调后构造信标源 (FakeBeacon 或 FakeXPlane) 并等待 XPlaneUdp 收到信标
+     * @param args 信标源的构造参数
+     * @return 信标源 超时则为空
+     */
+    template <typename Source, typename... Args>
+    std::unique_ptr<Source> startBeacon (XPlaneUdp &xp, Args&&... args) {
+        const auto connected = watchConnection(xp);
+        auto source = std::make_unique<Source>(std::forward<Args>(args)...);
+        return waitBeacon(*connected) ? std::move(source) : nullptr;
+    }
+
+    inline double median (std::vector<double> samples) {
+        if (samples.empty())
+            return 0;
+        std::ranges::sort(samples);
+        return samples[samples.size() / 2];
+    }
+}
+
+#endif
@@ -0,0 +1,368 @@
+#ifndef XPLANEUDP_FAKE_XPLANE_HPP
+#define XPLANEUDP_FAKE_XPLANE_HPP
+
+#include "../XPlaneUDP.hpp"
+#include "BenchCommon.hpp"
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <set>
+#include <numbers>
+#include <thread>
+#include <vector>
+
+// 本机模拟的 XPlane: 多播 BECN 信标, 接收 RREF/DREF/RPOS/DSEL/USEL 请求, 按设定帧率回复 RREF/RPOS/DATA
+// 特殊 dataref 用于基准测试:
+//   xpudp/bench/send_time_lo, xpudp/bench/send_time_hi  本帧开始发送时刻(steady_clock 微秒, 低20位/高位)
+//   xpudp/bench/frame                                    帧序号(对 2^24 取模), 用于统计丢失
+// 特殊 dataref 总是放在一帧的最后一个数据包, 因此测得的是整帧到达的延迟
+
+namespace bench {
+    static const std::string SEND_TIME_LO{"xpudp/bench/send_time_lo"};
+    static const std::string SEND_TIME_HI{"xpudp/bench/send_time_hi"};
+    static const std::string FRAME_COUNTER{"xpudp/bench/frame"};
+
+    /**
+     * @brief 由两个 float 还原发送时刻
+     */
+    inline std::chrono::steady_clock::time_point decodeSendTime (const float lo, const float hi) {
+        const auto us = (static_cast<int64_t>(hi) << 20) + static_cast<int64_t>(lo);
+        return std::chrono::steady_clock::time_point(std::chrono::microseconds(us));
+    }
+
+    class FakeXPlane {
+        public:
+            struct Options {
+                unsigned short port{0}; // 0 为随机端口
+                double frameRate{60}; // 模拟帧率 RREF/RPOS 的最高频率
+                double beaconRate{1}; // 信标频率
+                size_t maxPairs{183}; // 每个 RREF 包最多包含的值
+            };
+            struct Counters {
+                std::atomic<uint64_t> frames{0};
+                std::atomic<uint64_t> rrefPackets{0};
+                std::atomic<uint64_t> rposPackets{0};
+                std::atomic<uint64_t> dataPackets{0};
+                std::atomic<uint64_t> values{0}; // RREF 与 DATA 中的值
+                std::atomic<uint64_t> requests{0}; // 收到的 RREF/RPOS/DSEL/USEL 请求
+                std::atomic<uint64_t> writes{0}; // 收到的 DREF
+            };
+
+            FakeXPlane () : FakeXPlane(Options{}) {}
+            explicit FakeXPlane (const Options &options)
+                : opts(options), socket(context, ip::udp::endpoint(ip::udp::v4(), options.port)),
+                  beaconSocket(context, ip::udp::v4()), frameTimer(context), beaconTimer(context) {
+                socket.set_option(asio::socket_base::send_buffer_size(4 << 20));
+                socket.set_option(asio::socket_base::receive_buffer_size(4 << 20)); // 容纳订阅时的突发请求
+                beaconSocket.set_option(ip::multicast::enable_loopback(true));
+                start = std::chrono::steady_clock::now();
+                asio::co_spawn(context, receive(), asio::detached);
+                asio::co_spawn(context, frames(), asio::detached);
+                asio::co_spawn(context, beacon(), asio::detached);
+                worker = std::thread([this] () { context.run(); });
+            }
+            ~FakeXPlane () {
+                context.stop();
+                worker.join();
+            }
+            FakeXPlane (const FakeXPlane &) = delete;
+            FakeXPlane& operator= (const FakeXPlane &) = delete;
+
+            [[nodiscard]] unsigned short port () const { return socket.local_endpoint().port(); }
+            [[nodiscard]] const Counters& counters () const { return stats; }
+            /**
+             * @brief 最近一次 DREF 写入的值
+             * @return 是否写入过
+             */
+            bool written (const std::string &name, float &value) const {
+                if (!hasWrites.load(std::memory_order_acquire))
+                    return false;
+                std::lock_guard lock(writtenMutex);
+                const auto it = writtenValues.find(name);
+                if (it == writtenValues.end())
+                    return false;
+                value = it->second;
+                return true;
+            }
+        private:
+            struct Subscription {
+                std::string name;
+                int32_t freq;
+                double due; // 下次发送时刻 秒
+            };
+            struct Client {
+                ip::udp::endpoint endpoint;
+                std::map<int32_t, Subscription> subscriptions; // 按 index
+                int rposFreq{0};
+                double rposDue{0};
+                std::set<int32_t> groups; // DSEL 选择的 DATA 组 每帧发送
+            };
+
+            Options opts;
+            asio::io_context context;
+            ip::udp::socket socket;
+            ip::udp::socket beaconSocket;
+            asio::steady_timer frameTimer;
+            asio::steady_timer beaconTimer;
+            std::thread worker;
+            std::chrono::steady_clock::time_point start;
+            std::vector<Client> clients; // 仅 io 线程访问
+            Counters stats;
+            mutable std::mutex writtenMutex;
+            std::map<std::string, float> writtenValues;
+            std::atomic<bool> hasWrites{false};
+            std::array<char, 1472> sendBuffer{};
+            // 模拟飞行状态
+            double lon{121.8}, lat{31.1}, heading{90};
+
+            [[nodiscard]] double seconds () const {
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+
+            Client& client (const ip::udp::endpoint &endpoint) {
+                for (auto &c : clients) {
+                    if (c.endpoint == endpoint)
+                        return c;
+                }
+                return clients.emplace_back(Client{.endpoint = endpoint});
+            }
+
+            asio::awaitable<void> receive () {
+                std::array<char, 1472> buffer{};
+                ip::udp::endpoint sender;
+                sys::error_code ec;
+                while (true) {
+                    const size_t size = co_await socket.async_receive_from(
+                        asio::buffer(buffer), sender, asio::redirect_error(asio::use_awaitable, ec));
+                    if (ec == asio::error::operation_aborted)
+                        co_return;
+                    if (ec || size < HEADER_LENGTH)
+                        continue;
+                    const std::string_view head(buffer.data(), 4);
+                    if (head == "RREF" && size >= HEADER_LENGTH + 8) {
+                        int32_t freq, index;
+                        unpack(buffer, HEADER_LENGTH, freq, index);
+                        std::string name(buffer.data() + HEADER_LENGTH + 8,
+                                         strnlen(buffer.data() + HEADER_LENGTH + 8, size - HEADER_LENGTH - 8));
+                        auto &subscriptions = client(sender).subscriptions;
+                        if (freq <= 0)
+                            subscriptions.erase(index);
+                        else
+                            subscriptions[index] = Subscription{std::move(name), freq, seconds()};
+                        stats.requests.fetch_add(1, std::memory_order_relaxed);
+                    } else if (head == "DREF" && size >= HEADER_LENGTH + 4) {
+                        float value;
+                        unpack(buffer, HEADER_LENGTH, value);
+                        std::string name(buffer.data() + HEADER_LENGTH + 4,
+                                         strnlen(buffer.data() + HEADER_LENGTH + 4, size - HEADER_LENGTH - 4));
+                        std::lock_guard lock(writtenMutex);
+                        writtenValues[name] = value;
+                        hasWrites.store(true, std::memory_order_release);
+                        stats.writes.fetch_add(1, std::memory_order_relaxed);
+                    } else if ((head == "DSEL" || head == "USEL") && (size - HEADER_LENGTH) % 4 == 0) {
+                        auto &groups = client(sender).groups;
+                        for (size_t offset = HEADER_LENGTH; offset < size; offset += 4) {
+                            int32_t group;
+                            unpack(buffer, offset, group);
+                            if (head == "DSEL")
+                                groups.insert(group);
+                            else
+                                groups.erase(group);
+                        }
+                        stats.requests.fetch_add(1, std::memory_order_relaxed);
+                    } else if (head == "RPOS") {
+                        auto &c = client(sender);
+                        c.rposFreq = std::atoi(std::string(buffer.data() + HEADER_LENGTH, size - HEADER_LENGTH).c_str());
+                        c.rposDue = seconds();
+                        stats.requests.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            asio::awaitable<void> beacon () {
+                const std::string name{"fake-xplane"};
+                std::array<char, 64> packet{};
+                const size_t size = pack(packet, 0, BECON_HEAD, uint8_t{1}, uint8_t{2}, int32_t{1}, int32_t{120000},
+                                         uint32_t{1}, port(), name, '\x00');
+                const ip::udp::endpoint group(ip::make_address("239.255.1.1"), 49707);
+                const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(1.0 / opts.beaconRate));
+                sys::error_code ec;
+                while (true) {
+                    beaconSocket.send_to(asio::buffer(packet, size), group, 0, ec);
+                    beaconTimer.expires_after(period);
+                    co_await beaconTimer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+                    if (ec)
+                        co_return;
+                }
+            }
+
+            asio::awaitable<void> frames () {
+                const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(1.0 / opts.frameRate));
+                auto next = std::chrono::steady_clock::now();
+                sys::error_code ec;
+                while (true) {
+                    next += period;
+                    frameTimer.expires_at(next);
+                    co_await frameTimer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+                    if (ec)
+                        co_return;
+                    frame();
+                }
+            }
+
+            /**
+             * @brief 模拟一帧: 向每个客户端发送到期的 dataref 与基本信息
+             */
+            void frame () {
+                const auto sendTime = std::chrono::steady_clock::now();
+                const double t = seconds();
+                const double period = 1.0 / opts.frameRate;
+                const uint64_t frameIndex = stats.frames.fetch_add(1, std::memory_order_relaxed);
+                advancePlane(period);
+                for (auto &c : clients) {
+                    size_t size = pack(sendBuffer, 0, DATAREF_GET_HEAD);
+                    size_t pairs = 0;
+                    std::vector<std::pair<int32_t, float>> specials;
+                    for (auto &[index, sub] : c.subscriptions) {
+                        if (t + period * 0.5 < sub.due)
+                            continue;
+                        sub.due = std::max(sub.due + 1.0 / sub.freq, t);
+                        float value;
+                        if (sub.name == SEND_TIME_LO || sub.name == SEND_TIME_HI || sub.name == FRAME_COUNTER) {
+                            const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                sendTime.time_since_epoch()).count();
+                            if (sub.name == SEND_TIME_LO)
+                                value = static_cast<float>(us & 0xFFFFF);
+                            else if (sub.name == SEND_TIME_HI)
+                                value = static_cast<float>(us >> 20);
+                            else
+                                value = static_cast<float>(frameIndex & 0xFFFFFF);
+                            specials.emplace_back(index, value);
+                            continue;
+                        }
+                        if (!written(sub.name, value))
+                            value = static_cast<float>(std::sin(t + index * 0.1));
+                        size = pack(sendBuffer, size, index, value);
+                        if (++pairs == opts.maxPairs) {
+                            sendTo(c.endpoint, size);
+                            size = HEADER_LENGTH;
+                            pairs = 0;
+                        }
+                    }
+                    for (const auto &[index, value] : specials) {
+                        if (pairs == opts.maxPairs) {
+                            sendTo(c.endpoint, size);
+                            size = HEADER_LENGTH;
+                            pairs = 0;
+                        }
+                        size = pack(sendBuffer, size, index, value);
+                        ++pairs;
+                    }
+                    if (pairs != 0)
+                        sendTo(c.endpoint, size);
+                    if (!c.groups.empty())
+                        sendGroups(c.endpoint, c.groups, t);
+                    // 基本信息
+                    if (c.rposFreq > 0 && t + period * 0.5 >= c.rposDue) {
+                        c.rposDue = std::max(c.rposDue + 1.0 / c.rposFreq, t);
+                        sendPlaneInfo(c.endpoint);
+                    }
+                }
+            }
+
+            void sendTo (const ip::udp::endpoint &endpoint, const size_t size) {
+                sys::error_code ec;
+                socket.send_to(asio::buffer(sendBuffer, size), endpoint, 0, ec);
+                stats.rrefPackets.fetch_add(1, std::memory_order_relaxed);
+                stats.values.fetch_add((size - HEADER_LENGTH) / 8, std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief 发送 DATA 每组 36 字节 第 k 列为 sin(t + 组 * 0.1 + k * 0.01) 每包最多 40 组
+             */
+            void sendGroups (const ip::udp::endpoint &endpoint, const std::set<int32_t> &groups, const double t) {
+                constexpr size_t record{XPlaneUdp::GROUP_RECORD};
+                sys::error_code ec;
+                size_t size = pack(sendBuffer, 0, DATA_HEAD);
+                const auto send = [&] {
+                    socket.send_to(asio::buffer(sendBuffer, size), endpoint, 0, ec);
+                    stats.dataPackets.fetch_add(1, std::memory_order_relaxed);
+                    stats.values.fetch_add((size - HEADER_LENGTH) / record * XPlaneUdp::GROUP_WIDTH,
+                                           std::memory_order_relaxed);
+                    size = HEADER_LENGTH;
+                };
+                for (const int32_t group : groups) {
+                    if (size + record > sendBuffer.size())
+                        send();
+                    size = pack(sendBuffer, size, group);
+                    for (size_t k = 0; k < XPlaneUdp::GROUP_WIDTH; ++k)
+                        size = pack(sendBuffer, size, static_cast<float>(std::sin(t + group * 0.1 + k * 0.01)));
+                }
+                send();
+            }
+
+            /**
+             * @brief 以 100m/s 3°/s 匀速转弯
+             */
+            void advancePlane (const double dt) {
+                constexpr double speed{100}, turnRate{3}, earthRadius{6371000};
+                constexpr double deg = std::numbers::pi / 180;
+                heading = std::fmod(heading + turnRate * dt, 360.0);
+                lat += speed * std::cos(heading * deg) * dt / earthRadius / deg;
+                lon += speed * std::sin(heading * deg) * dt / (earthRadius * std::cos(lat * deg)) / deg;
+            }
+
+            void sendPlaneInfo (const ip::udp::endpoint &endpoint) {
+                constexpr double speed{100}, turnRate{3}, roll{25}, pitch{2};
+                constexpr double deg = std::numbers::pi / 180;
+                // 定常转弯 航向变化率换算为机体角速度
+                const double psiRate = turnRate * deg;
+                XPlaneUdp::PlaneInfo info{
+                    .lon = lon, .lat = lat, .alt = 1000, .agl = 1000, .pitch = pitch,
+                    .track = static_cast<float>(heading), .roll = roll,
+                    .vX = static_cast<float>(speed * std::sin(heading * deg)), .vY = 0,
+                    .vZ = static_cast<float>(-speed * std::cos(heading * deg)),
+                    .rollRate = static_cast<float>(-psiRate * std::sin(pitch * deg)),
+                    .pitchRate = static_cast<float>(psiRate * std::sin(roll * deg) * std::cos(pitch * deg)),
+                    .yawRate = static_cast<float>(psiRate * std::cos(roll * deg) * std::cos(pitch * deg))
+                };
+                std::array<char, HEADER_LENGTH + sizeof(XPlaneUdp::PlaneInfo)> packet{'R', 'P', 'O', 'S', '4'};
+                std::memcpy(packet.data() + HEADER_LENGTH, &info, sizeof(info));
+                sys::error_code ec;
+                socket.send_to(asio::buffer(packet), endpoint, 0, ec);
+                stats.rposPackets.fetch_add(1, std::memory_order_relaxed);
+            }
+    };
+
+    /**
+     * @brief 已收到本机 FakeXPlane 信标的 XPlaneUdp
+     */
+    struct Connection {
+        std::unique_ptr<XPlaneUdp> xp;
+        std::shared_ptr<std::atomic<bool>> connected; // 由 xp 的连接回调更新
+        std::unique_ptr<FakeXPlane> xplane; // 先于 xp 析构
+
+        explicit operator bool () const { return xplane != nullptr; }
+    };
+
+    /**
+     * @brief 创建 XPlaneUdp 后启动 FakeXPlane 并等待连接
+     * @param options FakeXPlane 设置
+     * @param args XPlaneUdp 的构造参数
+     * @return 超时则打印提示 xplane 为空
+     */
+    template <typename... Args>
+    Connection connect (const FakeXPlane::Options &options, Args&&... args) {
+        Connection result;
+        result.xp = std::make_unique<XPlaneUdp>(std::forward<Args>(args)...);
+        result.connected = watchConnection(*result.xp);
+        result.xplane = std::make_unique<FakeXPlane>(options);
+        if (!waitBeacon(*result.connected))
+            result.xplane.reset();
+        return result;
+    }
+}
+
+#endif
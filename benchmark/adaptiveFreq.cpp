@@ -0,0 +1,135 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+
+using namespace std;
+
+// 自适应频率: 与 test.cpp 相同按 60 Hz 订阅 datarefs 个 dataref, 消费者以 5 Hz 读取, 其中 hot 个以 60 Hz 读取
+// 先不启用, 再 enableAdaptiveFreq 并每秒 adaptFreq, 比较每秒接收的 RREF 数据包、值与字节,
+// 消费者读到的值是否比上次读取时变化 (hot 的变化比例越接近 1 越好), 以及 getAdaptiveReport 的估算
+// 最后 1..readers 个线程同时循环读取相同的 hot 个 dataref, 比较启用与未启用时每次 getDataref 的耗时
+// 用法: adaptiveFreqBenchmark [datarefs=200] [hot=10] [seconds=5] [readers=4]
+
+struct Result {
+    double packets{0}, values{0}, bytes{0}; // 每秒接收
+    double hotFresh{0}; // hot 读取时值已变化的比例
+    double coldFresh{0};
+};
+
+int main (const int argc, char *argv[]) {
+    const int count = argc > 1 ? std::atoi(argv[1]) : 200;
+    const int hot = argc > 2 ? std::atoi(argv[2]) : 10;
+    const int seconds = argc > 3 ? std::atoi(argv[3]) : 5;
+    const int readers = argc > 4 ? std::atoi(argv[4]) : 4;
+
+    const auto session = bench::connect({.frameRate = 120});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    std::vector<XPlaneUdp::DatarefIndex> refs;
+    for (int i = 0; i < count; ++i)
+        refs.push_back(xp.addDataref(std::format("xpudp/bench/adaptive_{}", i), 60));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    // 消费者 每 1/60 秒读取 hot 个 每 12 次读取全部
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> hotReads{0}, hotChanged{0}, coldReads{0}, coldChanged{0};
+    std::thread consumer([&] {
+        std::vector<float> last(refs.size(), std::nanf(""));
+        auto next = bench::Clock::now();
+        for (uint64_t tick = 0; running; ++tick) {
+            const size_t end = tick % 12 == 0 ? refs.size() : std::min<size_t>(hot, refs.size());
+            for (size_t i = 0; i < end; ++i) {
+                float value;
+                xp.getDataref(refs[i], value);
+                const bool changed = value != last[i];
+                last[i] = value;
+                auto &reads = i < static_cast<size_t>(hot) ? hotReads : coldReads;
+                auto &fresh = i < static_cast<size_t>(hot) ? hotChanged : coldChanged;
+                reads.fetch_add(1, std::memory_order_relaxed);
+                fresh.fetch_add(changed, std::memory_order_relaxed);
+            }
+            next += std::chrono::microseconds(1'000'000 / 60);
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    const auto measure = [&](const bool adapt) {
+        // 先调整一段时间再统计
+        for (int i = 0; adapt && i < 3; ++i) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            xp.adaptFreq();
+        }
+        const auto before = xp.getStats();
+        const uint64_t hot0 = hotReads, hotChanged0 = hotChanged, cold0 = coldReads, coldChanged0 = coldChanged;
+        for (int i = 0; i < seconds; ++i) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (adapt)
+                xp.adaptFreq();
+        }
+        const auto after = xp.getStats();
+        Result result;
+        result.packets = static_cast<double>(after.packetsReceived[XPlaneStats::RREF] -
+                                             before.packetsReceived[XPlaneStats::RREF]) / seconds;
+        result.bytes = static_cast<double>(after.bytesReceived[XPlaneStats::RREF] -
+                                           before.bytesReceived[XPlaneStats::RREF]) / seconds;
+        result.values = (result.bytes - result.packets * HEADER_LENGTH) / 8;
+        result.hotFresh = static_cast<double>(hotChanged - hotChanged0) / static_cast<double>(
+                              std::max<uint64_t>(1, hotReads - hot0));
+        result.coldFresh = static_cast<double>(coldChanged - coldChanged0) / static_cast<double>(
+                               std::max<uint64_t>(1, coldReads - cold0));
+        return result;
+    };
+    const auto fixed = measure(false);
+    xp.enableAdaptiveFreq({.minFreq = 1, .maxFreq = 120});
+    const auto adaptive = measure(true);
+    const auto report = xp.getAdaptiveReport();
+    running = false;
+    consumer.join();
+
+    // 读取开销 threads 个线程各自循环读取 hot 个 dataref 0.5 s 返回每次读取的平均耗时 (ns)
+    const auto readCost = [&](const int threads) {
+        std::atomic<bool> reading{true};
+        std::atomic<uint64_t> reads{0};
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t)
+            pool.emplace_back([&] {
+                uint64_t local{0};
+                float value;
+                while (reading.load(std::memory_order_relaxed))
+                    for (int i = 0; i < std::max(hot, 1); ++i, ++local)
+                        xp.getDataref(refs[i % refs.size()], value);
+                reads.fetch_add(local, std::memory_order_relaxed);
+            });
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        reading = false;
+        for (auto &thread: pool)
+            thread.join();
+        return 500e6 * threads / static_cast<double>(std::max<uint64_t>(1, reads));
+    };
+    std::vector<std::pair<double, double>> costs; // 启用, 未启用
+    for (int threads = 1; threads <= readers; ++threads)
+        costs.emplace_back(readCost(threads), 0);
+    xp.disableAdaptiveFreq();
+    for (int threads = 1; threads <= readers; ++threads)
+        costs[threads - 1].second = readCost(threads);
+
+    printf("%d datarefs subscribed at 60 Hz, %d read at 60 Hz, the rest at 5 Hz, %d s\n", count, hot, seconds);
+    printf("  %-22s %10s %10s %12s %10s %10s\n", "", "packets/s", "values/s", "bytes/s", "hot fresh", "cold fresh");
+    const auto print = [](const char *name, const Result &result) {
+        printf("  %-22s %10.0f %10.0f %12.0f %9.0f%% %9.0f%%\n", name, result.packets, result.values, result.bytes,
+               result.hotFresh * 100, result.coldFresh * 100);
+    };
+    print("fixed 60 Hz", fixed);
+    print("adaptive 1-120 Hz", adaptive);
+    printf("  report: %zu refs, %llu changes (%llu request bytes), %.0f -> %.0f values/s, %.0f bytes/s saved\n",
+           report.refs, static_cast<unsigned long long>(report.changes),
+           static_cast<unsigned long long>(report.requestBytes), report.requestedValues, report.currentValues,
+           report.savedBytes);
+    printf("  getDataref on the same %d refs, ns per read\n", std::max(hot, 1));
+    printf("  %-22s %10s %10s %10s\n", "threads", "fixed", "adaptive", "extra");
+    for (size_t i = 0; i < costs.size(); ++i)
+        printf("  %-22zu %10.1f %10.1f %10.1f\n", i + 1, costs[i].second, costs[i].first,
+               costs[i].first - costs[i].second);
+    return 0;
+}
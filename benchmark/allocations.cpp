@@ -0,0 +1,151 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// 堆分配计数: 替换全局 operator new, 只统计标记过的线程
+// 1. 缓冲池获取/归还: 旧 LegacyBufferPool 与 BufferPool 的每次分配次数与耗时
+// 2. 稳态收发: 连接进程内的 fakeXPlane, 统计 io 线程与写入线程每个数据包的堆分配
+
+static std::atomic<uint64_t> allocations{0};
+static thread_local bool tracked{false};
+
+static void* countedAlloc (const std::size_t size) {
+    if (tracked)
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+static void* countedAlignedAlloc (const std::size_t size, const std::align_val_t align) {
+    if (tracked)
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto alignment = static_cast<std::size_t>(align);
+    if (void *ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new (const std::size_t size) { return countedAlloc(size); }
+void* operator new[] (const std::size_t size) { return countedAlloc(size); }
+void* operator new (const std::size_t size, const std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void* operator new[] (const std::size_t size, const std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void operator delete (void *ptr) noexcept { std::free(ptr); }
+void operator delete[] (void *ptr) noexcept { std::free(ptr); }
+void operator delete (void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[] (void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete (void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[] (void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete (void *ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[] (void *ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+static constexpr int POOL_ROUNDS{1000000};
+static constexpr int POOL_THREADS{4};
+
+/**
+ * @brief 每轮获取 8 个缓冲后全部归还
+ * @return 每次获取的平均耗时 ns 与分配次数
+ */
+template <typename Get>
+static std::pair<double, double> poolRound (Get &&get, const int threads) {
+    const uint64_t before = allocations.load();
+    const auto t0 = bench::Clock::now();
+    vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&get] () {
+            tracked = true;
+            for (int i = 0; i < POOL_ROUNDS / 8; ++i) {
+                auto a = get(), b = get(), c = get(), d = get();
+                auto e = get(), f = get(), g = get(), h = get();
+                (*a)[0] = (*h)[0] = 1;
+            }
+            tracked = false;
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    const double ns = std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count();
+    const double total = static_cast<double>(POOL_ROUNDS) * threads;
+    return {ns / POOL_ROUNDS, static_cast<double>(allocations.load() - before) / total};
+}
+
+static void poolBenchmark () {
+    BufferPool pool;
+    auto legacyGet = [] { return bench::LegacyBufferPool::getBuffer(413); };
+    auto poolGet = [&pool] { return pool.getBuffer(413); };
+    poolRound(legacyGet, 1); // 预热
+    poolRound(poolGet, 1);
+    printf("buffer pool, %d acquire/release per thread\n", POOL_ROUNDS);
+    printf("  %-28s %8s %14s %14s\n", "", "threads", "ns/acquire", "allocs/acquire");
+    for (const int threads : {1, POOL_THREADS}) {
+        const auto [legacyNs, legacyAllocs] = poolRound(legacyGet, threads);
+        const auto [poolNs, poolAllocs] = poolRound(poolGet, threads);
+        printf("  %-28s %8d %14.1f %14.3f\n", "pool_allocator + shared_ptr", threads, legacyNs, legacyAllocs);
+        printf("  %-28s %8d %14.1f %14.3f\n", "BufferPool", threads, poolNs, poolAllocs);
+    }
+    const auto report = pool.report();
+    printf("  pool capacity %zu, high water %zu, in use %zu, overflow %llu\n", report.capacity, report.highWater,
+           report.inUse, static_cast<unsigned long long>(report.overflow));
+}
+
+static int steadyState (const int seconds) {
+    const auto session = bench::connect({.frameRate = 200});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    xp.addDatarefArray("xpudp/bench/load", 1000, 200);
+    xp.addPlaneInfo(200);
+    std::atomic<bool> measuring{false};
+    xp.setUpdateCallback([&measuring](std::span<const XPlaneUdp::DatarefIndex>, bool) {
+        tracked = measuring.load(std::memory_order_relaxed); // 在 io 线程内切换统计
+    });
+    std::this_thread::sleep_for(std::chrono::seconds(1)); // 预热: 订阅生效 各缓冲增长到稳定大小
+
+    std::atomic<bool> writing{true};
+    std::atomic<uint64_t> writes{0};
+    std::thread writer([&] () {
+        const std::string name{"xpudp/bench/write"}; // 标量 名称无需格式化
+        while (writing) {
+            tracked = measuring.load(std::memory_order_relaxed);
+            xp.setDataref(name, static_cast<float>(writes.fetch_add(1)));
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        tracked = false;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    const auto before = xp.getStats();
+    const uint64_t writesBefore = writes.load();
+    const uint64_t allocsBefore = allocations.load();
+    measuring = true;
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    measuring = false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const uint64_t allocs = allocations.load() - allocsBefore;
+    const auto after = xp.getStats();
+    writing = false;
+    writer.join();
+
+    uint64_t received{0};
+    for (size_t i = 0; i < XPlaneStats::TYPE_COUNT; ++i)
+        received += after.packetsReceived[i] - before.packetsReceived[i];
+    const uint64_t sent = writes.load() - writesBefore;
+    const auto steady = xp.getPoolReport();
+    printf("steady state for %d s: 1000 datarefs + RPOS at 200 Hz, scalar setDataref every 0.5 ms\n", seconds);
+    printf("  packets received %llu, setDataref calls %llu, heap allocations %llu (%.4f per packet)\n",
+           static_cast<unsigned long long>(received), static_cast<unsigned long long>(sent),
+           static_cast<unsigned long long>(allocs),
+           static_cast<double>(allocs) / static_cast<double>(std::max<uint64_t>(received + sent, 1)));
+    printf("  send pool capacity %zu, high water %zu, in use %zu, acquired %llu\n", steady.capacity,
+           steady.highWater, steady.inUse, static_cast<unsigned long long>(steady.acquired));
+    return 0;
+}
+
+int main (const int argc, char *argv[]) {
+    const int seconds = argc > 1 ? std::atoi(argv[1]) : 3;
+    poolBenchmark();
+    return steadyState(seconds);
+}
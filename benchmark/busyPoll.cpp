@@ -0,0 +1,90 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+#include <ctime>
+
+using namespace std;
+
+// 忙轮询接收: 本机模拟 XPlane 按帧率发送, 普通模式 (等待 epoll 唤醒) 与 enableBusyPoll 的
+// 整帧从发送到值可读 (更新回调) 的延迟分位数, 以及进程 CPU 占用
+// cpu >= 0 时 io 线程绑定该核, priority > 0 时设置 SCHED_FIFO (需要权限, 单核时会饿死发送线程)
+// 用法: busyPollBenchmark [datarefs=100] [rate=250] [seconds=5] [cpu=-1] [priority=0]
+
+struct Result {
+    vector<double> latencies; // us
+    double cpu{0}; // 进程 CPU 时间 / 墙上时间
+};
+
+/**
+ * @param target 更新回调写入的结果 仅在 io 线程访问 为空时不记录
+ */
+static Result measure (std::atomic<Result*> &target, const double rate, const int seconds) {
+    Result result;
+    result.latencies.reserve(static_cast<size_t>(rate * seconds * 2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    const std::clock_t cpu0 = std::clock();
+    target.store(&result, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    target.store(nullptr, std::memory_order_release);
+    const std::clock_t cpu1 = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // 等待正在进行的回调
+    result.cpu = static_cast<double>(cpu1 - cpu0) / CLOCKS_PER_SEC / seconds;
+    std::ranges::sort(result.latencies);
+    return result;
+}
+
+int main (const int argc, char *argv[]) {
+    const int count = argc > 1 ? std::atoi(argv[1]) : 100;
+    const double rate = argc > 2 ? std::atof(argv[2]) : 250;
+    const int seconds = argc > 3 ? std::atoi(argv[3]) : 5;
+    const int cpu = argc > 4 ? std::atoi(argv[4]) : -1;
+    const int priority = argc > 5 ? std::atoi(argv[5]) : 0;
+
+    const auto session = bench::connect({.frameRate = rate});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    const auto freq = static_cast<int32_t>(rate);
+    const auto lo = xp.addDataref(bench::SEND_TIME_LO, freq);
+    const auto hi = xp.addDataref(bench::SEND_TIME_HI, freq);
+    const auto frame = xp.addDataref(bench::FRAME_COUNTER, freq);
+    xp.addDatarefArray("xpudp/bench/load", count, freq);
+    std::atomic<Result*> target{nullptr};
+    xp.setUpdateCallback([&](const std::span<const XPlaneUdp::DatarefIndex> updated, const bool infoUpdated) {
+        Result *result = target.load(std::memory_order_acquire);
+        if (infoUpdated || result == nullptr)
+            return;
+        if (std::ranges::find_if(updated, [&](const auto &ref) { return ref.getIdx() == frame.getIdx(); }) ==
+            updated.end())
+            return;
+        const auto now = bench::Clock::now();
+        float loValue, hiValue;
+        xp.getDataref(lo, loValue);
+        xp.getDataref(hi, hiValue);
+        result->latencies.push_back(
+            std::chrono::duration<double, std::micro>(now - bench::decodeSendTime(loValue, hiValue)).count());
+    });
+
+    const auto normal = measure(target, rate, seconds);
+    const auto report = xp.enableBusyPoll({.cpu = cpu, .fifoPriority = priority});
+    const auto busy = measure(target, rate, seconds);
+    xp.disableBusyPoll();
+
+    const auto print = [](const char *name, const Result &result) {
+        const auto &samples = result.latencies;
+        const auto percentile = [&samples](const double p) {
+            return samples.empty() ? 0.0 : samples[static_cast<size_t>(p * static_cast<double>(samples.size() - 1))];
+        };
+        printf("  %-12s %8zu %10.1f %10.1f %10.1f %10.1f %8.0f%%\n", name, samples.size(), percentile(0.5),
+               percentile(0.99), percentile(0.999), percentile(1.0), result.cpu * 100);
+    };
+    printf("receive to visible: %d datarefs at %.0f Hz for %d s, %u cores\n", count + 3, rate, seconds,
+           std::thread::hardware_concurrency());
+    printf("  busy poll: SO_BUSY_POLL %s, pinned %s, SCHED_FIFO %s\n", report.socketBusyPoll ? "yes" : "no",
+           report.pinned ? std::format("cpu {}", cpu).c_str() : "no",
+           report.realtime ? std::format("{}", priority).c_str() : "no");
+    printf("  %-12s %8s %10s %10s %10s %10s %9s\n", "", "frames", "p50 us", "p99 us", "p99.9 us", "max us", "cpu");
+    print("epoll wait", normal);
+    print("busy poll", busy);
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+#include <future>
+
+using namespace std;
+
+// 外部执行器与协程接口
+// fakeXPlane 以 rate 帧/秒发送帧计数器, 消费者每帧读取后写回一个 dataref (写入缓冲 每帧 flushWrites)
+// 1. 自有 io 线程 + 消费者线程 waitUpdate (条件变量唤醒)
+// 2. 外部 io_context 由一个线程运行, 协程在 getExecutor() 上 co_await nextUpdate / flushWrites(use_awaitable)
+// 3. 外部 threads 个线程的 io_context, 协程在另一个 strand 上, 每次恢复都要投递
+// 延迟为本包的更新回调到消费者恢复
+// 用法: coroutineBenchmark [rate=250] [seconds=3] [threads=2]
+
+static const std::string ECHO_REF{"xpudp/bench/echo"};
+
+struct Result {
+    std::vector<double> latency; // us
+    uint64_t writes{0};
+    int threads{0};
+};
+
+static int64_t nowNs () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench::Clock::now().time_since_epoch()).count();
+}
+
+static double percentile (std::vector<double> samples, const double p) {
+    if (samples.empty())
+        return 0;
+    std::ranges::sort(samples);
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())))];
+}
+
+static Result runThread (const double rate, const int seconds) {
+    const auto session = bench::connect({.frameRate = rate});
+    Result result{.threads = 2};
+    if (!session)
+        return result;
+    auto &xp = *session.xp;
+    const auto &xplane = *session.xplane;
+    std::atomic<int64_t> notified{0};
+    xp.setUpdateCallback([&notified](std::span<const XPlaneUdp::DatarefIndex>, bool) {
+        notified.store(nowNs(), std::memory_order_relaxed);
+    });
+    const auto frame = xp.addDataref(bench::FRAME_COUNTER, static_cast<int32_t>(rate));
+    xp.enableWriteBuffer();
+    const uint64_t before = xplane.counters().writes;
+    const auto deadline = bench::Clock::now() + std::chrono::seconds(seconds);
+    while (bench::Clock::now() < deadline) {
+        if (!xp.waitUpdate(frame, std::chrono::milliseconds(100)))
+            continue;
+        result.latency.push_back(static_cast<double>(nowNs() - notified.load(std::memory_order_relaxed)) / 1000);
+        float value;
+        xp.getDataref(frame, value);
+        xp.setDataref(ECHO_REF, value);
+        xp.flushWrites();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    result.writes = xplane.counters().writes - before;
+    return result;
+}
+
+/**
+ * @param sameStrand 协程是否与 xp 在同一 strand
+ */
+static Result runExecutor (const double rate, const int seconds, const int threads, const bool sameStrand) {
+    asio::io_context context(threads);
+    auto guard = asio::make_work_guard(context);
+    XPlaneUdp xp(context.get_executor());
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; ++i)
+        pool.emplace_back([&context] { context.run(); });
+    bench::FakeXPlane xplane({.frameRate = rate});
+    std::atomic<int64_t> notified{0};
+    xp.setUpdateCallback([&notified](std::span<const XPlaneUdp::DatarefIndex>, bool) {
+        notified.store(nowNs(), std::memory_order_relaxed);
+    });
+    const auto frame = xp.addDataref(bench::FRAME_COUNTER, static_cast<int32_t>(rate));
+    xp.enableWriteBuffer();
+
+    Result result{.threads = threads};
+    uint64_t before{0};
+    std::promise<bool> done;
+    const asio::any_io_executor executor = sameStrand ? asio::any_io_executor(xp.getExecutor())
+                                                      : asio::any_io_executor(asio::make_strand(context));
+    asio::co_spawn(executor, [&] () -> asio::awaitable<void> {
+        if (!co_await xp.waitConnected()) {
+            done.set_value(false);
+            co_return;
+        }
+        before = xplane.counters().writes;
+        const auto deadline = bench::Clock::now() + std::chrono::seconds(seconds);
+        while (bench::Clock::now() < deadline && co_await xp.nextUpdate(frame)) {
+            result.latency.push_back(static_cast<double>(nowNs() - notified.load(std::memory_order_relaxed)) / 1000);
+            float value;
+            xp.getDataref(frame, value);
+            xp.setDataref(ECHO_REF, value);
+            co_await xp.flushWrites(asio::use_awaitable);
+        }
+        done.set_value(true);
+    }, asio::detached);
+
+    auto finished = done.get_future();
+    if (finished.wait_for(std::chrono::seconds(seconds + 10)) == std::future_status::ready && finished.get()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        result.writes = xplane.counters().writes - before;
+    }
+    xp.close();
+    guard.reset();
+    for (auto &thread : pool)
+        thread.join();
+    return result;
+}
+
+int main (const int argc, char *argv[]) {
+    const double rate = argc > 1 ? std::atof(argv[1]) : 250;
+    const int seconds = argc > 2 ? std::atoi(argv[2]) : 3;
+    const int threads = argc > 3 ? std::atoi(argv[3]) : 2;
+
+    const auto print = [](const char *name, const Result &result) {
+        printf("  %-36s %8d %10zu %10llu %10.1f %10.1f\n", name, result.threads, result.latency.size(),
+               static_cast<unsigned long long>(result.writes), percentile(result.latency, 0.5),
+               percentile(result.latency, 0.99));
+    };
+    const auto thread = runThread(rate, seconds);
+    const auto same = runExecutor(rate, seconds, 1, true);
+    const auto hop = runExecutor(rate, seconds, threads, false);
+    if (thread.latency.empty() || same.latency.empty() || hop.latency.empty()) {
+        fprintf(stderr, "no updates received\n");
+        return 1;
+    }
+    printf("frame counter at %.0f Hz for %d s, read + write back every update\n", rate, seconds);
+    printf("  %-36s %8s %10s %10s %10s %10s\n", "", "threads", "updates", "DREF recv", "p50 us", "p99 us");
+    print("own thread, waitUpdate", thread);
+    print("executor, co_await on its strand", same);
+    print("executor, co_await on another strand", hop);
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+#include <ctime>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+using namespace std;
+
+// DATA 组输出与等价的 RREF 订阅: groups 组 (每组 8 个值) 以 rate 帧/秒接收
+// DATA: addDataGroup 每组一个 36 字节记录; RREF: 一个 groups * 8 个元素的数组 每个值 8 字节 每个元素一个 413 字节请求
+// 订阅请求字节, 每秒接收字节与每个值的字节, 单包解码耗时, 以及 io 线程的 CPU 占用 (外部 io_context 由一个线程运行)
+// 用法: dataGroupBenchmark [groups=20] [rate=250] [seconds=5]
+
+/**
+ * @brief 线程已使用的 CPU 时间 秒 非 Linux 为 0
+ */
+static double threadCpu (std::thread &thread) {
+#ifdef __linux__
+    clockid_t clock;
+    timespec ts{};
+    if (pthread_getcpuclockid(thread.native_handle(), &clock) != 0 || clock_gettime(clock, &ts) != 0)
+        return 0;
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+#else
+    (void)thread;
+    return 0;
+#endif
+}
+
+static Histogram::Report since (const Histogram::Report &before, const Histogram::Report &after) {
+    Histogram::Report result = after;
+    result.total = 0;
+    for (size_t i = 0; i < Histogram::BUCKETS; ++i) {
+        result.counts[i] -= before.counts[i];
+        result.total += result.counts[i];
+    }
+    return result;
+}
+
+struct Result {
+    uint64_t requestBytes{0}; // 订阅请求
+    double packetsPerSecond{0};
+    double bytesPerSecond{0};
+    double valuesPerSecond{0};
+    uint64_t decodeP50{0}; // ns 所在区间上界
+    double cpu{0}; // io 线程 CPU 时间 / 墙上时间
+    bool complete{false}; // 全部组或元素都收到
+};
+
+/**
+ * @param useGroups true 为 DATA 组 false 为等价的 RREF 数组
+ */
+static Result run (const bool useGroups, const int groups, const double rate, const int seconds) {
+    asio::io_context context(1);
+    auto guard = asio::make_work_guard(context);
+    std::thread io([&context] { context.run(); });
+    const auto session = bench::connect({.frameRate = rate}, context.get_executor());
+    auto &xp = *session.xp;
+    Result result;
+    if (session) {
+        const auto &xplane = *session.xplane;
+        const auto type = useGroups ? XPlaneStats::DATA : XPlaneStats::RREF;
+        const auto sent = useGroups ? XPlaneStats::DSEL : XPlaneStats::RREF;
+        XPlaneUdp::DatarefIndex array;
+        if (useGroups) {
+            for (int g = 0; g < groups; ++g)
+                xp.addDataGroup(g);
+        } else {
+            array = xp.addDatarefArray("xpudp/bench/group", groups * static_cast<int>(XPlaneUdp::GROUP_WIDTH),
+                                       static_cast<int32_t>(rate));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        const auto before = xp.getStats();
+        const uint64_t values0 = xplane.counters().values;
+        const double cpu0 = threadCpu(io);
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        const double cpu1 = threadCpu(io);
+        const uint64_t values1 = xplane.counters().values;
+        const auto after = xp.getStats();
+        result.requestBytes = after.bytesSent[sent];
+        result.packetsPerSecond = static_cast<double>(after.packetsReceived[type] - before.packetsReceived[type]) /
+                                  seconds;
+        result.bytesPerSecond = static_cast<double>(after.bytesReceived[type] - before.bytesReceived[type]) / seconds;
+        result.valuesPerSecond = static_cast<double>(values1 - values0) / seconds;
+        result.decodeP50 = since(before.decodeTime, after.decodeTime).percentile(0.5);
+        result.cpu = (cpu1 - cpu0) / seconds;
+        if (useGroups) {
+            result.complete = true;
+            XPlaneUdp::DataGroup row;
+            for (int g = 0; g < groups; ++g)
+                result.complete = result.complete && xp.getDataGroup(g, row);
+        } else {
+            std::vector<float> row;
+            result.complete = xp.getDataref(array, row) &&
+                              after.packetsReceived[type] > before.packetsReceived[type];
+        }
+    }
+    xp.close();
+    guard.reset();
+    io.join();
+    return result;
+}
+
+int main (const int argc, char *argv[]) {
+    const int groups = argc > 1 ? std::atoi(argv[1]) : 20;
+    const double rate = argc > 2 ? std::atof(argv[2]) : 250;
+    const int seconds = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    const auto data = run(true, groups, rate, seconds);
+    const auto rref = run(false, groups, rate, seconds);
+    if (!data.complete || !rref.complete) {
+        fprintf(stderr, "no values received\n");
+        return 1;
+    }
+    const auto print = [](const char *name, const Result &result) {
+        printf("  %-30s %10llu %10.0f %12.0f %8.2f %10llu %8.1f%% %10.1f\n", name,
+               static_cast<unsigned long long>(result.requestBytes), result.packetsPerSecond, result.bytesPerSecond,
+               result.bytesPerSecond / result.valuesPerSecond, static_cast<unsigned long long>(result.decodeP50),
+               result.cpu * 100, result.cpu * 1e9 / result.valuesPerSecond);
+    };
+    printf("%d groups (%d values) at %.0f Hz for %d s\n", groups, groups * static_cast<int>(XPlaneUdp::GROUP_WIDTH),
+           rate, seconds);
+    printf("  %-30s %10s %10s %12s %8s %10s %9s %10s\n", "", "request B", "packets/s", "bytes/s", "B/value",
+           "decode ns", "io cpu", "ns/value");
+    print("DATA groups (DSEL)", data);
+    print("RREF array, same values", rref);
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "../XPlaneUDP.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+// RREF 解码: 逐对 unpack(旧) 与 scalar / sse2 / avx2 解码核心 先校验结果一致 再测量每个数据包的耗时
+// 解码后写入 values 数组, 与 receiveDataProcess 中的写入相同
+
+static constexpr uint32_t SLOTS{4096};
+static constexpr int PACKETS{256};
+static constexpr int ROUNDS{4000};
+
+struct Packet {
+    std::array<char, 1472> data{};
+    size_t size{0};
+};
+
+/**
+ * @brief 生成数据包 invalidRate 比例的 index 为负或越界
+ */
+static std::vector<Packet> makePackets (const size_t pairs, const double invalidRate, std::mt19937 &rng) {
+    std::uniform_int_distribution<int32_t> slot(0, SLOTS - 1);
+    std::uniform_real_distribution<float> value(-1000, 1000);
+    std::bernoulli_distribution invalid(invalidRate);
+    std::vector<Packet> packets(PACKETS);
+    for (auto &packet : packets) {
+        packet.size = pack(packet.data, 0, DATAREF_GET_HEAD);
+        for (size_t i = 0; i < pairs; ++i) {
+            int32_t index = slot(rng);
+            if (invalid(rng))
+                index = (rng() & 1) ? -index - 1 : static_cast<int32_t>(SLOTS) + index;
+            packet.size = pack(packet.data, packet.size, index, value(rng));
+        }
+    }
+    return packets;
+}
+
+/**
+ * @brief 旧实现: 逐对 unpack 校验后直接写入
+ */
+static size_t legacyDecode (const Packet &packet, std::vector<float> &values) {
+    size_t count = 0;
+    for (size_t i = HEADER_LENGTH; i < packet.size; i += 8) {
+        int index;
+        float value;
+        unpack(packet.data, i, index, value);
+        if (index < 0 || static_cast<size_t>(index) >= values.size())
+            continue;
+        values[index] = value;
+        ++count;
+    }
+    return count;
+}
+
+static size_t kernelDecode (const RrefDecoder::Kernel kernel, const Packet &packet, std::vector<float> &values) {
+    std::array<int32_t, RrefDecoder::MAX_PAIRS> indices;
+    std::array<float, RrefDecoder::MAX_PAIRS> decoded;
+    const size_t count = kernel(packet.data.data() + HEADER_LENGTH, (packet.size - HEADER_LENGTH) / 8, SLOTS,
+                                indices.data(), decoded.data());
+    for (size_t i = 0; i < count; ++i)
+        values[indices[i]] = decoded[i];
+    return count;
+}
+
+/**
+ * @brief 与 scalar 逐项比较
+ */
+static bool verify (const RrefDecoder::Kernel kernel, const std::vector<Packet> &packets) {
+    for (const auto &packet : packets) {
+        const size_t pairs = (packet.size - HEADER_LENGTH) / 8;
+        std::array<int32_t, RrefDecoder::MAX_PAIRS> expectIndex{}, gotIndex{};
+        std::array<float, RrefDecoder::MAX_PAIRS> expectValue{}, gotValue{};
+        const size_t expect = RrefDecoder::scalar(packet.data.data() + HEADER_LENGTH, pairs, SLOTS,
+                                                  expectIndex.data(), expectValue.data());
+        const size_t got = kernel(packet.data.data() + HEADER_LENGTH, pairs, SLOTS, gotIndex.data(), gotValue.data());
+        if (got != expect ||
+            std::memcmp(expectIndex.data(), gotIndex.data(), got * sizeof(int32_t)) != 0 ||
+            std::memcmp(expectValue.data(), gotValue.data(), got * sizeof(float)) != 0)
+            return false;
+    }
+    return true;
+}
+
+template <typename Decode>
+static double nsPerPacket (const std::vector<Packet> &packets, std::vector<float> &values, Decode &&decode) {
+    size_t sink = 0;
+    for (const auto &packet : packets) // 预热
+        sink += decode(packet, values);
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (const auto &packet : packets)
+            sink += decode(packet, values);
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    if (sink == 0)
+        printf("nothing decoded\n");
+    return ns / (static_cast<double>(ROUNDS) * PACKETS);
+}
+
+int main () {
+    std::vector<std::pair<const char*, RrefDecoder::Kernel>> kernels{{"scalar", &RrefDecoder::scalar}};
+    if (RrefDecoder::hasSse2())
+        kernels.emplace_back("sse2", &RrefDecoder::sse2);
+    if (RrefDecoder::hasAvx2())
+        kernels.emplace_back("avx2", &RrefDecoder::avx2);
+    printf("RREF decode + store, %u slots, best kernel: %s (ns per packet)\n", SLOTS,
+           RrefDecoder::name(RrefDecoder::best()));
+    printf("  %6s %8s %10s", "pairs", "invalid", "unpack");
+    for (const auto &[name, kernel] : kernels)
+        printf(" %10s", name);
+    printf("\n");
+
+    std::mt19937 rng(42);
+    std::vector<float> values(SLOTS);
+    bool identical = true;
+    for (const size_t pairs : {1, 8, 30, 100, 183}) {
+        for (const double invalidRate : {0.0, 0.05}) {
+            const auto packets = makePackets(pairs, invalidRate, rng);
+            printf("  %6zu %7.0f%% %10.1f", pairs, invalidRate * 100,
+                   nsPerPacket(packets, values, legacyDecode));
+            for (const auto &[name, kernel] : kernels) {
+                identical = identical && verify(kernel, packets);
+                printf(" %10.1f", nsPerPacket(packets, values, [kernel](const Packet &packet, std::vector<float> &v) {
+                    return kernelDecode(kernel, packet, v);
+                }));
+            }
+            printf("\n");
+        }
+    }
+    printf("results identical to scalar: %s\n", identical ? "yes" : "NO");
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+
+using namespace std;
+
+// 端到端: 本机模拟 XPlane 按帧率发送, 测量整帧从发送到 XPlaneUdp 发布的延迟、吞吐与丢帧
+// 用法: endToEndBenchmark [datarefs=1000] [rate=60] [seconds=10]
+
+int main (const int argc, char *argv[]) {
+    const int count = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const double rate = argc > 2 ? std::atof(argv[2]) : 60;
+    const int seconds = argc > 3 ? std::atoi(argv[3]) : 10;
+
+    const auto session = bench::connect({.frameRate = rate});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    auto &xplane = *session.xplane;
+    const auto freq = static_cast<int32_t>(rate);
+    const auto lo = xp.addDataref(bench::SEND_TIME_LO, freq);
+    const auto hi = xp.addDataref(bench::SEND_TIME_HI, freq);
+    const auto frame = xp.addDataref(bench::FRAME_COUNTER, freq);
+    xp.addDatarefArray("xpudp/bench/load", count, freq);
+    xp.addPlaneInfo(freq);
+
+    // 以下仅在 io 线程访问
+    std::atomic<bool> recording{false};
+    vector<double> latencies;
+    latencies.reserve(static_cast<size_t>(rate * seconds * 2));
+    uint64_t packets{0}, frames{0}, dropped{0};
+    int64_t lastFrame{-1};
+    xp.setUpdateCallback([&](const std::span<const XPlaneUdp::DatarefIndex> updated, const bool infoUpdated) {
+        if (infoUpdated || !recording.load(std::memory_order_acquire))
+            return;
+        ++packets;
+        if (std::ranges::find_if(updated, [&](const auto &ref) { return ref.getIdx() == frame.getIdx(); }) ==
+            updated.end())
+            return;
+        const auto now = bench::Clock::now();
+        float loValue, hiValue, frameValue;
+        xp.getDataref(lo, loValue);
+        xp.getDataref(hi, hiValue);
+        xp.getDataref(frame, frameValue);
+        latencies.push_back(std::chrono::duration<double, std::micro>(now - bench::decodeSendTime(loValue, hiValue)).count());
+        const auto frameIndex = static_cast<int64_t>(frameValue);
+        if (lastFrame >= 0 && frameIndex > lastFrame + 1)
+            dropped += frameIndex - lastFrame - 1;
+        lastFrame = frameIndex;
+        ++frames;
+    });
+
+    std::this_thread::sleep_for(std::chrono::seconds(1)); // 等待订阅生效
+    const auto &stats = xplane.counters();
+    const uint64_t sentPackets = stats.rrefPackets, sentValues = stats.values;
+    recording = true;
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    recording = false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const uint64_t sent = stats.rrefPackets - sentPackets;
+    const uint64_t values = stats.values - sentValues;
+
+    std::ranges::sort(latencies);
+    auto percentile = [&latencies](const double p) {
+        return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))];
+    };
+    printf("end-to-end: %d datarefs at %.0f Hz for %d s\n", count + 3, rate, seconds);
+    printf("  frame latency (us): p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", percentile(0.5),
+           percentile(0.9), percentile(0.99), percentile(0.999), percentile(1.0));
+    printf("  frames received %llu, dropped %llu\n", static_cast<unsigned long long>(frames),
+           static_cast<unsigned long long>(dropped));
+    printf("  rref packets sent %llu, received %llu (%.0f packets/s, %.0f values/s)\n",
+           static_cast<unsigned long long>(sent), static_cast<unsigned long long>(packets),
+           static_cast<double>(packets) / seconds, static_cast<double>(values) / seconds);
+    return 0;
+}
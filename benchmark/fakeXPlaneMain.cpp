@@ -0,0 +1,46 @@
+#include "FakeXPlane.hpp"
+#include <cstdio>
+#include <cstring>
+
+// 独立运行的模拟 XPlane, 供跨进程测试使用
+// 用法: fakeXPlane [--port 49000] [--rate 60] [--max-pairs 183]
+
+int main (const int argc, char *argv[]) {
+    bench::FakeXPlane::Options options{};
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--port") == 0)
+            options.port = static_cast<unsigned short>(std::atoi(argv[i + 1]));
+        else if (std::strcmp(argv[i], "--rate") == 0)
+            options.frameRate = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--max-pairs") == 0)
+            options.maxPairs = std::clamp<size_t>(std::atoi(argv[i + 1]), 1, 183);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    bench::FakeXPlane xplane(options);
+    printf("fake X-Plane on port %u, %.1f frames/s\n", xplane.port(), options.frameRate);
+    asio::io_context context;
+    asio::signal_set signals(context, SIGINT, SIGTERM);
+    signals.async_wait([&context](const auto &, int) { context.stop(); });
+    asio::steady_timer timer(context);
+    std::function<void  (const sys::error_code &)> report = [&](const sys::error_code &ec) {
+        if (ec)
+            return;
+        const auto &stats = xplane.counters();
+        printf("frames %llu rref %llu rpos %llu values %llu requests %llu writes %llu\n",
+               static_cast<unsigned long long>(stats.frames.load()),
+               static_cast<unsigned long long>(stats.rrefPackets.load()),
+               static_cast<unsigned long long>(stats.rposPackets.load()),
+               static_cast<unsigned long long>(stats.values.load()),
+               static_cast<unsigned long long>(stats.requests.load()),
+               static_cast<unsigned long long>(stats.writes.load()));
+        timer.expires_after(std::chrono::seconds(5));
+        timer.async_wait(report);
+    };
+    timer.expires_after(std::chrono::seconds(5));
+    timer.async_wait(report);
+    context.run();
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+
+using namespace std;
+
+// dataref 历史
+// 1. 连接进程内 30 Hz 的 fakeXPlane, 以 120 Hz 渲染 seconds 秒:
+//    每帧读取最新值(旧) 与 getDatarefAt(此刻 - 50 ms) 线性插值对比 重复帧比例与最大帧间跳变
+// 2. 查询耗时: 标量 HOLD/LINEAR, 56 元素数组, copyHistory 1 秒窗口
+// 3. 接收开销: 同时记录数据包, 尽快回放到未启用历史与全部启用历史的实例 每包耗时
+// 用法: historyBenchmark [datarefs=1000] [seconds=5]
+
+static constexpr int ROUNDS{1000000};
+static constexpr size_t DEPTH{256};
+static const std::string SCALAR{"xpudp/bench/pitch"};
+static const std::string ARRAY{"xpudp/bench/load"};
+static const std::string WIDE{"xpudp/bench/ail"};
+
+/**
+ * @brief 按相同顺序订阅 回放时 RREF 中的 index 对应相同位置
+ */
+static std::array<XPlaneUdp::DatarefIndex, 3> subscribe (XPlaneUdp &xp, const int count) {
+    return {xp.addDataref(SCALAR, 30), xp.addDatarefArray(ARRAY, 56, 30), xp.addDatarefArray(WIDE, count, 30)};
+}
+
+template <typename Func>
+static double nsPerRound (Func &&func) {
+    for (int i = 0; i < ROUNDS / 10; ++i) // 预热
+        func(i);
+    const auto t0 = bench::Clock::now();
+    for (int i = 0; i < ROUNDS; ++i)
+        func(i);
+    return std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / ROUNDS;
+}
+
+static double replayNs (const std::string &path, const int count, const bool history, size_t &packets) {
+    XPlaneUdp xp(false);
+    for (const auto &ref : subscribe(xp, count)) {
+        if (history)
+            xp.setHistory(ref, DEPTH);
+    }
+    const auto t0 = bench::Clock::now();
+    packets = xp.replay(path, 0);
+    return std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / static_cast<double>(packets);
+}
+
+int main (const int argc, char *argv[]) {
+    const int count = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const int seconds = argc > 2 ? std::atoi(argv[2]) : 5;
+    const std::string path = (std::filesystem::temp_directory_path() / "xpudp_history.log").string();
+
+    auto session = bench::connect({.frameRate = 30});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    auto &xplane = session.xplane;
+    const auto [scalar, array, wide] = subscribe(xp, count);
+    for (const auto &ref : {scalar, array, wide})
+        xp.setHistory(ref, DEPTH);
+    std::this_thread::sleep_for(std::chrono::seconds(1)); // 等待订阅生效
+    if (!xp.startRecording(path)) {
+        fprintf(stderr, "cannot record to %s\n", path.c_str());
+        return 1;
+    }
+
+    // 120 Hz 渲染
+    const auto frame = std::chrono::microseconds(8333);
+    const auto delay = std::chrono::milliseconds(50);
+    float lastLatest{NAN}, lastSmooth{NAN}, maxLatestStep{0}, maxSmoothStep{0};
+    int frames{0}, latestRepeats{0}, smoothRepeats{0}, misses{0};
+    auto due = bench::Clock::now();
+    const auto finish = due + std::chrono::seconds(seconds);
+    while (due < finish) {
+        std::this_thread::sleep_until(due);
+        due += frame;
+        float latest, smooth;
+        xp.getDataref(scalar, latest);
+        if (!xp.getDatarefAt(scalar, bench::Clock::now() - delay, smooth)) {
+            ++misses;
+            continue;
+        }
+        if (!std::isnan(lastLatest)) {
+            latestRepeats += latest == lastLatest;
+            smoothRepeats += smooth == lastSmooth;
+            maxLatestStep = std::max(maxLatestStep, std::abs(latest - lastLatest));
+            maxSmoothStep = std::max(maxSmoothStep, std::abs(smooth - lastSmooth));
+            ++frames;
+        }
+        lastLatest = latest;
+        lastSmooth = smooth;
+    }
+    xplane.reset();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto record = xp.stopRecording();
+    printf("render %d frames at 120 Hz from a 30 Hz stream (%d frames before the first sample)\n", frames, misses);
+    printf("  %-26s %12s %12s\n", "", "repeated", "max step");
+    printf("  %-26s %11.1f%% %12.4f\n", "latest value", 100.0 * latestRepeats / std::max(frames, 1), maxLatestStep);
+    printf("  %-26s %11.1f%% %12.4f\n", "getDatarefAt(now - 50ms)", 100.0 * smoothRepeats / std::max(frames, 1),
+           maxSmoothStep);
+
+    // 查询耗时 样本已停止更新 时刻分布在整个历史内
+    std::vector<HistoryRing::Clock::time_point> times;
+    std::vector<float> window;
+    xp.copyHistory(scalar, DEPTH, times, window);
+    const auto first = times.front();
+    const auto span = times.back() - times.front();
+    const auto at = [&](const int i) { return first + span * (i % 1000) / 1000; };
+    float value{0};
+    std::vector<float> elements;
+    const double holdNs = nsPerRound([&](const int i) {
+        xp.getDatarefAt(scalar, at(i), value, HistoryRing::HOLD);
+    });
+    const double linearNs = nsPerRound([&](const int i) { xp.getDatarefAt(scalar, at(i), value); });
+    const double arrayNs = nsPerRound([&](const int i) { xp.getDatarefAt(array, at(i), elements); });
+    const double latestNs = nsPerRound([&](int) { xp.getDataref(array, elements); });
+    size_t samples{0};
+    const double rangeNs = nsPerRound([&](const int i) {
+        samples = xp.copyHistory(array, at(i % 500), at(i % 500) + std::chrono::seconds(1), times, window);
+    });
+    printf("query (%zu samples kept, ns)\n", xp.copyHistory(scalar, DEPTH, times, window));
+    printf("  %-26s %10.1f\n", "scalar HOLD", holdNs);
+    printf("  %-26s %10.1f\n", "scalar LINEAR", linearNs);
+    printf("  %-26s %10.1f  (latest value %.1f)\n", "56 elements LINEAR", arrayNs, latestNs);
+    printf("  %-26s %10.1f  (%zu samples x 56)\n", "copyHistory 1 s", rangeNs, samples);
+
+    // 接收开销
+    size_t packets{0};
+    const double plainNs = replayNs(path, count, false, packets);
+    const double historyNs = replayNs(path, count, true, packets);
+    printf("receive %zu recorded packets (%llu dropped), %d + 57 datarefs, depth %zu\n", packets,
+           static_cast<unsigned long long>(record.dropped), count, DEPTH);
+    printf("  %-26s %10.0f ns/packet\n", "no history", plainNs);
+    printf("  %-26s %10.0f ns/packet\n", "history on all", historyNs);
+    std::filesystem::remove(path);
+    return value == 12345 ? 1 : 0;
+}
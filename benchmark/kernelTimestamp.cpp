@@ -0,0 +1,114 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+
+using namespace std;
+
+// 内核接收时间戳: 本机模拟 XPlane 按帧率发送, enableKernelTimestamps 后把整帧从发送到值可读的延迟拆分为
+// 发送到内核收到 / 内核中排队 (kernelQueueTime) / 内核收到到值可读 (kernelToVisible) / 单包解码 (decodeTime)
+// 普通模式与忙轮询各一次, 直方图分位数为所在 2 的幂区间的上界
+// 用法: kernelTimestampBenchmark [datarefs=100] [rate=250] [seconds=5]
+
+/**
+ * @brief 两次统计之间的直方图
+ */
+static Histogram::Report since (const Histogram::Report &before, const Histogram::Report &after) {
+    Histogram::Report result = after;
+    result.total = 0;
+    for (size_t i = 0; i < Histogram::BUCKETS; ++i) {
+        result.counts[i] -= before.counts[i];
+        result.total += result.counts[i];
+    }
+    return result;
+}
+
+struct Result {
+    vector<double> sendToVisible; // us
+    vector<double> sendToKernel; // us 发送到内核收到
+    Histogram::Report queue, visible, decode;
+};
+
+int main (const int argc, char *argv[]) {
+    const int count = argc > 1 ? std::atoi(argv[1]) : 100;
+    const double rate = argc > 2 ? std::atof(argv[2]) : 250;
+    const int seconds = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    const auto session = bench::connect({.frameRate = rate});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    if (!xp.enableKernelTimestamps(true)) {
+        fprintf(stderr, "SO_TIMESTAMPNS not supported\n");
+        return 1;
+    }
+    const auto freq = static_cast<int32_t>(rate);
+    const auto lo = xp.addDataref(bench::SEND_TIME_LO, freq);
+    const auto hi = xp.addDataref(bench::SEND_TIME_HI, freq);
+    const auto frame = xp.addDataref(bench::FRAME_COUNTER, freq);
+    xp.addDatarefArray("xpudp/bench/load", count, freq);
+    xp.setHistory(frame, 4); // 历史样本的时间即到达时间
+
+    std::atomic<Result*> target{nullptr};
+    std::vector<HistoryRing::Clock::time_point> times;
+    std::vector<float> samples;
+    xp.setUpdateCallback([&](const std::span<const XPlaneUdp::DatarefIndex> updated, const bool infoUpdated) {
+        Result *result = target.load(std::memory_order_acquire);
+        if (infoUpdated || result == nullptr)
+            return;
+        if (std::ranges::find_if(updated, [&](const auto &ref) { return ref.getIdx() == frame.getIdx(); }) ==
+            updated.end())
+            return;
+        const auto now = bench::Clock::now();
+        float loValue, hiValue;
+        xp.getDataref(lo, loValue);
+        xp.getDataref(hi, hiValue);
+        const auto sent = bench::decodeSendTime(loValue, hiValue);
+        result->sendToVisible.push_back(std::chrono::duration<double, std::micro>(now - sent).count());
+        if (xp.copyHistory(frame, 1, times, samples) == 1)
+            result->sendToKernel.push_back(std::chrono::duration<double, std::micro>(times[0] - sent).count());
+    });
+
+    const auto measure = [&] {
+        Result result;
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        const auto before = xp.getStats();
+        target.store(&result, std::memory_order_release);
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        target.store(nullptr, std::memory_order_release);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const auto after = xp.getStats();
+        result.queue = since(before.kernelQueueTime, after.kernelQueueTime);
+        result.visible = since(before.kernelToVisible, after.kernelToVisible);
+        result.decode = since(before.decodeTime, after.decodeTime);
+        std::ranges::sort(result.sendToVisible);
+        std::ranges::sort(result.sendToKernel);
+        return result;
+    };
+    const auto normal = measure();
+    xp.enableBusyPoll({});
+    const auto busy = measure();
+    xp.disableBusyPoll();
+
+    const auto percentile = [](const vector<double> &sorted, const double p) {
+        return sorted.empty() ? 0.0 : sorted[static_cast<size_t>(p * static_cast<double>(sorted.size() - 1))];
+    };
+    const auto print = [&](const char *mode, const Result &result) {
+        printf("%s, %zu frames\n", mode, result.sendToVisible.size());
+        printf("  %-34s %10s %10s\n", "", "p50 us", "p99 us");
+        printf("  %-34s %10.1f %10.1f\n", "send -> visible", percentile(result.sendToVisible, 0.5),
+               percentile(result.sendToVisible, 0.99));
+        printf("  %-34s %10.1f %10.1f\n", "send -> kernel (history time)", percentile(result.sendToKernel, 0.5),
+               percentile(result.sendToKernel, 0.99));
+        const auto bucket = [](const char *name, const Histogram::Report &report) {
+            printf("  %-34s %10.1f %10.1f\n", name, static_cast<double>(report.percentile(0.5)) / 1000,
+                   static_cast<double>(report.percentile(0.99)) / 1000);
+        };
+        bucket("kernel queue (<=)", result.queue);
+        bucket("kernel -> visible (<=)", result.visible);
+        bucket("decode per packet (<=)", result.decode);
+    };
+    printf("%d datarefs at %.0f Hz for %d s, SO_TIMESTAMPNS\n", count + 3, rate, seconds);
+    print("epoll wait", normal);
+    print("busy poll", busy);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include "../XPlaneManager.hpp"
+#include <cstdio>
+
+using namespace std;
+
+// 多模拟器
+// 依次启动 1, 2, 4, 8 ... sims 个进程内的 fakeXPlane, 由 XPlaneManager 自动发现并订阅 datarefs 个元素
+// 分别以单线程与 CPU 核数个 io 线程接收 seconds 秒, 统计全部实例的 RREF 接收速率与接收比例
+// fakeXPlane 与接收端在同一台机器上竞争 CPU, 单核机器上多线程不会更快
+// 同时向多播组发送非信标数据包与外部视景的信标, 它们不应创建实例
+// 先检查单独的 XPlaneUdp: 主机停止后只有外部视景的信标时应断开, 且这些信标不计为不合法
+// 用法: managerBenchmark [sims=12] [datarefs=500] [rate=60] [seconds=3]
+
+struct Result {
+    uint64_t sent{0}, received{0}, values{0};
+};
+
+/**
+ * @brief 向信标多播组发送一个 role 2 (外部视景) 的信标 可选先发送一个 RREF 数据包
+ */
+static void sendNoise (const bool rref = true) {
+    asio::io_context context;
+    ip::udp::socket socket(context, ip::udp::v4());
+    socket.set_option(ip::multicast::enable_loopback(true));
+    const ip::udp::endpoint group(ip::make_address("239.255.1.1"), 49707);
+    std::array<char, 64> packet{};
+    sys::error_code ec;
+    if (rref) {
+        pack(packet, 0, DATAREF_GET_HEAD, int32_t{1}, 1.0f);
+        socket.send_to(asio::buffer(packet), group, 0, ec);
+    }
+    const size_t size = pack(packet, 0, BECON_HEAD, uint8_t{1}, uint8_t{2}, int32_t{1}, int32_t{120000}, uint32_t{2},
+                             uint16_t{49000}, std::string{"visual"}, '\x00');
+    socket.send_to(asio::buffer(packet, size), group, 0, ec);
+}
+
+/**
+ * @brief 单独的 XPlaneUdp 连接 fakeXPlane 后停止 fakeXPlane 之后每 200 ms 发送外部视景的信标
+ * @return 是否在超时内断开且外部视景的信标未计为不合法
+ */
+static bool standaloneIgnoresVisuals () {
+    auto session = bench::connect({});
+    if (!session)
+        return false;
+    session.xplane.reset();
+    const auto stopped = bench::Clock::now();
+    while (*session.connected && bench::Clock::now() - stopped < std::chrono::seconds(5)) {
+        sendNoise(false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    const double ms = std::chrono::duration<double, std::milli>(bench::Clock::now() - stopped).count();
+    const uint64_t malformed = session.xp->getStats().malformed;
+    printf("standalone: %s %.0f ms after the master stopped with visual beacons, %llu malformed\n",
+           *session.connected ? "still connected" : "disconnected", ms, static_cast<unsigned long long>(malformed));
+    return !*session.connected && malformed == 0;
+}
+
+static Result run (const size_t sims, const size_t threads, const int count, const double rate, const int seconds) {
+    const auto freq = static_cast<int32_t>(rate);
+    XPlaneManager manager(threads);
+    manager.setDiscoverCallback([&](XPlaneUdp &xp, const ip::udp::endpoint &) {
+        xp.addDataref(bench::FRAME_COUNTER, freq);
+        xp.addDatarefArray("xpudp/bench/load", count, freq);
+    });
+    std::vector<std::unique_ptr<bench::FakeXPlane>> xplanes;
+    sendNoise();
+    for (size_t i = 0; i < sims; ++i)
+        xplanes.emplace_back(std::make_unique<bench::FakeXPlane>(bench::FakeXPlane::Options{.frameRate = rate}));
+    const auto deadline = bench::Clock::now() + std::chrono::seconds(5);
+    while (manager.size() < sims) {
+        if (bench::Clock::now() > deadline) {
+            fprintf(stderr, "found %zu of %zu sims, is multicast loopback available?\n", manager.size(), sims);
+            return {};
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1)); // 等待订阅生效
+    if (manager.size() != sims) {
+        fprintf(stderr, "%zu sims for %zu fakeXPlanes, non-beacon packets created instances\n", manager.size(), sims);
+        return {};
+    }
+
+    const auto snapshot = [&] {
+        Result result;
+        for (const auto &xplane : xplanes)
+            result.sent += xplane->counters().rrefPackets;
+        for (const auto *xp : manager.getSims())
+            result.received += xp->getStats().packetsReceived[XPlaneStats::RREF];
+        for (const auto &xplane : xplanes)
+            result.values += xplane->counters().values;
+        return result;
+    };
+    const Result before = snapshot();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    const Result after = snapshot();
+    manager.close();
+    return {after.sent - before.sent, after.received - before.received, after.values - before.values};
+}
+
+int main (const int argc, char *argv[]) {
+    const size_t sims = argc > 1 ? std::atoi(argv[1]) : 12;
+    const int count = argc > 2 ? std::atoi(argv[2]) : 500;
+    const double rate = argc > 3 ? std::atof(argv[3]) : 60;
+    const int seconds = argc > 4 ? std::atoi(argv[4]) : 3;
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+    if (!standaloneIgnoresVisuals())
+        return 1;
+    printf("%d datarefs at %.0f Hz per sim for %d s, %zu cores\n", count + 1, rate, seconds, cores);
+    printf("  %6s %8s %14s %14s %10s\n", "sims", "threads", "packets/s", "values/s", "received");
+    std::vector<size_t> steps;
+    for (size_t k = 1; k < sims; k *= 2)
+        steps.push_back(k);
+    steps.push_back(sims);
+    for (const size_t k : steps) {
+        for (const size_t threads : {size_t{1}, cores}) {
+            const Result result = run(k, threads, count, rate, seconds);
+            if (result.sent == 0)
+                return 1;
+            const double received = static_cast<double>(result.received) / static_cast<double>(result.sent);
+            printf("  %6zu %8zu %14.0f %14.0f %9.1f%%\n", k, threads,
+                   static_cast<double>(result.received) / seconds,
+                   static_cast<double>(result.values) * received / seconds, 100.0 * received);
+            if (cores == 1)
+                break;
+        }
+    }
+    return 0;
+}
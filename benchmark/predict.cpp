@@ -0,0 +1,102 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+// 基本信息外推
+// 连接进程内的 fakeXPlane (100 m/s 定常转弯), 以 rate Hz 接收 RPOS, 以 144 Hz 显示 seconds 秒
+// 每帧 getPlaneInfo(旧) 与 predictPlaneInfo(此刻) 对比: 重复帧比例, 帧间位移的均值/最大值/标准差
+// RPOS 到达时的外推误差统计 (getStats), 以及 predictPlaneInfo 的耗时
+// 用法: predictBenchmark [rate=30] [seconds=5]
+
+static constexpr int ROUNDS{1000000};
+
+struct Motion {
+    int frames{0}, repeats{0};
+    double sum{0}, squares{0}, max{0};
+    bool first{true};
+    XPlaneUdp::PlaneInfo last{};
+
+    void add (const XPlaneUdp::PlaneInfo &info) {
+        if (!first) {
+            constexpr double deg = std::numbers::pi / 180, radius = 6371008.8;
+            const double north = (info.lat - last.lat) * deg * radius;
+            const double east = (info.lon - last.lon) * deg * radius * std::cos(info.lat * deg);
+            const double step = std::hypot(north, east);
+            repeats += step == 0;
+            sum += step;
+            squares += step * step;
+            max = std::max(max, step);
+            ++frames;
+        }
+        first = false;
+        last = info;
+    }
+    void print (const char *name) const {
+        const double mean = sum / std::max(frames, 1);
+        const double deviation = std::sqrt(std::max(0.0, squares / std::max(frames, 1) - mean * mean));
+        printf("  %-22s %9.1f%% %10.3f %10.3f %10.3f\n", name, 100.0 * repeats / std::max(frames, 1), mean, max,
+               deviation);
+    }
+};
+
+static void printError (const char *name, const Histogram::Report &report, const double scale, const char *unit) {
+    printf("  %-22s p50 %8.3f  p99 %8.3f  max %8.3f %s (%llu packets)\n", name,
+           static_cast<double>(report.percentile(0.5)) / scale, static_cast<double>(report.percentile(0.99)) / scale,
+           static_cast<double>(report.max) / scale, unit, static_cast<unsigned long long>(report.total));
+}
+
+int main (const int argc, char *argv[]) {
+    const double rate = argc > 1 ? std::atof(argv[1]) : 30;
+    const int seconds = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    const auto session = bench::connect({.frameRate = rate});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    xp.addPlaneInfo(static_cast<int>(rate));
+    if (!xp.waitPlaneInfo(std::chrono::seconds(2)) || !xp.waitPlaneInfo(std::chrono::seconds(2))) {
+        fprintf(stderr, "no RPOS received\n");
+        return 1;
+    }
+
+    // 144 Hz 显示
+    Motion latest, predicted;
+    const auto frame = std::chrono::nanoseconds(1'000'000'000 / 144);
+    auto due = bench::Clock::now();
+    const auto finish = due + std::chrono::seconds(seconds);
+    while (due < finish) {
+        std::this_thread::sleep_until(due);
+        due += frame;
+        XPlaneUdp::PlaneInfo info{};
+        xp.getPlaneInfo(info);
+        latest.add(info);
+        xp.predictPlaneInfo(bench::Clock::now(), info);
+        predicted.add(info);
+    }
+    printf("display at 144 Hz from %.0f Hz RPOS, %d frames (100 m/s: %.3f m per frame)\n", rate, latest.frames,
+           100.0 / 144);
+    printf("  %-22s %10s %10s %10s %10s\n", "", "repeated", "mean m", "max m", "stddev m");
+    latest.print("getPlaneInfo");
+    predicted.print("predictPlaneInfo");
+
+    const auto stats = xp.getStats();
+    printf("error when the next RPOS arrives\n");
+    printError("hold last position", stats.holdError, 1000, "m");
+    printError("extrapolated position", stats.predictError, 1000, "m");
+    printError("extrapolated attitude", stats.attitudeError, 1000, "deg");
+
+    XPlaneUdp::PlaneInfo info{};
+    const auto t0 = bench::Clock::now();
+    for (int i = 0; i < ROUNDS; ++i)
+        xp.predictPlaneInfo(t0 + std::chrono::microseconds(i % 1000), info);
+    const double predictNs = std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / ROUNDS;
+    const auto t1 = bench::Clock::now();
+    for (int i = 0; i < ROUNDS; ++i)
+        xp.getPlaneInfo(info);
+    const double getNs = std::chrono::duration<double, std::nano>(bench::Clock::now() - t1).count() / ROUNDS;
+    printf("cost: predictPlaneInfo %.1f ns, getPlaneInfo %.1f ns\n", predictNs, getNs);
+    return info.track == 12345 ? 1 : 0;
+}
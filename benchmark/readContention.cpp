@@ -0,0 +1,95 @@
+#include "BenchCommon.hpp"
+#include <cstdio>
+#include <shared_mutex>
+
+using namespace std;
+
+// 多读者争用: shared_mutex(旧) 与 SeqLock + ValueStore(新)
+// 写者模拟 io 线程 每个数据包写入 183 个值, 读者读取 16 元素数组
+
+static constexpr size_t SLOTS{1024};
+static constexpr size_t PAIRS{183};
+static constexpr size_t READ_LENGTH{16};
+static constexpr auto DURATION = std::chrono::milliseconds(300);
+
+struct Result {
+    double readsPerSec;
+    double packetsPerSec;
+};
+
+struct MutexStore {
+    mutable std::shared_mutex mutex;
+    std::vector<float> values = std::vector<float>(SLOTS);
+
+    void write (const float base) {
+        std::unique_lock lock(mutex);
+        for (size_t i = 0; i < PAIRS; ++i)
+            values[(i * 5) % SLOTS] = base + static_cast<float>(i);
+    }
+    void read (std::array<float, READ_LENGTH> &out) const {
+        std::shared_lock lock(mutex);
+        std::copy_n(values.begin() + 100, READ_LENGTH, out.begin());
+    }
+};
+
+struct SeqStore {
+    SeqLock lock;
+    std::mutex writeMutex;
+    ValueStore values;
+
+    SeqStore () { values.resize(SLOTS); }
+    void write (const float base) {
+        std::lock_guard guard(writeMutex);
+        lock.write([&] {
+            for (size_t i = 0; i < PAIRS; ++i)
+                values.set((i * 5) % SLOTS, base + static_cast<float>(i));
+        });
+    }
+    void read (std::array<float, READ_LENGTH> &out) const {
+        lock.read([&] { values.copy(100, READ_LENGTH, out.begin()); });
+    }
+};
+
+template <typename Store>
+static Result run (const int readers) {
+    Store store;
+    std::atomic<bool> running{true};
+    std::atomic<size_t> reads{0};
+    size_t packets{0};
+    vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&] () {
+            std::array<float, READ_LENGTH> out{};
+            size_t local{0};
+            while (running.load(std::memory_order_relaxed)) {
+                store.read(out);
+                ++local;
+            }
+            reads.fetch_add(local);
+        });
+    }
+    std::thread writer([&] () {
+        while (running.load(std::memory_order_relaxed)) {
+            store.write(static_cast<float>(packets));
+            ++packets;
+        }
+    });
+    std::this_thread::sleep_for(DURATION);
+    running = false;
+    writer.join();
+    for (auto &thread : threads)
+        thread.join();
+    const double seconds = std::chrono::duration<double>(DURATION).count();
+    return {static_cast<double>(reads) / seconds, static_cast<double>(packets) / seconds};
+}
+
+int main () {
+    printf("%8s | %16s %16s | %16s %16s\n", "readers", "mutex reads/s", "mutex pkts/s", "seqlock reads/s",
+           "seqlock pkts/s");
+    for (const int readers : {1, 2, 4, 8, 16}) {
+        const auto [mutexReads, mutexPackets] = run<MutexStore>(readers);
+        const auto [seqReads, seqPackets] = run<SeqStore>(readers);
+        printf("%8d | %16.0f %16.0f | %16.0f %16.0f\n", readers, mutexReads, mutexPackets, seqReads, seqPackets);
+    }
+    return 0;
+}
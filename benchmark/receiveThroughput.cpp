@@ -0,0 +1,177 @@
+#include "BenchCommon.hpp"
+#include <cstdio>
+#include <ctime>
+
+using namespace std;
+
+// 接收吞吐: 逐包分配缓冲 + async_receive_from(旧) 与 预分配接收环 + recvmmsg(新)
+// 发送线程以最快速度发送 183 对值的 RREF 数据包, 统计 io 线程每秒处理的数据包与每包 CPU 时间
+// 另外比较新实现开启与关闭耗时统计(enableStats)的开销
+
+static constexpr int PAIRS{183};
+static constexpr auto DURATION = std::chrono::seconds(2);
+
+/**
+ * @brief 当前线程 CPU 时间
+ */
+static double threadCpuSeconds () {
+#ifdef _WIN32
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#else
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+#endif
+}
+
+/**
+ * @brief 旧实现: 每个数据包一个池化 shared_ptr 缓冲, 解码后清零
+ */
+class LegacyReceiver {
+    public:
+        LegacyReceiver () : socket(context, ip::udp::endpoint(ip::udp::v4(), 0)) {
+            socket.set_option(asio::socket_base::receive_buffer_size(1 << 20)); // 与 XPlaneUdp 相同
+            asio::co_spawn(context, receive(), asio::detached);
+            worker = std::thread([this] () { context.run(); });
+        }
+        ~LegacyReceiver () {
+            context.stop();
+            worker.join();
+        }
+        [[nodiscard]] unsigned short port () const { return socket.local_endpoint().port(); }
+        std::atomic<size_t> packets{0};
+        std::atomic<bool> sampleCpu{false};
+        std::atomic<double> cpu{0};
+    private:
+        asio::io_context context;
+        ip::udp::socket socket;
+        std::thread worker;
+        std::vector<float> values = std::vector<float>(PAIRS);
+
+        asio::awaitable<void> receive () {
+            ip::udp::endpoint temp;
+            while (true) {
+                auto buffer = bench::LegacyBufferPool::getBuffer(0);
+                const size_t size = co_await socket.async_receive_from(asio::buffer(*buffer), temp, asio::use_awaitable);
+                for (size_t i = HEADER_LENGTH; i + 8 <= size; i += 8) {
+                    int index;
+                    float value;
+                    unpack(*buffer, i, index, value);
+                    if (index >= 0 && static_cast<size_t>(index) < values.size())
+                        values[index] = value;
+                }
+                std::memset(buffer->data(), 0x00, size);
+                packets.fetch_add(1, std::memory_order_relaxed);
+                if (sampleCpu.exchange(false))
+                    cpu = threadCpuSeconds();
+            }
+        }
+};
+
+struct Result {
+    double packetsPerSec;
+    double cpuPerPacketUs;
+    size_t sent;
+};
+
+/**
+ * @brief 向 target 发送 RREF 数据包直到超时
+ */
+static size_t flood (const ip::udp::endpoint &target, const std::chrono::steady_clock::duration duration) {
+    asio::io_context context;
+    ip::udp::socket socket(context, ip::udp::v4());
+    std::array<char, 1472> packet{};
+    size_t size = pack(packet, 0, DATAREF_GET_HEAD);
+    for (int i = 0; i < PAIRS; ++i)
+        size = pack(packet, size, int32_t{i}, static_cast<float>(i));
+    size_t sent{0};
+    const auto deadline = bench::Clock::now() + duration;
+    while (bench::Clock::now() < deadline) {
+        sys::error_code ec;
+        socket.send_to(asio::buffer(packet, size), target, 0, ec);
+        ++sent;
+    }
+    return sent;
+}
+
+/**
+ * @brief 统计一次测量 cpuStart 与 cpuEnd 为 io 线程 CPU 时间
+ */
+template <typename Counter, typename Sampler>
+static Result measure (const ip::udp::endpoint &target, Counter &&count, Sampler &&sample) {
+    flood(target, std::chrono::milliseconds(200)); // 预热
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const double cpuStart = sample();
+    const size_t before = count();
+    const size_t sent = flood(target, DURATION);
+    const size_t processed = count() - before;
+    const double cpuEnd = sample();
+    const double seconds = std::chrono::duration<double>(DURATION).count();
+    return {static_cast<double>(processed) / seconds,
+            processed ? (cpuEnd - cpuStart) * 1e6 / static_cast<double>(processed) : 0, sent};
+}
+
+int main () {
+    // 新实现
+    bench::UdpSink sink;
+    XPlaneUdp xp(false);
+    std::atomic<size_t> packets{0};
+    std::atomic<bool> sampleCpu{false};
+    std::atomic<double> cpu{0};
+    xp.setUpdateCallback([&](std::span<const XPlaneUdp::DatarefIndex>, bool) {
+        packets.fetch_add(1, std::memory_order_relaxed);
+        if (sampleCpu.exchange(false))
+            cpu = threadCpuSeconds();
+    });
+    const auto beacon = bench::startBeacon<bench::FakeBeacon>(xp, sink.port());
+    if (!beacon)
+        return 1;
+    xp.addDatarefArray("xpudp/bench/array", PAIRS, 30);
+    sink.waitFor(PAIRS, std::chrono::seconds(2));
+    const ip::udp::endpoint xpTarget(ip::make_address("127.0.0.1"), sink.peer().port());
+    // 采样需要 io 线程处理一个数据包 发送一个空 RREF 触发
+    auto sampleWith = [](std::atomic<bool> &flag, std::atomic<double> &value, const ip::udp::endpoint &target) {
+        asio::io_context context;
+        ip::udp::socket socket(context, ip::udp::v4());
+        flag = true;
+        while (flag) {
+            std::array<char, 13> packet{};
+            const size_t size = pack(packet, 0, DATAREF_GET_HEAD, int32_t{-1}, 0.0f);
+            socket.send_to(asio::buffer(packet, size), target);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return value.load();
+    };
+    xp.enableStats(false);
+    const Result quiet = measure(xpTarget, [&] { return packets.load(); },
+                                 [&] { return sampleWith(sampleCpu, cpu, xpTarget); });
+    xp.enableStats(true);
+    const Result batched = measure(xpTarget, [&] { return packets.load(); },
+                                   [&] { return sampleWith(sampleCpu, cpu, xpTarget); });
+    const XPlaneStats::Report stats = xp.getStats();
+
+    // 旧实现
+    LegacyReceiver legacy;
+    const ip::udp::endpoint legacyTarget(ip::make_address("127.0.0.1"), legacy.port());
+    const Result old = measure(legacyTarget, [&] { return legacy.packets.load(); },
+                               [&] { return sampleWith(legacy.sampleCpu, legacy.cpu, legacyTarget); });
+
+    printf("receive %d-pair RREF packets for %lld ms\n", PAIRS,
+           static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(DURATION).count()));
+    printf("  %-26s %14s %16s %12s\n", "", "packets/s", "cpu/packet (us)", "sent");
+    printf("  %-26s %14.0f %16.3f %12zu\n", "pooled buffer per packet", old.packetsPerSec, old.cpuPerPacketUs,
+           old.sent);
+    printf("  %-26s %14.0f %16.3f %12zu\n", "receive ring + recvmmsg", quiet.packetsPerSec, quiet.cpuPerPacketUs,
+           quiet.sent);
+    printf("  %-26s %14.0f %16.3f %12zu\n", "  with timing stats", batched.packetsPerSec, batched.cpuPerPacketUs,
+           batched.sent);
+    if (quiet.cpuPerPacketUs > 0)
+        printf("timing stats overhead: %+.2f%% cpu/packet\n",
+               (batched.cpuPerPacketUs / quiet.cpuPerPacketUs - 1) * 100);
+    printf("RREF received %llu, malformed %llu, out of range %llu, decode p50 %llu ns p99 %llu ns\n",
+           static_cast<unsigned long long>(stats.packetsReceived[XPlaneStats::RREF]),
+           static_cast<unsigned long long>(stats.malformed), static_cast<unsigned long long>(stats.outOfRange),
+           static_cast<unsigned long long>(stats.decodeTime.percentile(0.5)),
+           static_cast<unsigned long long>(stats.decodeTime.percentile(0.99)));
+    return 0;
+}
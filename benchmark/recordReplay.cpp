@@ -0,0 +1,115 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+using namespace std;
+
+// 数据包记录与回放
+// 1. push: io 线程把一个满长度数据包复制进记录环的耗时, 写线程追加到映射文件的吞吐与丢弃
+// 2. 连接进程内的 fakeXPlane 记录 seconds 秒, 再用按相同顺序订阅的新 XPlaneUdp 回放
+//    尽快回放的数据包/秒, 原速与 10 倍速回放的时长, 回放后的值与实时接收一致
+// 用法: recordReplayBenchmark [datarefs=1000] [rate=60] [seconds=5]
+
+static constexpr int PUSHES{1000000};
+
+static void pushBenchmark (const std::string &path) {
+    std::array<char, PacketRecord::MAX_DATA> packet{};
+    pack(packet, 0, DATAREF_GET_HEAD);
+    const ip::udp::endpoint sender(ip::make_address("127.0.0.1"), 49000);
+    PacketRecorder recorder(path);
+    const auto t0 = bench::Clock::now();
+    for (int i = 0; i < PUSHES; ++i) {
+        const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            bench::Clock::now().time_since_epoch()).count();
+        recorder.push(packet, sender, PacketRecord::XPLANE, now);
+    }
+    const double pushNs = std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / PUSHES;
+    const auto report = recorder.stop();
+    const double seconds = std::chrono::duration<double>(bench::Clock::now() - t0).count();
+    printf("push %d packets of %zu bytes back to back\n", PUSHES, packet.size());
+    printf("  %-24s %10.1f ns\n", "push (io thread)", pushNs);
+    printf("  %-24s %10.1f MB/s\n", "written to log", static_cast<double>(report.bytes) / seconds / 1e6);
+    printf("  %-24s %10llu / %llu\n", "recorded / dropped", static_cast<unsigned long long>(report.recorded),
+           static_cast<unsigned long long>(report.dropped));
+}
+
+/**
+ * @brief 按相同顺序订阅 回放时 RREF 中的 index 对应相同位置
+ */
+static void subscribe (XPlaneUdp &xp, const int count, const int32_t freq) {
+    xp.addDataref(bench::FRAME_COUNTER, freq);
+    xp.addDatarefArray("xpudp/bench/load", count, freq);
+    xp.addPlaneInfo(freq);
+}
+
+static double replaySeconds (const std::string &path, const int count, const int32_t freq, const double speed,
+                             size_t &packets, XPlaneUdp::Snapshot &snap) {
+    XPlaneUdp xp(false);
+    subscribe(xp, count, freq);
+    const auto t0 = bench::Clock::now();
+    packets = xp.replay(path, speed);
+    const double seconds = std::chrono::duration<double>(bench::Clock::now() - t0).count();
+    xp.snapshot(snap);
+    return seconds;
+}
+
+int main (const int argc, char *argv[]) {
+    const int count = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const double rate = argc > 2 ? std::atof(argv[2]) : 60;
+    const int seconds = argc > 3 ? std::atoi(argv[3]) : 5;
+    const std::string path = (std::filesystem::temp_directory_path() / "xpudp_record.log").string();
+
+    pushBenchmark(path);
+
+    // 记录
+    auto session = bench::connect({.frameRate = rate});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    auto &xplane = session.xplane;
+    const auto freq = static_cast<int32_t>(rate);
+    subscribe(xp, count, freq);
+    std::this_thread::sleep_for(std::chrono::seconds(1)); // 等待订阅生效
+    if (!xp.startRecording(path)) {
+        fprintf(stderr, "cannot record to %s\n", path.c_str());
+        return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    xplane.reset(); // 停止发送后再停止记录 记录包含全部已接收的数据包
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto report = xp.stopRecording();
+    XPlaneUdp::Snapshot live;
+    xp.snapshot(live);
+
+    PacketLog log(path);
+    PacketRecord record;
+    int64_t first{-1}, last{0};
+    while (log.next(record)) {
+        if (first < 0)
+            first = record.time;
+        last = record.time;
+    }
+    const double span = static_cast<double>(last - first) / 1e9;
+    printf("recorded %d datarefs at %.0f Hz for %d s\n", count + 1, rate, seconds);
+    printf("  %llu packets, %llu dropped, %.1f MB\n", static_cast<unsigned long long>(report.recorded),
+           static_cast<unsigned long long>(report.dropped), static_cast<double>(report.bytes) / 1e6);
+
+    // 回放
+    size_t packets{0};
+    XPlaneUdp::Snapshot replayed;
+    const double fastest = replaySeconds(path, count, freq, 0, packets, replayed);
+    const bool identical = replayed.values == live.values &&
+                           std::memcmp(&replayed.info, &live.info, sizeof(XPlaneUdp::PlaneInfo)) == 0;
+    printf("replay\n");
+    printf("  %-24s %10.0f packets/s (%zu packets)\n", "as fast as possible", static_cast<double>(packets) / fastest,
+           packets);
+    for (const double speed : {1.0, 10.0}) {
+        const double took = replaySeconds(path, count, freq, speed, packets, replayed);
+        printf("  %-24s %10.3f s (log spans %.3f s)\n", speed == 1.0 ? "1x" : "10x", took, span / speed);
+    }
+    printf("values identical to live: %s\n", identical ? "yes" : "NO");
+    std::filesystem::remove(path);
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+
+using namespace std;
+
+// 重新订阅 5000 个数组元素
+// 1. 所需时间: 逐包协程发送(旧) 与 批量发送(新), 以及每次格式化打包(旧) 与复制预先打包的请求(新)
+// 2. 重启 fakeXPlane: 听见信标到全部值再次收到的耗时 (getStats)
+//    fakeXPlane 每帧发送全部订阅 优先级不影响这里的耗时
+
+static constexpr int ELEMENTS{5000};
+static constexpr int ROUNDS{20};
+static constexpr int RESTARTS{3};
+static const std::string ARRAY_NAME{"xpudp/bench/array"};
+
+/**
+ * @brief 旧实现: 每次重新订阅都格式化名称并打包
+ */
+static size_t legacyPack (BufferPool &pool) {
+    size_t bytes{0};
+    for (int i = 0; i < ELEMENTS; ++i) {
+        const int32_t freq{30};
+        std::string combine = std::format("{}[{}]", ARRAY_NAME, i);
+        const size_t size = packSize(0, DATAREF_GET_HEAD, freq, i, combine);
+        auto buffer = pool.getBuffer(size, 413);
+        pack(*buffer, 0, DATAREF_GET_HEAD, freq, i, combine);
+        bytes += static_cast<size_t>((*buffer)[HEADER_LENGTH + 8]);
+    }
+    return bytes;
+}
+
+/**
+ * @brief 新实现: 复制预先打包的请求
+ */
+static size_t cachedPack (BufferPool &pool, const std::vector<std::array<char, 413>> &packets) {
+    size_t bytes{0};
+    for (const auto &packet : packets) {
+        auto buffer = pool.getBuffer(packet.size());
+        std::memcpy(buffer->data(), packet.data(), packet.size());
+        bytes += static_cast<size_t>((*buffer)[HEADER_LENGTH + 8]);
+    }
+    return bytes;
+}
+
+/**
+ * @brief 重启 fakeXPlane 等待重新订阅完成
+ * @return 是否完成
+ */
+static bool restart (bench::Connection &session) {
+    auto &xp = *session.xp;
+    auto &xplane = session.xplane;
+    const unsigned short port = xplane->port();
+    const uint64_t before = xp.getStats().resubscribeTime.total;
+    xplane.reset();
+    const auto deadline = bench::Clock::now() + std::chrono::seconds(5);
+    while (*session.connected && bench::Clock::now() < deadline) // 等待信标超时
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    xplane = std::make_unique<bench::FakeXPlane>(bench::FakeXPlane::Options{.port = port, .frameRate = 60});
+    while (xp.getStats().resubscribeTime.total == before) {
+        if (bench::Clock::now() > deadline + std::chrono::seconds(5))
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+/**
+ * @brief 旧实现: 每个 RREF 数据包单独 co_spawn 一个发送协程
+ */
+static void legacyResubscribe (asio::io_context &context, ip::udp::socket &socket, const ip::udp::endpoint &target) {
+    for (int i = 0; i < ELEMENTS; ++i) {
+        const int32_t freq{30};
+        std::string combine = std::format("{}[{}]", ARRAY_NAME, i);
+        const size_t size = packSize(0, DATAREF_GET_HEAD, freq, i, combine);
+        auto buffer = bench::LegacyBufferPool::getBuffer(size);
+        pack(*buffer, 0, DATAREF_GET_HEAD, freq, i, combine);
+        asio::co_spawn(context, [&socket, target, buffer] () -> asio::awaitable<void> {
+            co_await socket.async_send_to(asio::buffer(*buffer, 413), target, asio::use_awaitable);
+        }, asio::detached);
+    }
+}
+
+int main () {
+    vector<double> batched, legacy;
+    size_t batchedLost{}, legacyLost{};
+    { // 信标在重启测试前停止
+        bench::UdpSink sink;
+        XPlaneUdp xp(false);
+        const auto beacon = bench::startBeacon<bench::FakeBeacon>(xp, sink.port());
+        if (!beacon)
+            return 1;
+        xp.addDatarefArray(ARRAY_NAME, ELEMENTS, 30);
+        sink.waitFor(ELEMENTS, std::chrono::seconds(2));
+
+        for (int round = 0; round < ROUNDS; ++round) {
+            sink.reset();
+            const auto t0 = bench::Clock::now();
+            xp.reconnect();
+            if (!sink.waitFor(ELEMENTS, std::chrono::seconds(2)))
+                batchedLost += ELEMENTS - sink.count();
+            batched.push_back(std::chrono::duration<double, std::milli>(bench::Clock::now() - t0).count());
+        }
+
+        asio::io_context context;
+        auto guard = asio::make_work_guard(context);
+        ip::udp::socket socket(context, ip::udp::endpoint(ip::udp::v4(), 0));
+        std::thread worker([&context] () { context.run(); });
+        const ip::udp::endpoint target(ip::make_address("127.0.0.1"), sink.port());
+        for (int round = 0; round < ROUNDS; ++round) {
+            sink.reset();
+            const auto t0 = bench::Clock::now();
+            legacyResubscribe(context, socket, target);
+            if (!sink.waitFor(ELEMENTS, std::chrono::seconds(2)))
+                legacyLost += ELEMENTS - sink.count();
+            legacy.push_back(std::chrono::duration<double, std::milli>(bench::Clock::now() - t0).count());
+        }
+        guard.reset();
+        worker.join();
+    }
+
+    // 只比较打包
+    BufferPool pool;
+    std::vector<std::array<char, 413>> packets(ELEMENTS);
+    for (int i = 0; i < ELEMENTS; ++i)
+        pack(packets[i], 0, DATAREF_GET_HEAD, int32_t{30}, int32_t{i}, std::format("{}[{}]", ARRAY_NAME, i));
+    vector<double> formatted, cached;
+    size_t bytes{0};
+    for (int round = 0; round < ROUNDS; ++round) {
+        auto t0 = bench::Clock::now();
+        bytes += legacyPack(pool);
+        formatted.push_back(std::chrono::duration<double, std::milli>(bench::Clock::now() - t0).count());
+        t0 = bench::Clock::now();
+        bytes += cachedPack(pool, packets);
+        cached.push_back(std::chrono::duration<double, std::milli>(bench::Clock::now() - t0).count());
+    }
+
+    printf("resubscribe %d elements, median of %d rounds\n", ELEMENTS, ROUNDS);
+    printf("  per-packet co_spawn : %8.3f ms (lost %zu)\n", bench::median(legacy), legacyLost);
+    printf("  batched sendmmsg    : %8.3f ms (lost %zu)\n", bench::median(batched), batchedLost);
+    printf("packing only\n");
+    printf("  format every time   : %8.3f ms\n", bench::median(formatted));
+    printf("  copy cached packets : %8.3f ms\n", bench::median(cached));
+
+    // 重启 XPlane
+    auto session = bench::connect({.frameRate = 60});
+    if (!session)
+        return 1;
+    auto &live = *session.xp;
+    live.addDatarefArray(ARRAY_NAME, ELEMENTS, 60);
+    live.addDataref(bench::FRAME_COUNTER, 60);
+    live.addPlaneInfo(60);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    printf("restart xplane %d times, %d elements + 1 dataref + plane info\n", RESTARTS, ELEMENTS);
+    for (int i = 0; i < RESTARTS; ++i) {
+        if (!restart(session)) {
+            fprintf(stderr, "resubscribe did not complete\n");
+            return 1;
+        }
+        printf("  beacon to all values received : %8.3f ms\n",
+               static_cast<double>(live.getStats().lastResubscribe) / 1000);
+    }
+    return bytes == 0 ? 1 : 0;
+}
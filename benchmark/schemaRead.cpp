@@ -0,0 +1,85 @@
+#include "BenchCommon.hpp"
+#include <cstdio>
+
+using namespace std;
+
+// 读取一组 dataref 的耗时: 逐个 DatarefIndex 读入各自的 vector(旧) / snapshot + view / getSchema 填充结构体
+// 与 test.cpp 相同的 8 个字段 共 126 个值 无需连接 XPlane
+
+static constexpr int ROUNDS{1000000};
+
+struct Record {
+    float time;
+    std::array<float, 16> engine;
+    std::array<float, 16> fuel;
+    std::array<float, 3> wind;
+    std::array<float, 10> isa;
+    std::array<float, 8> battery;
+    std::array<float, 16> ice;
+    std::array<float, 56> ail;
+};
+
+constexpr auto RECORD_SCHEMA = makeSchema(
+    schemaField("sim/time/zulu_time_sec", &Record::time, 30),
+    schemaField("sim/flightmodel/engine/ENGN_N1_", &Record::engine, 30),
+    schemaField("sim/cockpit2/engine/indicators/fuel_flow_kg_sec", &Record::fuel, 30),
+    schemaField("sim/weather/wind_direction_degt", &Record::wind, 30),
+    schemaField("sim/weather/temperatures_aloft_delta_ISA_C", &Record::isa, 30),
+    schemaField("sim/cockpit/electrical/battery_charge_watt_hr", &Record::battery, 30),
+    schemaField("sim/cockpit/switches/anti_ice_inlet_heat_per_enigne", &Record::ice, 30),
+    schemaField("sim/flightmodel/controls/ail1_def", &Record::ail, 30));
+
+template <typename Func>
+static double nsPerRound (Func &&func) {
+    for (int i = 0; i < ROUNDS / 10; ++i) // 预热
+        func();
+    const auto t0 = bench::Clock::now();
+    for (int i = 0; i < ROUNDS; ++i)
+        func();
+    return std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / ROUNDS;
+}
+
+int main () {
+    // 逐个订阅
+    XPlaneUdp separate(false);
+    const auto time = separate.addDataref("sim/time/zulu_time_sec", 30);
+    const std::array refs{
+        separate.addDatarefArray("sim/flightmodel/engine/ENGN_N1_", 16, 30),
+        separate.addDatarefArray("sim/cockpit2/engine/indicators/fuel_flow_kg_sec", 16, 30),
+        separate.addDatarefArray("sim/weather/wind_direction_degt", 3, 30),
+        separate.addDatarefArray("sim/weather/temperatures_aloft_delta_ISA_C", 10, 30),
+        separate.addDatarefArray("sim/cockpit/electrical/battery_charge_watt_hr", 8, 30),
+        separate.addDatarefArray("sim/cockpit/switches/anti_ice_inlet_heat_per_enigne", 16, 30),
+        separate.addDatarefArray("sim/flightmodel/controls/ail1_def", 56, 30),
+    };
+    // schema
+    XPlaneUdp grouped(false);
+    const auto record = grouped.addSchema(RECORD_SCHEMA);
+
+    float timeValue{};
+    std::array<std::vector<float>, refs.size()> arrays;
+    const double perIndex = nsPerRound([&] {
+        separate.getDataref(time, timeValue);
+        for (size_t i = 0; i < refs.size(); ++i)
+            separate.getDataref(refs[i], arrays[i]);
+    });
+
+    XPlaneUdp::Snapshot snap;
+    float sum{};
+    const double snapshotView = nsPerRound([&] {
+        snap.sequence = 0; // 强制复制
+        separate.snapshot(snap);
+        sum += separate.view(snap, time)[0];
+        for (const auto &ref : refs)
+            sum += separate.view(snap, ref)[0];
+    });
+
+    Record data{};
+    const double schema = nsPerRound([&] { grouped.getSchema(record, data); });
+
+    printf("read %d values in 8 fields, %d rounds\n", decltype(RECORD_SCHEMA)::LENGTH, ROUNDS);
+    printf("  %-28s %10.1f ns\n", "getDataref per index", perIndex);
+    printf("  %-28s %10.1f ns\n", "snapshot + view", snapshotView);
+    printf("  %-28s %10.1f ns\n", "getSchema into struct", schema);
+    return sum == 12345 && data.time == 1 ? 1 : 0; // 防止被优化掉
+}
@@ -0,0 +1,166 @@
+#include "BenchCommon.hpp"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+// 时间序列记录: 旧 CSV(FastFileWriter) 与 SeriesWriter 对比
+// 与 test.cpp 相同的 126 个值加 13 个基本信息字段, 30 Hz 模拟 rows 行 (默认 1 小时)
+// 每行耗时、文件大小, 读取一个通道 60 秒窗口的耗时 (CSV 只能解析整个文件), 并校验读回的值完全一致
+// 用法: seriesBenchmark [rows=108000]
+
+static constexpr int FLOATS{126};
+static constexpr int64_t PERIOD{33333333}; // 30 Hz
+
+/**
+ * @brief 模拟一帧 多数通道不变或缓慢变化 少数随时间连续变化
+ */
+static void makeRow (const int r, std::array<float, FLOATS> &values, std::array<double, 3> &position,
+                     std::array<float, 10> &motion) {
+    const double t = r / 30.0;
+    values[0] = static_cast<float>(43200 + t); // zulu_time_sec
+    for (int i = 0; i < 16; ++i) {
+        values[1 + i] = i < 2 ? static_cast<float>(85 + 5 * std::sin(t / 60 + i)) : 0; // N1 双发
+        values[17 + i] = i < 2 ? static_cast<float>(0.6 + 0.05 * std::sin(t / 45)) : 0; // 燃油流量
+    }
+    for (int i = 0; i < 3; ++i)
+        values[33 + i] = 270 + 10 * i;
+    for (int i = 0; i < 10; ++i)
+        values[36 + i] = 2.5f;
+    for (int i = 0; i < 8; ++i)
+        values[46 + i] = i < 2 ? static_cast<float>(1000 - t * 0.01) : 0;
+    for (int i = 0; i < 16; ++i)
+        values[54 + i] = i < 2 ? 1.0f : 0.0f;
+    for (int i = 0; i < 56; ++i)
+        values[70 + i] = i < 4 ? static_cast<float>(3 * std::sin(t / 4 + i)) : 0;
+    position = {120.5 + t * 1e-4, 31.2 + t * 5e-5, 3000 + 10 * std::sin(t / 100)};
+    motion = {static_cast<float>(3000 + 10 * std::sin(t / 100)), static_cast<float>(2 * std::sin(t / 30)),
+              static_cast<float>(std::fmod(90 + t * 0.01, 360.0)), static_cast<float>(5 * std::sin(t / 20)),
+              120, 0.5f, -30, 0, 0, 0};
+}
+
+static std::vector<SeriesWriter::Channel> makeChannels () {
+    std::vector<SeriesWriter::Channel> channels;
+    for (int i = 0; i < FLOATS; ++i)
+        channels.push_back({std::format("value[{}]", i)});
+    for (const auto name : {"plane/lon", "plane/lat", "plane/alt"})
+        channels.push_back({name, SeriesWriter::FLOAT64});
+    for (int i = 0; i < 10; ++i)
+        channels.push_back({std::format("plane/motion[{}]", i)});
+    return channels;
+}
+
+int main (const int argc, char *argv[]) {
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 108000;
+    const auto dir = std::filesystem::temp_directory_path();
+    const std::string csvPath = (dir / "xpudp_series.csv").string();
+    const std::string seriesPath = (dir / "xpudp_series.xps").string();
+    const int64_t start = 1'700'000'000'000'000'000;
+
+    std::array<float, FLOATS> values{};
+    std::array<double, 3> position{};
+    std::array<float, 10> motion{};
+
+    // CSV
+    auto t0 = bench::Clock::now();
+    {
+        bench::LegacyCsvWriter csv(csvPath);
+        for (int r = 0; r < rows; ++r) {
+            makeRow(r, values, position, motion);
+            csv.write(values);
+            for (const double v : position)
+                csv.write(static_cast<float>(v));
+            csv.write(motion);
+            csv.newline();
+        }
+    }
+    const double csvNs = std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / rows;
+
+    // SeriesWriter 生产者耗时与 close 前后的总耗时
+    t0 = bench::Clock::now();
+    SeriesWriter::Report report{};
+    double seriesNs;
+    {
+        SeriesWriter series(seriesPath, makeChannels());
+        for (int r = 0; r < rows; ++r) {
+            makeRow(r, values, position, motion);
+            series.begin(start + r * PERIOD);
+            series.write(values);
+            for (const double v : position)
+                series.write(v);
+            series.write(motion);
+            series.end(true); // 生产者不是 io 线程 等待写线程而不丢弃
+        }
+        seriesNs = std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / rows;
+        report = series.close();
+    }
+    const double seriesTotal = std::chrono::duration<double, std::milli>(bench::Clock::now() - t0).count();
+
+    // 生成数据本身的耗时
+    t0 = bench::Clock::now();
+    float sink = 0;
+    for (int r = 0; r < rows; ++r) {
+        makeRow(r, values, position, motion);
+        sink += values[1];
+    }
+    const double generateNs = std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / rows;
+
+    const auto csvBytes = std::filesystem::file_size(csvPath);
+    const auto seriesBytes = std::filesystem::file_size(seriesPath);
+    printf("%d rows x %zu channels (row generation %.0f ns excluded below)\n", rows, makeChannels().size(),
+           generateNs);
+    printf("  %-22s %10s %12s\n", "", "ns/row", "bytes");
+    printf("  %-22s %10.0f %12ju\n", "csv (FastFileWriter)", csvNs - generateNs, static_cast<uintmax_t>(csvBytes));
+    printf("  %-22s %10.0f %12ju  (raw %ju, %.1fx smaller than raw, %.1fx than csv, %.0f ms incl. close)\n",
+           "SeriesWriter", seriesNs - generateNs, static_cast<uintmax_t>(seriesBytes),
+           static_cast<uintmax_t>(report.rawBytes), static_cast<double>(report.rawBytes) / seriesBytes,
+           static_cast<double>(csvBytes) / seriesBytes, seriesTotal);
+
+    // 读取 60 秒窗口
+    const int64_t from = start + (rows / 2) * PERIOD;
+    const int64_t to = from + 60'000'000'000;
+    t0 = bench::Clock::now();
+    SeriesReader reader(seriesPath);
+    std::vector<int64_t> times;
+    std::vector<double> window;
+    reader.read(static_cast<size_t>(reader.findChannel("value[1]")), from, to, times, window);
+    const double readUs = std::chrono::duration<double, std::micro>(bench::Clock::now() - t0).count();
+
+    t0 = bench::Clock::now();
+    std::vector<double> csvColumn;
+    {
+        std::ifstream csv(csvPath);
+        std::string line;
+        while (std::getline(csv, line)) {
+            const size_t comma = line.find(',');
+            const size_t next = line.find(',', comma + 1);
+            csvColumn.push_back(std::stod(line.substr(comma + 1, next - comma - 1)));
+        }
+    }
+    const double csvReadUs = std::chrono::duration<double, std::micro>(bench::Clock::now() - t0).count();
+    printf("read one channel over 60 s (%zu rows)\n", window.size());
+    printf("  %-22s %10.0f us\n", "csv full parse", csvReadUs);
+    printf("  %-22s %10.0f us\n", "SeriesReader", readUs);
+
+    // 校验 全部行的三个通道
+    bool identical = reader.rowCount() == static_cast<size_t>(rows);
+    for (const auto &name : {"value[1]", "plane/lat", "plane/motion[2]"}) {
+        times.clear();
+        window.clear();
+        reader.read(static_cast<size_t>(reader.findChannel(name)), INT64_MIN, INT64_MAX, times, window);
+        identical = identical && window.size() == static_cast<size_t>(rows);
+        for (int r = 0; identical && r < rows; ++r) {
+            makeRow(r, values, position, motion);
+            const double expect = name == std::string("value[1]") ? values[1]
+                                  : name == std::string("plane/lat") ? position[1] : motion[2];
+            identical = times[r] == start + r * PERIOD && window[r] == expect;
+        }
+    }
+    printf("values identical after round trip: %s\n", identical ? "yes" : "NO");
+    std::filesystem::remove(csvPath);
+    std::filesystem::remove(seriesPath);
+    return identical && sink != 12345 ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include "../XPlaneShared.hpp"
+#include <cstdio>
+#include <filesystem>
+
+using namespace std;
+
+// 共享内存发布
+// 1. clients 个客户端各自订阅 (旧) 与一个发布者 + clients 个 SharedReader 对比 fakeXPlane 发出的 RREF 数据包
+//    读者与发布者的帧序号一致性
+// 2. 读取耗时: SharedReader 与 XPlaneUdp 的标量、56 元素数组、基本信息
+// 3. 发布开销: 记录的数据包尽快回放 不发布 / 发布 / 发布且 clients 个读者线程不停读取 每包耗时
+// 4. 发布者停在写入区内 (进程在写入时退出): 读取在 SharedReader::WRITER_TIMEOUT 后返回 false
+// 读者线程在同一进程内各自映射 与其它进程的读者相同
+// 用法: sharedBenchmark [clients=6] [datarefs=500] [seconds=3]
+
+static constexpr int ROUNDS{1000000};
+static constexpr int REPLAYS{20}; // 每种情况回放次数
+static const std::string NAME{"xpudp_bench"};
+static const std::string ARRAY{"xpudp/bench/load"};
+
+template <typename Func>
+static double nsPerRound (Func &&func) {
+    for (int i = 0; i < ROUNDS / 10; ++i) // 预热
+        func(i);
+    const auto t0 = bench::Clock::now();
+    for (int i = 0; i < ROUNDS; ++i)
+        func(i);
+    return std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / ROUNDS;
+}
+
+/**
+ * @return 每秒 RREF 数据包
+ */
+static double sentRate (const bench::FakeXPlane &xplane, const int seconds) {
+    const uint64_t before = xplane.counters().rrefPackets;
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    return static_cast<double>(xplane.counters().rrefPackets - before) / seconds;
+}
+
+static double replayNs (const std::string &path, const int count, const bool publish, const int readers) {
+    XPlaneUdp xp(false);
+    xp.addDataref(bench::FRAME_COUNTER, 60);
+    xp.addDatarefArray(ARRAY, count, 60);
+    if (publish)
+        xp.startPublishing(NAME);
+    std::atomic<bool> running{true};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; ++i) {
+        threads.emplace_back([&running] {
+            const SharedReader reader(NAME);
+            XPlaneUdp::DatarefIndex array;
+            if (!reader.isOpen() || !reader.findDataref(ARRAY, array))
+                return;
+            std::vector<float> buffer;
+            while (running.load(std::memory_order_relaxed)) {
+                reader.getDataref(array, buffer);
+                std::this_thread::yield();
+            }
+        });
+    }
+    const auto t0 = bench::Clock::now();
+    size_t packets{0};
+    for (int i = 0; i < REPLAYS; ++i)
+        packets += xp.replay(path, 0);
+    const double ns = std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() /
+                      static_cast<double>(packets);
+    running = false;
+    for (auto &thread : threads)
+        thread.join();
+    return ns;
+}
+
+int main (const int argc, char *argv[]) {
+    const int clients = argc > 1 ? std::atoi(argv[1]) : 6;
+    const int count = argc > 2 ? std::atoi(argv[2]) : 500;
+    const int seconds = argc > 3 ? std::atoi(argv[3]) : 3;
+    const std::string path = (std::filesystem::temp_directory_path() / "xpudp_shared.log").string();
+
+    // 1. 各自订阅
+    double separateRate{0};
+    {
+        std::vector<std::unique_ptr<XPlaneUdp>> xps;
+        std::vector<std::shared_ptr<std::atomic<bool>>> connected;
+        for (int i = 1; i < clients; ++i) {
+            xps.emplace_back(std::make_unique<XPlaneUdp>());
+            connected.push_back(bench::watchConnection(*xps.back()));
+        }
+        // 第一个客户端启动 fakeXPlane 其余客户端收到同一个信标
+        auto session = bench::connect({.frameRate = 60});
+        if (!session || !std::ranges::all_of(connected, [](const auto &state) { return bench::waitBeacon(*state); }))
+            return 1;
+        xps.push_back(std::move(session.xp));
+        for (const auto &xp : xps) {
+            xp->addDataref(bench::FRAME_COUNTER, 60);
+            xp->addDatarefArray(ARRAY, count, 60);
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1)); // 等待订阅生效
+        separateRate = sentRate(*session.xplane, seconds);
+    }
+
+    // 1. 发布者 + 读者
+    auto session = bench::connect({.frameRate = 60});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    auto &xplane = session.xplane;
+    const auto frame = xp.addDataref(bench::FRAME_COUNTER, 60);
+    const auto array = xp.addDatarefArray(ARRAY, count, 60);
+    xp.addPlaneInfo(60);
+    if (!xp.startPublishing(NAME)) {
+        fprintf(stderr, "cannot create shared memory %s\n", NAME.c_str());
+        return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    if (!xp.startRecording(path)) {
+        fprintf(stderr, "cannot record to %s\n", path.c_str());
+        return 1;
+    }
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> reads{0}, behind{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < clients; ++i) {
+        readers.emplace_back([&] {
+            const SharedReader reader(NAME);
+            XPlaneUdp::DatarefIndex sharedFrame;
+            if (!reader.isOpen() || !reader.findDataref(bench::FRAME_COUNTER, sharedFrame))
+                return;
+            while (running) {
+                float local, shared;
+                reader.getDataref(sharedFrame, shared);
+                xp.getDataref(frame, local);
+                reads.fetch_add(1, std::memory_order_relaxed);
+                if (shared + 1 < local) // 两次读取之间可能恰好更新一帧
+                    behind.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::sleep_for(std::chrono::milliseconds(8));
+            }
+        });
+    }
+    const double sharedRate = sentRate(*xplane, seconds);
+    running = false;
+    for (auto &thread : readers)
+        thread.join();
+    xplane.reset();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto record = xp.stopRecording();
+    printf("%d clients, %d datarefs at 60 Hz\n", clients, count + 1);
+    printf("  %-34s %10.0f rref packets/s\n", "each client subscribes", separateRate);
+    printf("  %-34s %10.0f rref packets/s\n", "one publisher + shared memory", sharedRate);
+    printf("  reader frame behind publisher by more than 1: %llu of %llu reads\n",
+           static_cast<unsigned long long>(behind.load()), static_cast<unsigned long long>(reads.load()));
+
+    // 2. 读取耗时
+    const SharedReader reader(NAME);
+    XPlaneUdp::DatarefIndex sharedFrame, sharedArray;
+    if (!reader.isOpen() || !reader.findDataref(bench::FRAME_COUNTER, sharedFrame) ||
+        !reader.findDataref(ARRAY, sharedArray)) {
+        fprintf(stderr, "cannot open shared memory %s\n", NAME.c_str());
+        return 1;
+    }
+    float value{0};
+    std::array<float, 56> elements{};
+    XPlaneUdp::PlaneInfo info{};
+    const double sharedScalar = nsPerRound([&](int) { reader.getDataref(sharedFrame, value); });
+    const double localScalar = nsPerRound([&](int) { xp.getDataref(frame, value); });
+    const double sharedVector = nsPerRound([&](int) { reader.getDataref(sharedArray, elements); });
+    std::array<float, 56> localElements{};
+    const double localVector = nsPerRound([&](int) { xp.getDataref(array, localElements); });
+    const double sharedInfo = nsPerRound([&](int) { reader.getPlaneInfo(info); });
+    const double localInfo = nsPerRound([&](int) { xp.getPlaneInfo(info); });
+    printf("read (ns)                          %12s %12s\n", "SharedReader", "XPlaneUdp");
+    printf("  %-32s %12.1f %12.1f\n", "scalar", sharedScalar, localScalar);
+    printf("  %-32s %12.1f %12.1f\n", "56 elements", sharedVector, localVector);
+    printf("  %-32s %12.1f %12.1f\n", "plane info", sharedInfo, localInfo);
+    namespace bip = boost::interprocess;
+    bip::shared_memory_object writable(bip::open_only, NAME.c_str(), bip::read_write);
+    bip::mapped_region writableRegion(writable, bip::read_write);
+    const auto publish = xp.stopPublishing();
+    const bool stillPublishing = reader.isPublishing();
+    printf("  published %llu packets, %llu values over capacity, %zu bytes, reader still publishing: %s\n",
+           static_cast<unsigned long long>(publish.published), static_cast<unsigned long long>(publish.overflow),
+           publish.bytes, stillPublishing ? "yes" : "no");
+
+    // 3. 发布开销
+    const double plainNs = replayNs(path, count, false, 0);
+    const double publishNs = replayNs(path, count, true, 0);
+    const double contendedNs = replayNs(path, count, true, clients);
+    printf("receive %llu recorded packets x %d (%llu dropped)\n", static_cast<unsigned long long>(record.recorded),
+           REPLAYS, static_cast<unsigned long long>(record.dropped));
+    printf("  %-34s %10.0f ns/packet\n", "not publishing", plainNs);
+    printf("  %-34s %10.0f ns/packet\n", "publishing", publishNs);
+    printf("  %-34s %10.0f ns/packet\n", std::format("publishing, {} readers polling", clients).c_str(),
+           contendedNs);
+
+    // 4. 模拟写入区内退出的发布者
+    SeqLock &lock = SharedSegment::at(writableRegion.get_address(), 0).header->lock;
+    std::atomic<bool> entered{false}, release{false};
+    std::thread stuck([&] {
+        lock.write([&] {
+            entered = true;
+            while (!release)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    });
+    while (!entered)
+        std::this_thread::yield();
+    const auto stuckStart = bench::Clock::now();
+    const bool stuckRead = reader.getDataref(sharedArray, elements);
+    const double stuckMs = std::chrono::duration<double, std::milli>(bench::Clock::now() - stuckStart).count();
+    release = true;
+    stuck.join();
+    printf("  publisher stopped inside a write: read %s after %.0f ms\n", stuckRead ? "succeeded" : "gave up",
+           stuckMs);
+
+    std::filesystem::remove(path);
+    // 停止发布后读者应看到未发布 停在写入区内的发布者应使读取放弃
+    return stillPublishing || stuckRead || value == 12345 ? 1 : 0;
+}
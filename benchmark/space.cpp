@@ -0,0 +1,269 @@
+#include "BenchCommon.hpp"
+#include <boost/dynamic_bitset.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <unordered_map>
+
+using namespace std;
+
+// values 位置分配与名称登记
+// 1. 分配器: 先分配 refs 段 (70% 长度 1, 20% 2-8, 10% 9-64), 再随机释放一段并分配新的一段 ops 次
+//    旧 dynamic_bitset 逐位查找 与 SlotAllocator 每次耗时 以及最终的最高位置
+// 2. 每个订阅的堆内存: XPlaneUdp 订阅 refs 个标量 / 一个 refs 元素的数组
+//    与旧结构 (std::string 名称 + unordered_map 名称索引 + 413 字节请求) 对比
+// 3. XPlaneUdp 订阅时另一线程不断读取已订阅的 dataref (订阅信息地址不变, 可在 ASan 下检查)
+//    随机停止与恢复接收 (changeDatarefFreq 0 / 30) 每次耗时, 再随机停止一半 compactSpace 前后的空闲区间
+//    释放的位置隔离 SLOT_QUARANTINE 后才可分配, 只有隔离中的位置足够时恢复抛出异常, 计为推迟并留在停止的一侧
+//    每次整理前等待隔离期结束, 直到没有可移动的 dataref
+// 用法: spaceBenchmark [refs=10000] [ops=100000]
+
+// 堆内存统计: 替换全局 operator new, 在块前记录大小
+static std::atomic<int64_t> liveBytes{0};
+static constexpr size_t HEADER{alignof(std::max_align_t)};
+
+void* operator new (const std::size_t size) {
+    auto *block = static_cast<char*>(std::malloc(size + HEADER));
+    if (!block)
+        throw std::bad_alloc();
+    *reinterpret_cast<size_t*>(block) = size;
+    liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    return block + HEADER;
+}
+void* operator new[] (const std::size_t size) { return operator new(size); }
+void operator delete (void *ptr) noexcept {
+    if (!ptr)
+        return;
+    auto *block = static_cast<char*>(ptr) - HEADER;
+    liveBytes.fetch_sub(static_cast<int64_t>(*reinterpret_cast<size_t*>(block)), std::memory_order_relaxed);
+    std::free(block);
+}
+void operator delete[] (void *ptr) noexcept { operator delete(ptr); }
+void operator delete (void *ptr, std::size_t) noexcept { operator delete(ptr); }
+void operator delete[] (void *ptr, std::size_t) noexcept { operator delete(ptr); }
+
+/**
+ * @brief 旧实现: 逐位查找第一段足够长的空闲 找不到时在末尾扩展
+ */
+class LegacySpace {
+    public:
+        size_t allocate (const size_t length) {
+            const size_t currentSize = space.size();
+            if (currentSize >= length) {
+                size_t i = 0;
+                const size_t searchLimit = currentSize - length;
+                while (i <= searchLimit) {
+                    size_t j;
+                    for (j = 0; j < length; ++j) {
+                        if (space.test(i + j))
+                            break;
+                    }
+                    if (j == length) {
+                        space.set(i, length, true);
+                        return i;
+                    }
+                    i += j + 1;
+                }
+            }
+            const size_t newStart = currentSize;
+            space.resize(currentSize + length, false);
+            space.set(newStart, length, true);
+            return newStart;
+        }
+        void release (const size_t start, const size_t length) { space.set(start, length, false); }
+        [[nodiscard]] size_t end () const { return space.size(); }
+    private:
+        boost::dynamic_bitset<> space;
+};
+
+/**
+ * @brief 旧的订阅信息 名称各自在堆上 每个元素一个 413 字节请求
+ */
+struct LegacyInfo {
+    std::string name;
+    int start, end;
+    int32_t freq;
+    bool available, isArray;
+    int32_t schema{-1}, priority{0};
+    std::vector<std::array<char, 413>> packets{};
+};
+
+static size_t randomLength (std::mt19937 &random) {
+    const auto kind = random() % 10;
+    if (kind < 7)
+        return 1;
+    if (kind < 9)
+        return 2 + random() % 7;
+    return 9 + random() % 56;
+}
+
+static std::string refName (const int i) { return std::format("sim/bench/space/dataref_{}", i); }
+
+struct ChurnResult {
+    double ns{0};
+    size_t end{0};
+    size_t failed{0};
+};
+
+/**
+ * @brief 先分配 refs 段 再随机释放并分配 ops 次
+ */
+template <typename Space>
+static ChurnResult churn (Space &space, const int refs, const int ops) {
+    std::mt19937 random(7);
+    std::vector<std::pair<size_t, size_t>> live; // 起点 长度
+    ChurnResult result;
+    const auto allocate = [&](const size_t length) {
+        const size_t start = space.allocate(length);
+        if (start == SlotAllocator::NO_SPACE)
+            ++result.failed;
+        else
+            live.emplace_back(start, length);
+    };
+    for (int i = 0; i < refs; ++i)
+        allocate(randomLength(random));
+    const auto t0 = bench::Clock::now();
+    for (int i = 0; i < ops; ++i) {
+        const size_t victim = random() % live.size();
+        space.release(live[victim].first, live[victim].second);
+        live[victim] = live.back();
+        live.pop_back();
+        allocate(randomLength(random));
+    }
+    result.ns = std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / ops;
+    result.end = space.end();
+    return result;
+}
+
+int main (const int argc, char *argv[]) {
+    const int refs = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const int ops = argc > 2 ? std::atoi(argv[2]) : 100000;
+
+    // 1. 分配器
+    size_t total{0};
+    {
+        std::mt19937 random(7);
+        for (int i = 0; i < refs; ++i)
+            total += randomLength(random);
+    }
+    LegacySpace legacySpace;
+    SlotAllocator allocator(total * 2);
+    const auto legacy = churn(legacySpace, refs, ops);
+    const auto current = churn(allocator, refs, ops);
+    printf("allocator: %d extents (%zu values), %d release + allocate\n", refs, total, ops);
+    printf("  %-28s %10s %12s %10s\n", "", "ns/op", "end", "failed");
+    printf("  %-28s %10.0f %12zu %10s\n", "dynamic_bitset first fit", legacy.ns, legacy.end, "-");
+    printf("  %-28s %10.0f %12zu %10zu\n", std::format("SlotAllocator, cap {}", total * 2).c_str(), current.ns,
+           current.end, current.failed);
+
+    // 2. 每个订阅的内存
+    double legacyScalar{0}, legacyArray{0}, scalarBytes{0}, arrayBytes{0};
+    {
+        int64_t before = liveBytes.load();
+        {
+            std::vector<LegacyInfo> infos;
+            std::unordered_map<std::string, size_t> exist;
+            for (int i = 0; i < refs; ++i) {
+                auto &info = infos.emplace_back(refName(i), i, i, 30, true, false);
+                info.packets.resize(1);
+                exist[info.name] = infos.size() - 1;
+            }
+            legacyScalar = static_cast<double>(liveBytes.load() - before) / refs;
+            before = liveBytes.load();
+            auto &info = infos.emplace_back("sim/bench/space/array", refs, refs * 2 - 1, 30, true, true);
+            info.packets.resize(refs);
+            exist[info.name] = infos.size() - 1;
+            legacyArray = static_cast<double>(liveBytes.load() - before) / refs;
+        }
+        XPlaneUdp xp(false);
+        before = liveBytes.load();
+        for (int i = 0; i < refs; ++i)
+            xp.addDataref(refName(i), 30);
+        scalarBytes = static_cast<double>(liveBytes.load() - before) / refs;
+        before = liveBytes.load();
+        xp.addDatarefArray("sim/bench/space/array", refs, 30);
+        arrayBytes = static_cast<double>(liveBytes.load() - before) / refs;
+        const auto report = xp.getSpaceReport();
+        printf("heap bytes per subscription (%d names of %zu chars)\n", refs, refName(refs - 1).size());
+        printf("  %-28s %10s %10s\n", "", "scalar", "element");
+        printf("  %-28s %10.0f %10.0f\n", "string + map + 413 B packet", legacyScalar, legacyArray);
+        printf("  %-28s %10.0f %10.0f\n", "XPlaneUdp", scalarBytes, arrayBytes);
+        printf("  names %zu B, cached requests %zu B, values fixed at %zu\n", report.nameBytes, report.requestBytes,
+               report.capacity);
+    }
+
+    // 3. 停止与恢复接收
+    XPlaneUdp xp(false, total * 2);
+    std::mt19937 random(11);
+    std::vector<XPlaneUdp::DatarefIndex> subscribed, stopped;
+    std::atomic<size_t> published{0};
+    std::atomic<bool> subscribing{true};
+    uint64_t concurrentReads{0};
+    std::thread reader([&] {
+        std::mt19937 pick(13);
+        std::vector<float> element;
+        while (subscribing.load(std::memory_order_relaxed)) {
+            const size_t count = published.load(std::memory_order_acquire);
+            if (count == 0)
+                continue;
+            xp.getDataref(XPlaneUdp::DatarefIndex{pick() % count}, element);
+            ++concurrentReads;
+        }
+    });
+    for (int i = 0; i < refs; ++i) {
+        const size_t length = randomLength(random);
+        subscribed.push_back(length == 1 ? xp.addDataref(refName(i), 30)
+                                         : xp.addDatarefArray(refName(i), static_cast<int>(length), 30));
+        published.store(subscribed.size(), std::memory_order_release);
+    }
+    subscribing = false;
+    reader.join();
+    const int churnOps = std::min(ops, refs * 2);
+    size_t deferred{0};
+    const auto t0 = bench::Clock::now();
+    for (int i = 0; i < churnOps; ++i) {
+        auto &from = (i % 2 == 0 || stopped.empty()) ? subscribed : stopped;
+        auto &to = (&from == &subscribed) ? stopped : subscribed;
+        const size_t pick = random() % from.size();
+        const auto ref = from[pick];
+        from[pick] = from.back();
+        from.pop_back();
+        try {
+            xp.changeDatarefFreq(ref, &to == &stopped ? 0.0f : 30.0f);
+            to.push_back(ref);
+        } catch (const std::runtime_error &) { // 空闲位置都在隔离中
+            ++deferred;
+            from.push_back(ref);
+        }
+    }
+    const double churnUs = std::chrono::duration<double, std::micro>(bench::Clock::now() - t0).count() / churnOps;
+    std::ranges::shuffle(subscribed, random);
+    for (size_t i = 0; i < subscribed.size() / 2; ++i)
+        xp.changeDatarefFreq(subscribed[i], 0);
+    std::this_thread::sleep_for(XPlaneUdp::SLOT_QUARANTINE);
+    const auto before = xp.getSpaceReport();
+    size_t moved{0}, passes{0};
+    double compactMs{0};
+    for (size_t pass = 1; pass > 0; ++passes) {
+        const auto t1 = bench::Clock::now();
+        pass = xp.compactSpace();
+        compactMs += std::chrono::duration<double, std::milli>(bench::Clock::now() - t1).count();
+        moved += pass;
+        if (pass > 0) // 腾出的位置隔离期后才能合并
+            std::this_thread::sleep_for(XPlaneUdp::SLOT_QUARANTINE);
+    }
+    const auto after = xp.getSpaceReport();
+    printf("subscribe %d datarefs while another thread read them %llu times\n", refs,
+           static_cast<unsigned long long>(concurrentReads));
+    printf("changeDatarefFreq stop / resume, %d ops: %.2f us/op, %zu resumes deferred by quarantine\n", churnOps,
+           churnUs, deferred);
+    printf("stop half of the subscribed datarefs\n");
+    printf("  %-34s %10s %11s %10s %12s %12s\n", "", "used", "quarantined", "end", "largest free", "free extents");
+    printf("  %-34s %10zu %11zu %10zu %12zu %12zu\n", "before compactSpace", before.used, before.quarantined,
+           before.end, before.largestFree, before.freeExtents);
+    printf("  %-34s %10zu %11zu %10zu %12zu %12zu\n",
+           std::format("after {} passes, {} moved {:.1f} ms", passes, moved, compactMs).c_str(),
+           after.used, after.quarantined, after.end, after.largestFree, after.freeExtents);
+    return after.end <= before.end ? 0 : 1; // 整理只把 dataref 移到更低的位置
+}
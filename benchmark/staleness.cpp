@@ -0,0 +1,230 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+using namespace std;
+
+// 更新时间与过期查询
+// 1. StaleScan 扫描 slots 个时间戳 (其中 1% 过期) scalar/sse2/avx2 每次耗时, 并校验结果一致
+//    时间戳整体移到 2^32 回绕处后结果不变
+// 2. fakeXPlane 以 rate 发送 datarefs 个 dataref: findStale 与逐个 getDataref(idx, value, maxAge) 的耗时,
+//    StampClockProbe 使时间戳在接收中回绕, 再前进超过 2^32 ms, 全部仍新鲜,
+//    停止 fakeXPlane 后 maxAge 内 findStale 报告全部过期, 之后订阅的 dataref 为 NEVER,
+//    时钟再前进将近一整圈 (中途 ageStamps) 后仍全部过期
+// 3. 回放接收的数据包 (另订阅 datarefs / 10 个从未收到的 dataref): 单独接收, 与另一线程不断 findStale 时,
+//    每个数据包的接收耗时与解码耗时 p50/p99, findStale 不应阻塞接收
+// 用法: stalenessBenchmark [slots=65536] [datarefs=5000] [rate=60]
+
+/**
+ * @brief 测试入口 让时间戳时钟前进 需定义 XPLANEUDP_TEST_ACCESS 见 CMakeLists.txt
+ */
+struct StampClockProbe {
+    /**
+     * @brief 把时间戳的起点提前 offset 相当于时钟前进 offset
+     * @param shiftStamps 已有的时间戳一并前进 年龄不变 否则相当于 offset 内没有收到
+     */
+    static void advance (XPlaneUdp &xp, const std::chrono::milliseconds offset, const bool shiftStamps) {
+        const auto shift = static_cast<uint32_t>(offset.count());
+        std::lock_guard lock(xp.writeMutex); // io 线程在 writeMutex 内换算并写入时间戳
+        xp.dataLock.write([&] {
+            xp.stampEpoch.fetch_sub(offset.count() * 1'000'000, std::memory_order_relaxed);
+            for (size_t i = 0; shiftStamps && i < xp.values.size(); ++i) {
+                const uint32_t stamp = xp.slotTimes[i].load(std::memory_order_relaxed);
+                if (stamp <= XPlaneUdp::ANCIENT_STAMP || stamp == XPlaneUdp::FREE_STAMP)
+                    continue;
+                const uint32_t shifted = stamp + shift;
+                xp.slotTimes[i].store(shifted <= XPlaneUdp::ANCIENT_STAMP || shifted == XPlaneUdp::FREE_STAMP
+                                          ? XPlaneUdp::ANCIENT_STAMP + 1 : shifted, std::memory_order_relaxed);
+            }
+        });
+    }
+    static size_t age (XPlaneUdp &xp) { return xp.ageStamps(); }
+};
+
+static double nsPer (const bench::Clock::time_point start, const size_t n) {
+    return std::chrono::duration<double, std::nano>(bench::Clock::now() - start).count() / static_cast<double>(n);
+}
+
+struct ReplayResult {
+    size_t packets{0};
+    double ns{0}; // 每个数据包 含回放调度
+    uint64_t decodeP50{0}, decodeP99{0};
+    uint64_t scans{0}; // 回放期间的 findStale 次数
+};
+
+/**
+ * @brief 按相同顺序订阅后尽快回放 scanning 时另一线程不断 findStale
+ */
+static ReplayResult replayWith (const std::string &path, const int count, const double rate, const bool scanning) {
+    XPlaneUdp xp(false);
+    for (int i = 0; i < count; ++i)
+        xp.addDataref(std::format("xpudp/bench/stale_{}", i), static_cast<int32_t>(rate));
+    for (int i = 0; i < count / 10; ++i) // 从未收到 findStale 总有过期位置
+        xp.addDataref(std::format("xpudp/bench/stale_never_{}", i), static_cast<int32_t>(rate));
+    std::atomic<bool> running{scanning};
+    ReplayResult result;
+    std::thread scanner([&] {
+        std::vector<XPlaneUdp::DatarefIndex> stale;
+        while (running.load(std::memory_order_relaxed)) {
+            xp.findStale(std::chrono::milliseconds(100), stale);
+            ++result.scans;
+        }
+    });
+    const auto t0 = bench::Clock::now();
+    result.packets = xp.replay(path, 0);
+    result.ns = nsPer(t0, std::max<size_t>(result.packets, 1));
+    running = false;
+    scanner.join();
+    const auto stats = xp.getStats();
+    result.decodeP50 = stats.decodeTime.percentile(0.5);
+    result.decodeP99 = stats.decodeTime.percentile(0.99);
+    return result;
+}
+
+int main (const int argc, char *argv[]) {
+    const size_t slots = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 65536;
+    const int count = argc > 2 ? std::atoi(argv[2]) : 5000;
+    const double rate = argc > 3 ? std::atof(argv[3]) : 60;
+
+    // 1. 扫描核心
+    std::mt19937 random(5);
+    std::vector<uint32_t> stamps(slots);
+    for (auto &stamp : stamps)
+        stamp = random() % 100 == 0 ? 1000 + random() % 1000 : 5000 + random() % 1000;
+    std::vector<uint32_t> reference(slots), out(slots);
+    constexpr uint32_t newest = 1999, span = 1'000'000; // 早于 2000 者过期
+    const size_t expected = StaleScan::scalar(stamps.data(), slots, newest, span, reference.data());
+    printf("scan %zu stamps, %zu stale\n", slots, expected);
+    printf("  %-10s %12s %10s %8s\n", "kernel", "us/scan", "ns/slot", "same");
+    constexpr int rounds = 200;
+    bool passed = true; // 上面说明中的各项校验
+    for (const auto kernel : {&StaleScan::scalar, &StaleScan::sse2, &StaleScan::avx2}) {
+        const auto t0 = bench::Clock::now();
+        size_t found = 0;
+        for (int r = 0; r < rounds; ++r)
+            found = kernel(stamps.data(), slots, newest, span, out.data());
+        const double ns = nsPer(t0, rounds);
+        const bool same = found == expected && std::equal(out.begin(), out.begin() + found, reference.begin());
+        printf("  %-10s %12.2f %10.3f %8s\n", StaleScan::name(kernel), ns / 1000, ns / slots, same ? "yes" : "NO");
+        passed &= same;
+    }
+    // 整体前移 使 1000 - 6000 跨过 2^32
+    constexpr uint32_t shift = UINT32_MAX - 3000;
+    std::vector<uint32_t> wrapped(slots);
+    for (size_t i = 0; i < slots; ++i) {
+        wrapped[i] = stamps[i] + shift;
+        if (wrapped[i] <= StaleScan::ANCIENT || wrapped[i] == StaleScan::FREE)
+            wrapped[i] = StaleScan::ANCIENT + 1;
+    }
+    bool wrapSame = true;
+    for (const auto kernel : {&StaleScan::scalar, &StaleScan::sse2, &StaleScan::avx2}) {
+        const size_t found = kernel(wrapped.data(), slots, newest + shift, span, out.data());
+        wrapSame &= found == expected && std::equal(out.begin(), out.begin() + found, reference.begin());
+    }
+    printf("  stamps across 2^32: %s\n", wrapSame ? "same" : "DIFFERENT");
+    passed &= wrapSame;
+    printf("  best: %s\n", StaleScan::name(StaleScan::best()));
+
+    // 2. 实际订阅
+    auto session = bench::connect({.frameRate = rate});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    auto &xplane = session.xplane;
+    std::vector<XPlaneUdp::DatarefIndex> refs;
+    for (int i = 0; i < count; ++i)
+        refs.push_back(xp.addDataref(std::format("xpudp/bench/stale_{}", i), static_cast<int32_t>(rate)));
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    const std::string path = (std::filesystem::temp_directory_path() / "xpudp_staleness.log").string();
+    const bool recorded = xp.startRecording(path);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    if (recorded)
+        xp.stopRecording();
+    constexpr auto maxAge = std::chrono::milliseconds(100);
+    std::vector<XPlaneUdp::DatarefIndex> stale;
+
+    const auto t0 = bench::Clock::now();
+    size_t fresh = 0;
+    for (int r = 0; r < 20; ++r) {
+        fresh = 0;
+        for (const auto &ref : refs) {
+            float value;
+            fresh += xp.getDataref(ref, value, maxAge) == XPlaneUdp::Freshness::FRESH;
+        }
+    }
+    const double perRef = nsPer(t0, 20) / 1000;
+    const auto t1 = bench::Clock::now();
+    size_t staleCount = 0;
+    for (int r = 0; r < 20; ++r)
+        staleCount = xp.findStale(maxAge, stale);
+    const double scan = nsPer(t1, 20) / 1000;
+    printf("%d datarefs at %.0f Hz, maxAge %lld ms\n", count, rate, static_cast<long long>(maxAge.count()));
+    printf("  getDataref(maxAge) each   %10.1f us  %zu fresh\n", perRef, fresh);
+    printf("  findStale                 %10.1f us  %zu stale\n", scan, staleCount);
+
+    // 时间戳在接收中回绕 再前进超过一整圈
+    const auto freshAfter = [&] {
+        size_t count = 0;
+        for (const auto &ref : refs) {
+            float value;
+            count += xp.getDataref(ref, value, maxAge) == XPlaneUdp::Freshness::FRESH;
+        }
+        return count;
+    };
+    constexpr auto lap = std::chrono::milliseconds(int64_t{1} << 32);
+    StampClockProbe::advance(xp, lap - std::chrono::milliseconds(500), true);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    const size_t wrappedFresh = freshAfter();
+    const size_t wrappedStale = xp.findStale(maxAge, stale);
+    StampClockProbe::advance(xp, lap + std::chrono::milliseconds(10), true);
+    const size_t lapFresh = freshAfter();
+    const size_t lapStale = xp.findStale(maxAge, stale);
+    printf("  stamps wrapped while receiving: %zu fresh, %zu stale; after one more lap: %zu fresh, %zu stale\n",
+           wrappedFresh, wrappedStale, lapFresh, lapStale);
+    passed &= wrappedFresh == refs.size() && lapFresh == refs.size();
+
+    // 停止发送
+    xplane.reset();
+    const auto stopped = bench::Clock::now();
+    while (xp.findStale(maxAge, stale) < refs.size() && bench::Clock::now() - stopped < std::chrono::seconds(2))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    printf("  after the sender stops: all %zu stale in %.0f ms\n", stale.size(),
+           std::chrono::duration<double, std::milli>(bench::Clock::now() - stopped).count());
+    passed &= stale.size() >= refs.size();
+    float value;
+    const auto late = xp.addDataref("xpudp/bench/stale_late", static_cast<int32_t>(rate));
+    const bool never = xp.getDataref(late, value, maxAge) == XPlaneUdp::Freshness::NEVER;
+    const bool stalePrevious = xp.getDataref(refs[0], value, maxAge) == XPlaneUdp::Freshness::STALE;
+    printf("  subscribed afterwards: %s, earlier value: %s\n", never ? "NEVER" : "not NEVER",
+           stalePrevious ? "STALE" : "not STALE");
+    passed &= never && stalePrevious;
+    // 停止接收后时钟前进将近一整圈 定时老化后不会回绕成新鲜
+    constexpr auto half = std::chrono::milliseconds(int64_t{1} << 31);
+    StampClockProbe::advance(xp, half + std::chrono::seconds(1), false);
+    const size_t aged = StampClockProbe::age(xp);
+    StampClockProbe::advance(xp, half - std::chrono::seconds(2), false);
+    const size_t lapStaleAfterStop = xp.findStale(maxAge, stale);
+    const bool staleAfterLap = xp.getDataref(refs[0], value, maxAge) == XPlaneUdp::Freshness::STALE;
+    printf("  one lap without packets: %zu aged, %zu stale, earlier value: %s\n", aged, lapStaleAfterStop,
+           staleAfterLap ? "STALE" : "not STALE");
+    passed &= staleAfterLap && lapStaleAfterStop >= refs.size();
+    printf("checks passed: %s\n", passed ? "yes" : "NO");
+
+    // 3. findStale 期间的接收
+    if (!recorded) {
+        fprintf(stderr, "cannot record to %s\n", path.c_str());
+        return 1;
+    }
+    const auto alone = replayWith(path, count, rate, false);
+    const auto scanned = replayWith(path, count, rate, true);
+    printf("receive %zu recorded packets, %d + %d never received datarefs\n", alone.packets, count, count / 10);
+    printf("  %-28s %12s %12s %12s %10s\n", "", "ns/packet", "decode p50", "decode p99", "scans");
+    for (const auto &[name, result] : {std::pair{"alone", alone}, std::pair{"findStale in a loop", scanned}})
+        printf("  %-28s %12.0f %12llu %12llu %10llu\n", name, result.ns,
+               static_cast<unsigned long long>(result.decodeP50), static_cast<unsigned long long>(result.decodeP99),
+               static_cast<unsigned long long>(result.scans));
+    std::filesystem::remove(path);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+#include "FakeXPlane.hpp"
+#include "BenchCommon.hpp"
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+// 写入缓冲
+// 模拟自动驾驶循环: 每个周期设置 targets 个 dataref, 其中 1/3 不变, 1/3 只有微小抖动, 1/3 持续变化
+// 每个 dataref 在一个周期内被两个模块各设置一次, 另有一个 8 元素数组
+// 逐个立即发送(旧) 与写入缓冲 (epsilon 0 / 0.001) 对比 fakeXPlane 收到的 DREF 数, 每次 setDataref 与每周期的耗时
+// 最后在一个周期内把同一 dataref 在新值与上次发送的值之间来回设置 flips 次, 应只发送一次, 改回的次数计为抑制
+// 用法: writeBufferBenchmark [targets=30] [rate=60] [seconds=3]
+
+struct Result {
+    uint64_t received{0};
+    uint64_t calls{0};
+    double callNs{0};
+    double tickUs{0};
+    XPlaneStats::Report stats{};
+};
+
+static Result run (XPlaneUdp &xp, const bench::FakeXPlane &xplane, const int targets, const double rate,
+                   const int seconds, const bool buffered, const float epsilon) {
+    std::vector<std::string> names;
+    for (int i = 0; i < targets; ++i)
+        names.push_back(std::format("sim/cockpit/autopilot/bench_{}", i));
+    if (buffered)
+        xp.enableWriteBuffer(std::chrono::microseconds(0), epsilon);
+    const uint64_t before = xplane.counters().writes;
+    const auto statsBefore = xp.getStats();
+    const auto period = std::chrono::duration_cast<bench::Clock::duration>(std::chrono::duration<double>(1 / rate));
+    const int ticks = static_cast<int>(rate * seconds);
+    std::array<float, 8> servo{};
+    Result result;
+    double busy{0};
+    auto due = bench::Clock::now();
+    for (int tick = 0; tick < ticks; ++tick) {
+        std::this_thread::sleep_until(due);
+        due += period;
+        const auto t0 = bench::Clock::now();
+        for (int pass = 0; pass < 2; ++pass) { // 两个模块各写一次
+            for (int i = 0; i < targets; ++i) {
+                float value;
+                if (i % 3 == 0)
+                    value = 100.0f * i;
+                else if (i % 3 == 1)
+                    value = 1.0f + 0.0001f * static_cast<float>(tick % 3);
+                else
+                    value = std::sin(static_cast<float>(tick) * 0.05f + static_cast<float>(i) + static_cast<float>(pass));
+                xp.setDataref(names[i], value);
+                ++result.calls;
+            }
+        }
+        for (size_t i = 0; i < servo.size(); ++i)
+            servo[i] = static_cast<float>(i) + (tick / 30 % 2 == 0 ? 0.0f : 0.5f);
+        xp.setDataref("sim/cockpit/autopilot/bench_servo", servo);
+        result.calls += servo.size();
+        if (buffered)
+            xp.flushWrites();
+        busy += std::chrono::duration<double, std::micro>(bench::Clock::now() - t0).count();
+    }
+    if (buffered)
+        xp.disableWriteBuffer();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    result.received = xplane.counters().writes - before;
+    result.callNs = busy * 1000 / static_cast<double>(result.calls);
+    result.tickUs = busy / ticks;
+    const auto statsAfter = xp.getStats();
+    result.stats.writesSuppressed = statsAfter.writesSuppressed - statsBefore.writesSuppressed;
+    result.stats.writesCoalesced = statsAfter.writesCoalesced - statsBefore.writesCoalesced;
+    return result;
+}
+
+int main (const int argc, char *argv[]) {
+    const int targets = argc > 1 ? std::atoi(argv[1]) : 30;
+    const double rate = argc > 2 ? std::atof(argv[2]) : 60;
+    const int seconds = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    const auto session = bench::connect({.frameRate = rate});
+    if (!session)
+        return 1;
+    auto &xp = *session.xp;
+    auto &xplane = *session.xplane;
+
+    printf("%d datarefs set twice + 8 element array per tick, %.0f Hz for %d s\n", targets, rate, seconds);
+    printf("  %-24s %12s %12s %12s %12s %10s %10s\n", "", "setDataref", "DREF recv", "suppressed", "coalesced",
+           "ns/call", "us/tick");
+    const auto print = [](const char *name, const Result &result) {
+        printf("  %-24s %12llu %12llu %12llu %12llu %10.1f %10.2f\n", name,
+               static_cast<unsigned long long>(result.calls), static_cast<unsigned long long>(result.received),
+               static_cast<unsigned long long>(result.stats.writesSuppressed),
+               static_cast<unsigned long long>(result.stats.writesCoalesced), result.callNs, result.tickUs);
+    };
+    print("immediate", run(xp, xplane, targets, rate, seconds, false, 0));
+    print("buffered, epsilon 0", run(xp, xplane, targets, rate, seconds, true, 0));
+    print("buffered, epsilon 0.001", run(xp, xplane, targets, rate, seconds, true, 0.001f));
+
+    // 一个周期内来回改变
+    constexpr int flips = 1000;
+    const std::string flip = "sim/cockpit/autopilot/bench_flip";
+    xp.enableWriteBuffer(std::chrono::microseconds(0));
+    xp.setDataref(flip, 1.0f);
+    xp.flushWrites();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const uint64_t before = xplane.counters().writes;
+    const auto statsBefore = xp.getStats();
+    const auto t0 = bench::Clock::now();
+    for (int i = 0; i < flips; ++i)
+        xp.setDataref(flip, i % 2 == 0 ? 2.0f : 1.0f);
+    xp.setDataref(flip, 2.0f);
+    const double flipNs = std::chrono::duration<double, std::nano>(bench::Clock::now() - t0).count() / (flips + 1);
+    xp.flushWrites();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto statsAfter = xp.getStats();
+    xp.disableWriteBuffer();
+    const uint64_t sent = xplane.counters().writes - before;
+    printf("  %d flips back to the sent value in one tick: %llu DREF, %llu suppressed, %.1f ns/call\n", flips,
+           static_cast<unsigned long long>(sent),
+           static_cast<unsigned long long>(statsAfter.writesSuppressed - statsBefore.writesSuppressed), flipNs);
+    return sent == 1 ? 0 : 1;
+}
@@ -25,7 +25,9 @@ int main () {
     bool rev{};
     const std::string set{"sim/cockpit/radios/com1_freq_hz"};
     while (true) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        // 等待时间更新 暂停时不会唤醒
+        if (!xp.waitUpdate(time, std::chrono::seconds(5)))
+            continue;
         // 获取基本信息
         xp.getPlaneInfo(info);
         xp.getDataref(time, timeValue);